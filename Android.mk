@@ -10,25 +10,41 @@ LOCAL_CFLAGS:= \
 	-DVERSION=\"2.0\"
 
 LOCAL_SRC_FILES:= \
+	parser/a2dp.c \
+	parser/adv.c \
 	parser/att.c \
+	parser/attstats.c \
+	parser/audio.c \
 	parser/avctp.c \
 	parser/avdtp.c \
+	parser/binary.c \
 	parser/bnep.c \
 	parser/bpa.c \
 	parser/capi.c \
 	parser/cmtp.c \
+	parser/conn.c \
 	parser/csr.c \
 	parser/ericsson.c \
+	parser/extract.c \
+	parser/flow.c \
+	parser/gatt.c \
 	parser/hci.c \
 	parser/hcrp.c \
 	parser/hidp.c \
+	parser/inquiry.c \
+	parser/json.c \
 	parser/l2cap.c \
+	parser/latency.c \
 	parser/lmp.c \
 	parser/obex.c \
 	parser/parser.c \
+	parser/pcap.c \
 	parser/ppp.c \
+	parser/profile.c \
+	parser/rate.c \
 	parser/rfcomm.c \
 	parser/sdp.c \
+	parser/summary.c \
 	parser/tcpip.c \
 	src/hcidump.c
 
@@ -0,0 +1,1037 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "parser.h"
+
+#define MAX_STREAMS	16
+#define MAX_CONFIGS	32
+#define RTP_HDR_SIZE	12
+#define SBC_SYNCWORD	0x9c
+
+#define CODEC_SBC	0x00
+#define CODEC_MPEG12	0x01
+#define CODEC_MPEG24	0x02
+
+#define MEDIA_BUF_SIZE	65536
+
+/* Sequence number of a media packet */
+#define SEQ_LATE	-2
+#define SEQ_DUPLICATE	-1
+
+/* AVDTP signals the analyzer follows */
+#define SIG_SET_CONFIGURATION	0x03
+#define SIG_RECONFIGURE		0x05
+#define SIG_OPEN		0x06
+#define SIG_START		0x07
+
+/* Media codec configuration of a stream endpoint */
+struct a2dp_config {
+	uint8_t		used;
+	uint8_t		slot;		/* Device slot */
+	uint16_t	handle;
+	uint8_t		seid;		/* ACP SEID */
+	uint8_t		valid;		/* Accepted by the remote side */
+	uint8_t		codec;
+	uint8_t		conf[4];	/* SBC information elements */
+	uint8_t		pending;	/* Waiting for the response */
+	uint8_t		label;		/* Transaction of the request */
+	uint8_t		next_codec;
+	uint8_t		next_conf[4];
+	uint64_t	when;		/* Time it was accepted */
+};
+
+struct sbc_info {
+	int		frames;		/* Parsed from the payload */
+	int		count;		/* As the payload header says */
+	int		fragmented;
+	int		errors;
+	uint32_t	freq;
+	uint8_t		mode;
+	uint8_t		blocks;
+	uint8_t		subbands;
+	uint8_t		bitpool;
+	int		frame_len;
+};
+
+struct a2dp_stream {
+	uint8_t		used;
+	uint8_t		slot;
+	uint8_t		in;
+	uint8_t		seid;
+	uint16_t	dev_id;
+	uint16_t	handle;
+	uint16_t	cid;
+	uint8_t		codec;
+	uint8_t		conf[4];
+	uint8_t		configured;
+
+	uint32_t	packets;
+	uint64_t	bytes;
+	uint16_t	max_seq;
+	uint32_t	lost;
+	uint32_t	gaps;
+	uint32_t	reordered;
+	uint32_t	duplicates;
+
+	/* RFC 3550 jitter in usec scaled by 16 */
+	uint64_t	last;
+	uint32_t	last_ts;
+	uint32_t	jitter;
+	uint32_t	jitter_max;
+
+	/* SBC frames */
+	uint32_t	freq;
+	uint8_t		mode;
+	uint8_t		blocks;
+	uint8_t		subbands;
+	uint8_t		bitpool_min;
+	uint8_t		bitpool_max;
+	uint64_t	frames;
+	uint32_t	frame_errors;
+	uint32_t	fragmented;
+	uint32_t	codec_rate;	/* bit/s of the last frame */
+
+	/* Effective bitrate per second */
+	uint64_t	first;
+	uint64_t	seen;		/* Arrival of the latest packet */
+	uint64_t	bucket;		/* Start of the current second */
+	uint8_t		partial;	/* Stream started within the second */
+	uint32_t	bucket_bytes;
+	uint32_t	bucket_packets;
+	uint32_t	bucket_frames;
+	uint32_t	rate_min;	/* bit/s over full seconds */
+	uint32_t	rate_max;
+	uint32_t	seconds;
+
+	/* Codec payload extraction */
+	FILE		*file;
+	FILE		*loss;		/* Sidecar with the missing packets */
+	char		*name;
+	uint64_t	written;
+};
+
+static struct a2dp_config configs[MAX_CONFIGS];
+static struct a2dp_stream streams[MAX_STREAMS];
+
+/* SEID of the last Open per device slot and handle */
+static struct {
+	uint16_t	handle;
+	uint8_t		seid;
+} opened[DEVICE_SLOTS];
+
+static FILE *a2dp_log;
+
+/* Set once the table full warning has been given */
+static int streams_full = 0;
+static int configs_full = 0;
+
+static char *media_base = NULL;
+static int media_count = 0;
+static unsigned long media_skipped = 0;
+
+static const uint32_t sbc_freq[] = { 16000, 32000, 44100, 48000 };
+
+static const char *sbc_mode[] = {
+	"Mono", "DualChannel", "Stereo", "JointStereo"
+};
+
+static inline uint16_t get_be16(const uint8_t *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static inline uint32_t get_be32(const uint8_t *p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+void a2dp_init(int fd)
+{
+	if (fd < 0)
+		return;
+
+	a2dp_log = fdopen(fd, "w");
+	if (!a2dp_log) {
+		perror("Can't open A2DP log");
+		exit(1);
+	}
+
+	fprintf(a2dp_log, "time\tdev\thandle\tcid\tpackets\tframes\tbytes"
+						"\tbitrate\tbitpool\tlost\n");
+}
+
+void a2dp_extract_init(const char *base)
+{
+	media_base = strdup(base);
+	if (!media_base) {
+		perror("Can't allocate memory");
+		exit(1);
+	}
+}
+
+static const char *codec_str(uint8_t codec)
+{
+	switch (codec) {
+	case 0x00:
+		return "SBC";
+	case 0x01:
+		return "MPEG-1,2";
+	case 0x02:
+		return "MPEG-2,4 AAC";
+	case 0x04:
+		return "ATRAC";
+	case 0xff:
+		return "vendor";
+	default:
+		return "unknown";
+	}
+}
+
+/* Length of the SBC frame at data, 0 if there is none */
+static int sbc_frame(const uint8_t *data, int len, struct sbc_info *info)
+{
+	int blocks, subbands, channels, bits;
+
+	if (len < 4 || data[0] != SBC_SYNCWORD)
+		return 0;
+
+	info->freq     = sbc_freq[data[1] >> 6];
+	info->blocks   = 4 * (((data[1] >> 4) & 0x03) + 1);
+	info->mode     = (data[1] >> 2) & 0x03;
+	info->subbands = data[1] & 0x01 ? 8 : 4;
+	info->bitpool  = data[2];
+
+	blocks   = info->blocks;
+	subbands = info->subbands;
+	channels = info->mode ? 2 : 1;
+
+	switch (info->mode) {
+	case 0x02:
+		bits = blocks * info->bitpool;
+		break;
+	case 0x03:
+		bits = subbands + blocks * info->bitpool;
+		break;
+	default:
+		bits = blocks * channels * info->bitpool;
+		break;
+	}
+
+	return 4 + (4 * subbands * channels) / 8 + (bits + 7) / 8;
+}
+
+/*
+ * Walks the frames of an SBC media payload behind the RTP header. Every
+ * frame has to start with the syncword where the previous one ends.
+ */
+static void sbc_parse(const uint8_t *data, int len, struct sbc_info *info)
+{
+	memset(info, 0, sizeof(*info));
+
+	if (len < 1)
+		return;
+
+	info->fragmented = data[0] & 0x80;
+	info->count = data[0] & 0x0f;
+	data++;
+	len--;
+
+	if (info->fragmented)
+		return;
+
+	while (len > 0) {
+		struct sbc_info frame;
+		int size = sbc_frame(data, len, &frame);
+
+		if (!size || size > len) {
+			info->errors++;
+			break;
+		}
+
+		if (!info->frames) {
+			info->freq      = frame.freq;
+			info->mode      = frame.mode;
+			info->blocks    = frame.blocks;
+			info->subbands  = frame.subbands;
+			info->bitpool   = frame.bitpool;
+			info->frame_len = size;
+		}
+
+		info->frames++;
+		data += size;
+		len -= size;
+	}
+
+	if (info->frames != info->count)
+		info->errors++;
+}
+
+/* Offset of the payload behind the RTP header, 0 if it is cut short */
+static int rtp_payload(const uint8_t *data, int len)
+{
+	int off = RTP_HDR_SIZE + (data[0] & 0x0f) * 4;
+
+	if (len < off)
+		return 0;
+
+	if (data[0] & 0x10) {
+		if (len < off + 4)
+			return 0;
+		off += 4 + get_be16(data + off + 2) * 4;
+	}
+
+	return len >= off ? off : 0;
+}
+
+static struct a2dp_config *get_config(uint16_t handle, uint8_t seid, int create)
+{
+	struct a2dp_config *c, *free_cfg = NULL;
+	int i;
+
+	for (i = 0; i < MAX_CONFIGS; i++) {
+		c = &configs[i];
+
+		if (!c->used) {
+			if (!free_cfg)
+				free_cfg = c;
+			continue;
+		}
+
+		if (c->slot == parser.slot && c->handle == handle &&
+							c->seid == seid)
+			return c;
+	}
+
+	if (!create)
+		return NULL;
+
+	if (!free_cfg) {
+		if (!configs_full)
+			fprintf(stderr, "Too many A2DP configurations\n");
+		configs_full = 1;
+		return NULL;
+	}
+
+	memset(free_cfg, 0, sizeof(*free_cfg));
+	free_cfg->used   = 1;
+	free_cfg->slot   = parser.slot;
+	free_cfg->handle = handle;
+	free_cfg->seid   = seid;
+
+	return free_cfg;
+}
+
+/* Remember the media codec of a Set Configuration or Reconfigure */
+static void request_config(uint16_t handle, uint8_t label, uint8_t seid,
+						const uint8_t *caps, int len)
+{
+	struct a2dp_config *c;
+
+	while (len >= 2) {
+		uint8_t cat = caps[0], size = caps[1];
+
+		if (size > len - 2)
+			break;
+
+		/* Media codec, media type and codec type first */
+		if (cat == 0x07 && size >= 2) {
+			c = get_config(handle, seid, 1);
+			if (!c)
+				return;
+
+			c->pending    = 1;
+			c->label      = label;
+			c->next_codec = caps[3];
+			memset(c->next_conf, 0, sizeof(c->next_conf));
+			memcpy(c->next_conf, caps + 4,
+					size - 2 > 4 ? 4 : size - 2);
+			return;
+		}
+
+		caps += 2 + size;
+		len -= 2 + size;
+	}
+}
+
+static void apply_config(struct a2dp_config *c)
+{
+	int i;
+
+	for (i = 0; i < MAX_STREAMS; i++) {
+		struct a2dp_stream *s = &streams[i];
+
+		if (!s->used || s->slot != c->slot || s->handle != c->handle ||
+							s->seid != c->seid)
+			continue;
+
+		s->codec = c->codec;
+		memcpy(s->conf, c->conf, sizeof(s->conf));
+		s->configured = 1;
+	}
+}
+
+static void accept_config(uint16_t handle, uint8_t label, uint64_t now)
+{
+	int i;
+
+	for (i = 0; i < MAX_CONFIGS; i++) {
+		struct a2dp_config *c = &configs[i];
+
+		if (!c->used || !c->pending || c->slot != parser.slot ||
+				c->handle != handle || c->label != label)
+			continue;
+
+		c->pending = 0;
+		c->valid   = 1;
+		c->codec   = c->next_codec;
+		c->when    = now;
+		memcpy(c->conf, c->next_conf, sizeof(c->conf));
+
+		apply_config(c);
+	}
+}
+
+static void reject_config(uint16_t handle, uint8_t label)
+{
+	int i;
+
+	for (i = 0; i < MAX_CONFIGS; i++) {
+		struct a2dp_config *c = &configs[i];
+
+		if (c->used && c->pending && c->slot == parser.slot &&
+				c->handle == handle && c->label == label)
+			c->pending = 0;
+	}
+}
+
+/* Only single packet signals carry what is needed here */
+static void a2dp_signal(struct frame *frm, uint64_t now)
+{
+	const uint8_t *data = frm->ptr;
+	int len = frm->len, i;
+	uint8_t hdr, sid, label;
+
+	if (len < 2)
+		return;
+
+	hdr = data[0];
+	if (hdr & 0x0c)
+		return;
+
+	label = hdr >> 4;
+	sid = data[1] & 0x3f;
+
+	switch (hdr & 0x03) {
+	case 0x00:
+		if (sid == SIG_SET_CONFIGURATION && len >= 4)
+			request_config(frm->handle, label, data[2] >> 2,
+							data + 4, len - 4);
+		else if (sid == SIG_RECONFIGURE && len >= 3)
+			request_config(frm->handle, label, data[2] >> 2,
+							data + 3, len - 3);
+		else if (sid == SIG_OPEN && len >= 3) {
+			opened[parser.slot].handle = frm->handle;
+			opened[parser.slot].seid = data[2] >> 2;
+		} else if (sid == SIG_START) {
+			/* Media times start over after a suspend */
+			for (i = 0; i < MAX_STREAMS; i++)
+				if (streams[i].used &&
+					streams[i].slot == parser.slot &&
+					streams[i].handle == frm->handle)
+					streams[i].last = 0;
+		}
+		break;
+
+	case 0x02:
+		if (sid == SIG_SET_CONFIGURATION || sid == SIG_RECONFIGURE)
+			accept_config(frm->handle, label, now);
+		break;
+
+	case 0x03:
+		if (sid == SIG_SET_CONFIGURATION || sid == SIG_RECONFIGURE)
+			reject_config(frm->handle, label);
+		break;
+	}
+}
+
+/*
+ * A new media channel belongs to the stream endpoint that was opened
+ * last on the link, or else to the configuration accepted last.
+ */
+static void bind_config(struct a2dp_stream *s)
+{
+	struct a2dp_config *c = NULL;
+	int i;
+
+	if (opened[parser.slot].handle == s->handle)
+		c = get_config(s->handle, opened[parser.slot].seid, 0);
+
+	if (!c || !c->valid) {
+		c = NULL;
+		for (i = 0; i < MAX_CONFIGS; i++) {
+			struct a2dp_config *t = &configs[i];
+
+			if (t->used && t->valid && t->slot == parser.slot &&
+					t->handle == s->handle &&
+					(!c || t->when > c->when))
+				c = t;
+		}
+	}
+
+	if (!c)
+		return;
+
+	s->seid  = c->seid;
+	s->codec = c->codec;
+	memcpy(s->conf, c->conf, sizeof(s->conf));
+	s->configured = 1;
+}
+
+static struct a2dp_stream *find_stream(struct frame *frm)
+{
+	struct a2dp_stream *s;
+	int i;
+
+	for (i = 0; i < MAX_STREAMS; i++) {
+		s = &streams[i];
+
+		if (s->used && s->slot == parser.slot &&
+				s->handle == frm->handle &&
+				s->cid == frm->cid && s->in == frm->in)
+			return s;
+	}
+
+	return NULL;
+}
+
+static struct a2dp_stream *get_stream(struct frame *frm)
+{
+	struct a2dp_stream *s = find_stream(frm), *free_s = NULL;
+	int i;
+
+	if (s)
+		return s;
+
+	for (i = 0; i < MAX_STREAMS && !free_s; i++)
+		if (!streams[i].used)
+			free_s = &streams[i];
+
+	if (!free_s) {
+		if (!streams_full)
+			fprintf(stderr, "Too many A2DP streams\n");
+		streams_full = 1;
+		return NULL;
+	}
+
+	s = free_s;
+	memset(s, 0, sizeof(*s));
+	s->used        = 1;
+	s->slot        = parser.slot;
+	s->in          = frm->in;
+	s->dev_id      = frm->dev_id;
+	s->handle      = frm->handle;
+	s->cid         = frm->cid;
+	s->bitpool_min = 0xff;
+
+	bind_config(s);
+
+	return s;
+}
+
+static void flush_bucket(struct a2dp_stream *s, int full)
+{
+	uint32_t rate = s->bucket_bytes * 8;
+
+	if (!s->bucket_packets)
+		return;
+
+	if (full) {
+		if (!s->seconds || rate < s->rate_min)
+			s->rate_min = rate;
+		if (rate > s->rate_max)
+			s->rate_max = rate;
+		s->seconds++;
+	}
+
+	if (a2dp_log)
+		fprintf(a2dp_log, "%llu\t%d\t%d\t0x%4.4x\t%u\t%u\t%u\t%u"
+				"\t%u\t%u\n",
+				(unsigned long long) (s->bucket / 1000000),
+				s->dev_id, s->handle, s->cid, s->bucket_packets,
+				s->bucket_frames, s->bucket_bytes, rate,
+				s->bitpool_max != 0xff ? s->bitpool_max : 0,
+				s->lost);
+
+	s->bucket_bytes   = 0;
+	s->bucket_packets = 0;
+	s->bucket_frames  = 0;
+}
+
+/* Number of packets missing before this one, or how it is out of order */
+static int sequence(struct a2dp_stream *s, uint16_t seq)
+{
+	int16_t diff;
+
+	if (!s->packets) {
+		s->max_seq = seq;
+		return 0;
+	}
+
+	diff = seq - (uint16_t) (s->max_seq + 1);
+
+	if (diff > 0) {
+		s->gaps++;
+		s->lost += diff;
+	} else if (diff == -1) {
+		s->duplicates++;
+		return SEQ_DUPLICATE;
+	} else if (diff < 0) {
+		/* Turned up late after all */
+		s->reordered++;
+		if (s->lost)
+			s->lost--;
+		return SEQ_LATE;
+	}
+
+	s->max_seq = seq;
+
+	return diff;
+}
+
+/*
+ * Without a configuration the codec is guessed from the payload, SBC
+ * media payloads start with a header byte and then the syncword.
+ */
+static void open_media(struct a2dp_stream *s, const uint8_t *data, int len)
+{
+	const char *ext;
+	uint8_t codec;
+
+	if (s->configured)
+		codec = s->codec;
+	else if (len > 1 && data[1] == SBC_SYNCWORD)
+		codec = CODEC_SBC;
+	else
+		codec = 0xff;
+
+	switch (codec) {
+	case CODEC_SBC:
+		ext = ".sbc";
+		break;
+	case CODEC_MPEG12:
+		ext = ".mp3";
+		break;
+	case CODEC_MPEG24:
+		ext = ".latm";
+		break;
+	default:
+		ext = ".raw";
+		break;
+	}
+
+	s->codec = codec;
+
+	s->name = malloc(strlen(media_base) + 18);
+	if (!s->name) {
+		perror("Can't allocate memory");
+		exit(1);
+	}
+
+	sprintf(s->name, "%s-%d.loss", media_base, ++media_count);
+	s->loss = fopen(s->name, "w");
+	if (!s->loss) {
+		perror("Can't open loss file");
+		return;
+	}
+
+	fprintf(s->loss, "time\tseq\tevent\tpackets\toffset\n");
+
+	sprintf(s->name, "%s-%d%s", media_base, media_count, ext);
+	s->file = fopen(s->name, "w");
+	if (!s->file) {
+		perror("Can't open media file");
+		return;
+	}
+
+	setvbuf(s->file, NULL, _IOFBF, MEDIA_BUF_SIZE);
+
+	fprintf(stderr, "a2dp: hci%d handle %d cid 0x%4.4x %s %s -> %s\n",
+				s->dev_id, s->handle, s->cid,
+				s->in ? "in" : "out", codec_str(codec), s->name);
+}
+
+/*
+ * The codec data goes straight from the reassembled frame to the file,
+ * without the RTP header and without the media payload header of the
+ * codecs that have one.
+ */
+static void write_media(struct a2dp_stream *s, const struct timeval *ts,
+			uint16_t seq, int order, const uint8_t *data, int len)
+{
+	if (!s->name)
+		open_media(s, data, len);
+
+	if (!s->file)
+		return;
+
+	if (order > 0 || order == SEQ_LATE)
+		fprintf(s->loss, "%lu.%06lu\t%u\t%s\t%d\t%llu\n",
+				(unsigned long) ts->tv_sec,
+				(unsigned long) ts->tv_usec, seq,
+				order > 0 ? "lost" : "late", order > 0 ? order : 1,
+				(unsigned long long) s->written);
+
+	/* A repeated packet would only corrupt the bitstream */
+	if (order == SEQ_DUPLICATE)
+		return;
+
+	switch (s->codec) {
+	case CODEC_SBC:
+		data++;
+		len--;
+		break;
+	case CODEC_MPEG12:
+		data += 4;
+		len -= 4;
+		break;
+	}
+
+	if (len <= 0)
+		return;
+
+	fwrite(data, len, 1, s->file);
+	s->written += len;
+}
+
+static void close_media(struct a2dp_stream *s)
+{
+	if (s->file && fclose(s->file) < 0)
+		perror("Write error");
+
+	if (s->loss && fclose(s->loss) < 0)
+		perror("Write error");
+
+	if (s->file)
+		fprintf(stderr, "a2dp: %s %u packets %llu bytes %u lost "
+				"%u late\n", s->name, s->packets,
+				(unsigned long long) s->written, s->lost,
+				s->reordered);
+
+	free(s->name);
+	s->file = NULL;
+	s->loss = NULL;
+	s->name = NULL;
+}
+
+/* Media that found no room in the stream table, told once per channel */
+static void not_extracted(struct frame *frm)
+{
+	static uint16_t dev_id, handle, cid;
+	static int in = -1;
+
+	media_skipped++;
+
+	if (frm->dev_id == dev_id && frm->handle == handle &&
+					frm->cid == cid && frm->in == in)
+		return;
+
+	dev_id = frm->dev_id;
+	handle = frm->handle;
+	cid    = frm->cid;
+	in     = frm->in;
+
+	fprintf(stderr, "a2dp: hci%d handle %d cid 0x%4.4x %s not extracted\n",
+				dev_id, handle, cid, in ? "in" : "out");
+}
+
+static void media(struct frame *frm, uint64_t now)
+{
+	const uint8_t *data = frm->ptr;
+	int len = frm->len, off;
+	struct a2dp_stream *s;
+	struct sbc_info info;
+	uint16_t seq;
+	uint32_t ts;
+	int in_order, order;
+
+	if (len < RTP_HDR_SIZE || (data[0] >> 6) != 2)
+		return;
+
+	off = rtp_payload(data, len);
+	if (!off)
+		return;
+
+	s = get_stream(frm);
+	if (!s) {
+		if (media_base)
+			not_extracted(frm);
+		return;
+	}
+
+	seq = get_be16(data + 2);
+	ts  = get_be32(data + 4);
+
+	in_order = !s->packets || (int16_t) (seq - s->max_seq) > 0;
+	order = sequence(s, seq);
+
+	if (media_base)
+		write_media(s, &frm->ts, seq, order, data + off, len - off);
+
+	memset(&info, 0, sizeof(info));
+	if (!s->configured || s->codec == CODEC_SBC) {
+		sbc_parse(data + off, len - off, &info);
+
+		if (info.fragmented)
+			s->fragmented++;
+		s->frame_errors += info.errors;
+		s->frames += info.frames;
+
+		if (info.frames) {
+			s->freq     = info.freq;
+			s->mode     = info.mode;
+			s->blocks   = info.blocks;
+			s->subbands = info.subbands;
+			if (info.bitpool < s->bitpool_min)
+				s->bitpool_min = info.bitpool;
+			if (s->bitpool_max == 0xff || info.bitpool > s->bitpool_max)
+				s->bitpool_max = info.bitpool;
+			s->codec_rate = (uint64_t) info.frame_len * 8 *
+					info.freq / (info.blocks * info.subbands);
+		}
+	}
+
+	/* Time stamps count samples at the sampling frequency */
+	if (in_order && s->freq) {
+		if (s->last) {
+			int64_t d = (int64_t) (now - s->last) -
+					(int64_t) (int32_t) (ts - s->last_ts) *
+							1000000 / s->freq;
+			if (d < 0)
+				d = -d;
+
+			s->jitter += d - ((s->jitter + 8) >> 4);
+			if (s->jitter > s->jitter_max)
+				s->jitter_max = s->jitter;
+		}
+
+		s->last = now;
+		s->last_ts = ts;
+	}
+
+	if (!s->packets)
+		s->first = now;
+
+	/* Seconds the stream started or resumed in don't count as full */
+	if (now - s->bucket >= 1000000) {
+		flush_bucket(s, !s->partial && now - s->bucket < 2000000);
+		s->partial = !s->packets || now - s->bucket >= 2000000;
+		s->bucket = now - now % 1000000;
+	}
+
+	s->seen = now;
+	s->packets++;
+	s->bytes += len;
+	s->bucket_packets++;
+	s->bucket_bytes += len;
+	s->bucket_frames += info.frames;
+}
+
+void a2dp_frame(struct frame *frm)
+{
+	uint64_t now = frm->ts.tv_sec * 1000000ull + frm->ts.tv_usec;
+
+	switch (frm->num) {
+	case 1:
+		a2dp_signal(frm, now);
+		break;
+	case 2:
+		media(frm, now);
+		break;
+	}
+}
+
+/*
+ * One line about the SBC frames instead of the media payload, false for
+ * streams configured with another codec
+ */
+int a2dp_media_dump(int level, struct frame *frm)
+{
+	struct a2dp_stream *s = find_stream(frm);
+	struct sbc_info info;
+
+	if (s && s->configured && s->codec != CODEC_SBC)
+		return 0;
+
+	sbc_parse(frm->ptr, frm->len, &info);
+
+	p_indent(level, frm);
+
+	if (info.fragmented) {
+		printf("SBC: fragment, %d frames left\n", info.count);
+		return 1;
+	}
+
+	if (!info.frames) {
+		printf("SBC: no frames in %d bytes\n", frm->len);
+		return 1;
+	}
+
+	printf("SBC: %d frames %s%.1fkHz %s %d blocks %d subbands bitpool %d\n",
+			info.frames, info.errors ? "(broken) " : "",
+			info.freq / 1000.0, sbc_mode[info.mode],
+			info.blocks, info.subbands, info.bitpool);
+
+	return 1;
+}
+
+static void print_stream(FILE *out, struct a2dp_stream *s)
+{
+	uint64_t avg = 0;
+
+	if (s->seen > s->first)
+		avg = s->bytes * 8 * 1000000 / (s->seen - s->first);
+
+	fprintf(out, "a2dp: hci%d handle %d cid 0x%4.4x %s %s packets %u "
+			"bytes %llu\n", s->dev_id, s->handle, s->cid,
+			s->in ? "in" : "out",
+			s->configured ? codec_str(s->codec) : "unconfigured",
+			s->packets, (unsigned long long) s->bytes);
+
+	fprintf(out, "  lost %u in %u gaps reordered %u duplicates %u "
+			"jitter %.3f ms max %.3f ms\n", s->lost, s->gaps,
+			s->reordered, s->duplicates,
+			(s->jitter >> 4) / 1000.0,
+			(s->jitter_max >> 4) / 1000.0);
+
+	if (s->configured && s->codec == CODEC_SBC)
+		fprintf(out, "  configured bitpool %d-%d\n",
+					s->conf[2], s->conf[3]);
+
+	if (s->frames)
+		fprintf(out, "  sbc %.1fkHz %s %d blocks %d subbands "
+				"bitpool %d-%d frames %llu (%.1f per packet) "
+				"errors %u fragmented %u codec %u kbit/s\n",
+				s->freq / 1000.0, sbc_mode[s->mode],
+				s->blocks, s->subbands, s->bitpool_min,
+				s->bitpool_max,
+				(unsigned long long) s->frames,
+				(double) s->frames / s->packets,
+				s->frame_errors, s->fragmented,
+				s->codec_rate / 1000);
+
+	fprintf(out, "  bitrate avg %llu min %u max %u kbit/s "
+			"over %u s\n", (unsigned long long) avg / 1000,
+			s->rate_min / 1000, s->rate_max / 1000,
+			s->seconds);
+}
+
+void a2dp_dump(FILE *out)
+{
+	int i;
+
+	for (i = 0; i < MAX_STREAMS; i++)
+		if (streams[i].used && streams[i].packets)
+			print_stream(out, &streams[i]);
+
+	if (a2dp_log)
+		fflush(a2dp_log);
+
+	fflush(out);
+}
+
+/* A stream that ends early is reported then and makes room for others */
+static void release_stream(struct a2dp_stream *s)
+{
+	flush_bucket(s, 0);
+	close_media(s);
+
+	if ((parser.flags & DUMP_A2DP) && s->packets)
+		print_stream(stderr, s);
+
+	s->used = 0;
+}
+
+/* Closed AVDTP channel, in is the direction of the frames it carried */
+void a2dp_channel_close(uint16_t handle, uint16_t cid, int in)
+{
+	int i;
+
+	for (i = 0; i < MAX_STREAMS; i++) {
+		struct a2dp_stream *s = &streams[i];
+
+		if (s->used && s->slot == parser.slot && s->handle == handle &&
+						s->cid == cid && s->in == in)
+			release_stream(s);
+	}
+}
+
+void a2dp_disconnect(uint16_t handle)
+{
+	int i;
+
+	for (i = 0; i < MAX_STREAMS; i++)
+		if (streams[i].used && streams[i].slot == parser.slot &&
+					streams[i].handle == handle)
+			release_stream(&streams[i]);
+
+	for (i = 0; i < MAX_CONFIGS; i++)
+		if (configs[i].used && configs[i].slot == parser.slot &&
+					configs[i].handle == handle)
+			configs[i].used = 0;
+
+	if (opened[parser.slot].handle == handle)
+		opened[parser.slot].seid = 0;
+}
+
+void a2dp_close(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_STREAMS; i++)
+		if (streams[i].used) {
+			flush_bucket(&streams[i], 0);
+			close_media(&streams[i]);
+		}
+
+	if (media_skipped)
+		fprintf(stderr, "a2dp: %lu media packets not extracted\n",
+							media_skipped);
+
+	if (a2dp_log && fclose(a2dp_log) < 0)
+		perror("Write error");
+
+	a2dp_log = NULL;
+}
@@ -0,0 +1,303 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+
+#include "parser.h"
+
+#define ADV_SLOTS	4096
+#define ADV_PROBE	16
+#define ADV_DATA_SIZE	31
+#define ADV_NO_RSSI	127
+
+struct adv_entry {
+	uint8_t		used;
+	uint8_t		slot;		/* Device slot */
+	uint8_t		bdaddr_type;
+	uint8_t		evt_type;
+	bdaddr_t	bdaddr;
+	uint8_t		len;
+	uint8_t		data[ADV_DATA_SIZE];
+	uint64_t	shown;		/* Time the report was last printed */
+	struct adv_stats stats;
+};
+
+static struct adv_entry adv_table[ADV_SLOTS];
+
+static uint64_t interval;	/* Minimum time between repeats in usec */
+static unsigned long adv_reports = 0;
+static unsigned long adv_dropped = 0;
+static unsigned long adv_evicted = 0;
+
+void adv_init(int msec)
+{
+	interval = (msec > 0 ? msec : 10000) * 1000ull;
+}
+
+static inline unsigned int adv_hash(const bdaddr_t *ba, uint8_t type,
+							uint8_t evt_type)
+{
+	const uint8_t *b = (const uint8_t *) ba;
+	unsigned int h = 2166136261u;
+	int i;
+
+	for (i = 0; i < 6; i++)
+		h = (h ^ b[i]) * 16777619;
+
+	h = (h ^ type) * 16777619;
+	h = (h ^ evt_type) * 16777619;
+	h = (h ^ parser.slot) * 16777619;
+
+	return h;
+}
+
+static inline int adv_match(struct adv_entry *e, const bdaddr_t *ba,
+						uint8_t type, uint8_t evt_type)
+{
+	return e->used && e->slot == parser.slot && e->bdaddr_type == type &&
+			e->evt_type == evt_type && !bacmp(&e->bdaddr, ba);
+}
+
+static struct adv_entry *adv_find(const bdaddr_t *ba, uint8_t type,
+							uint8_t evt_type)
+{
+	unsigned int h = adv_hash(ba, type, evt_type);
+	int i;
+
+	for (i = 0; i < ADV_PROBE; i++) {
+		struct adv_entry *e = &adv_table[(h + i) % ADV_SLOTS];
+
+		if (adv_match(e, ba, type, evt_type))
+			return e;
+		if (!e->used)
+			break;
+	}
+
+	return NULL;
+}
+
+struct adv_stats *adv_get(const bdaddr_t *ba, uint8_t type, uint8_t evt_type)
+{
+	struct adv_entry *e = adv_find(ba, type, evt_type);
+
+	return e ? &e->stats : NULL;
+}
+
+/*
+ * Entries are never removed, so a full probe window takes over the
+ * advertiser that has gone longest without being heard. That keeps
+ * lookups bounded when private addresses keep rotating.
+ */
+static struct adv_entry *adv_add(const bdaddr_t *ba, uint8_t type,
+							uint8_t evt_type)
+{
+	unsigned int h = adv_hash(ba, type, evt_type);
+	struct adv_entry *e, *oldest = NULL;
+	int i;
+
+	for (i = 0; i < ADV_PROBE; i++) {
+		e = &adv_table[(h + i) % ADV_SLOTS];
+
+		if (!e->used) {
+			oldest = e;
+			break;
+		}
+
+		if (!oldest || e->stats.last < oldest->stats.last)
+			oldest = e;
+	}
+
+	if (oldest->used)
+		adv_evicted++;
+
+	memset(oldest, 0, sizeof(*oldest));
+	oldest->used = 1;
+	oldest->slot = parser.slot;
+	oldest->bdaddr_type = type;
+	oldest->evt_type = evt_type;
+	bacpy(&oldest->bdaddr, ba);
+	oldest->stats.rssi_min = 127;
+	oldest->stats.rssi_max = -128;
+
+	return oldest;
+}
+
+/* Update the advertisers of the report, true if none of them is news */
+int __adv_skip(struct frame *frm)
+{
+	struct adv_entry *list[32];
+	const uint8_t *data = frm->ptr;
+	int len = frm->len, show = 0;
+	uint8_t num_reports;
+	uint64_t now;
+	int i, n = 0;
+
+	/* Packet type, event header, subevent and number of reports */
+	if (len < 5 || data[0] != HCI_EVENT_PKT ||
+			data[1] != EVT_LE_META_EVENT ||
+			data[3] != EVT_LE_ADVERTISING_REPORT)
+		return 0;
+
+	now = frm->ts.tv_sec * 1000000ull + frm->ts.tv_usec;
+	num_reports = data[4];
+	data += 5;
+	len -= 5;
+
+	while (num_reports--) {
+		const le_advertising_info *info = (const void *) data;
+		struct adv_entry *e;
+		int8_t rssi;
+		int size;
+
+		if (len < LE_ADVERTISING_INFO_SIZE)
+			break;
+
+		size = LE_ADVERTISING_INFO_SIZE + info->length;
+		if (len < size + 1)
+			break;
+
+		rssi = data[size];
+
+		e = adv_find(&info->bdaddr, info->bdaddr_type, info->evt_type);
+		if (!e) {
+			e = adv_add(&info->bdaddr, info->bdaddr_type,
+							info->evt_type);
+			show = 1;
+		}
+
+		if (info->length > ADV_DATA_SIZE || e->len != info->length ||
+				memcmp(e->data, info->data, info->length)) {
+			e->len = info->length > ADV_DATA_SIZE ?
+						ADV_DATA_SIZE : info->length;
+			memcpy(e->data, info->data, e->len);
+			show = 1;
+		}
+
+		if (now - e->shown >= interval)
+			show = 1;
+
+		e->stats.count++;
+		e->stats.last = now;
+
+		/* 127 means the controller had no RSSI for this one */
+		if (rssi != ADV_NO_RSSI) {
+			e->stats.rssi_count++;
+			e->stats.rssi_sum += rssi;
+			if (rssi < e->stats.rssi_min)
+				e->stats.rssi_min = rssi;
+			if (rssi > e->stats.rssi_max)
+				e->stats.rssi_max = rssi;
+		}
+
+		if (n < 32)
+			list[n++] = e;
+
+		adv_reports++;
+		data += size + 1;
+		len -= size + 1;
+	}
+
+	if (!show) {
+		adv_dropped++;
+		return 1;
+	}
+
+	for (i = 0; i < n; i++)
+		list[i]->shown = now;
+
+	return 0;
+}
+
+static int cmp_entry(const void *a, const void *b)
+{
+	const struct adv_entry *ea = *(struct adv_entry * const *) a;
+	const struct adv_entry *eb = *(struct adv_entry * const *) b;
+
+	if (ea->stats.count != eb->stats.count)
+		return ea->stats.count < eb->stats.count ? 1 : -1;
+
+	return memcmp(&ea->bdaddr, &eb->bdaddr, sizeof(bdaddr_t));
+}
+
+void adv_dump(FILE *out)
+{
+	struct adv_entry **list;
+	char addr[18];
+	int i, n = 0;
+
+	list = malloc(ADV_SLOTS * sizeof(*list));
+	if (!list) {
+		perror("Can't allocate advertiser list");
+		return;
+	}
+
+	for (i = 0; i < ADV_SLOTS; i++)
+		if (adv_table[i].used)
+			list[n++] = &adv_table[i];
+
+	qsort(list, n, sizeof(list[0]), cmp_entry);
+
+	fprintf(out, "advertising: %lu reports %lu frames suppressed "
+			"%d advertisers %lu evicted\n", adv_reports,
+			adv_dropped, n, adv_evicted);
+	fprintf(out, "  %-17s %-6s %4s %8s %5s %5s %5s %17s\n", "bdaddr",
+			"type", "evt", "count", "min", "avg", "max", "last seen");
+
+	for (i = 0; i < n; i++) {
+		struct adv_entry *e = list[i];
+		struct adv_stats *s = &e->stats;
+
+		p_ba2str(&e->bdaddr, addr);
+
+		fprintf(out, "  %-17s %-6s %4d %8u ", addr,
+				e->bdaddr_type ? "random" : "public",
+				e->evt_type, s->count);
+		if (s->rssi_count)
+			fprintf(out, "%5d %5d %5d ", s->rssi_min,
+				(int) (s->rssi_sum / (int64_t) s->rssi_count),
+				s->rssi_max);
+		else
+			fprintf(out, "%5s %5s %5s ", "-", "-", "-");
+		fprintf(out, "%10llu.%06llu\n",
+				(unsigned long long) (s->last / 1000000),
+				(unsigned long long) (s->last % 1000000));
+	}
+
+	free(list);
+	fflush(out);
+}
@@ -257,6 +257,59 @@ static const char *uuid2str(uint16_t uuid)
 	}
 }
 
+/* Handles belong to the database of the server, the peer if it sent them */
+static void att_attr_name(struct frame *frm, uint16_t attr, int remote)
+{
+	const char *name = gatt_name(parser.slot, frm->handle, attr, remote);
+
+	if (name)
+		printf(" (%s)", name);
+}
+
+/* Octets an opcode needs before any of its lists or values */
+static int att_min_len(uint8_t op)
+{
+	switch (op) {
+	case ATT_OP_FIND_INFO_RESP:
+	case ATT_OP_READ_BY_TYPE_RESP:
+	case ATT_OP_READ_BY_GROUP_RESP:
+	case ATT_OP_EXEC_WRITE_REQ:
+		return 1;
+	case ATT_OP_MTU_REQ:
+	case ATT_OP_MTU_RESP:
+	case ATT_OP_READ_REQ:
+	case ATT_OP_WRITE_REQ:
+	case ATT_OP_WRITE_CMD:
+	case ATT_OP_HANDLE_NOTIFY:
+		return 2;
+	case ATT_OP_ERROR:
+	case ATT_OP_FIND_INFO_REQ:
+	case ATT_OP_READ_BY_TYPE_REQ:
+	case ATT_OP_READ_BY_GROUP_REQ:
+	case ATT_OP_READ_BLOB_REQ:
+	case ATT_OP_PREP_WRITE_REQ:
+	case ATT_OP_PREP_WRITE_RESP:
+		return 4;
+	case ATT_OP_FIND_BY_TYPE_REQ:
+		return 6;
+	case ATT_OP_SIGNED_WRITE_CMD:
+		return 14;
+	default:
+		return 0;
+	}
+}
+
+/* What is left after the last complete list entry */
+static void att_trailer(int level, struct frame *frm)
+{
+	if (!frm->len)
+		return;
+
+	p_indent(level, frm);
+	printf("truncated entry\n");
+	raw_dump(level, frm);
+}
+
 static void att_error_dump(int level, struct frame *frm)
 {
 	uint8_t op = get_u8(frm);
@@ -267,7 +320,9 @@ static void att_error_dump(int level, struct frame *frm)
 	printf("Error: %s (%d)\n", atterror2str(err), err);
 
 	p_indent(level, frm);
-	printf("%s (0x%.2x) on handle 0x%2.2x\n", attop2str(op), op, handle);
+	printf("%s (0x%.2x) on handle 0x%2.2x", attop2str(op), op, handle);
+	att_attr_name(frm, handle, frm->in);
+	printf("\n");
 }
 
 static void att_mtu_req_dump(int level, struct frame *frm)
@@ -304,17 +359,19 @@ static void att_find_info_resp_dump(int level, struct frame *frm)
 	if (fmt == 0x01) {
 		printf("format: uuid-16\n");
 
-		while (frm->len > 0) {
+		while (frm->len >= 4) {
 			uint16_t handle = btohs(htons(get_u16(frm)));
 			uint16_t uuid = btohs(htons(get_u16(frm)));
 			p_indent(level + 1, frm);
-			printf("handle 0x%2.2x, uuid 0x%2.2x (%s)\n", handle, uuid,
+			printf("handle 0x%2.2x, uuid 0x%2.2x (%s)", handle, uuid,
 					uuid2str(uuid));
+			att_attr_name(frm, handle, frm->in);
+			printf("\n");
 		}
 	} else {
 		printf("format: uuid-128\n");
 
-		while (frm->len > 0) {
+		while (frm->len >= 18) {
 			uint16_t handle = btohs(htons(get_u16(frm)));
 			int i;
 
@@ -325,9 +382,12 @@ static void att_find_info_resp_dump(int level, struct frame *frm)
 				if (i == 3 || i == 5 || i == 7 || i == 9)
 					printf("-");
 			}
+			att_attr_name(frm, handle, frm->in);
 			printf("\n");
 		}
 	}
+
+	att_trailer(level + 1, frm);
 }
 
 static void att_find_by_type_req_dump(int level, struct frame *frm)
@@ -348,14 +408,18 @@ static void att_find_by_type_req_dump(int level, struct frame *frm)
 
 static void att_find_by_type_resp_dump(int level, struct frame *frm)
 {
-	while (frm->len > 0) {
+	while (frm->len >= 4) {
 		uint16_t uuid = btohs(htons(get_u16(frm)));
 		uint16_t end = btohs(htons(get_u16(frm)));
 
 		p_indent(level, frm);
-		printf("Found attr 0x%4.4x, group end handle 0x%4.4x\n",
+		printf("Found attr 0x%4.4x, group end handle 0x%4.4x",
 								uuid, end);
+		att_attr_name(frm, uuid, frm->in);
+		printf("\n");
 	}
+
+	att_trailer(level, frm);
 }
 
 static void att_read_by_type_req_dump(int level, struct frame *frm)
@@ -392,18 +456,27 @@ static void att_read_by_type_resp_dump(int level, struct frame *frm)
 	p_indent(level, frm);
 	printf("length: %d\n", length);
 
-	while (frm->len > 0) {
+	if (length < 2) {
+		att_trailer(level + 1, frm);
+		return;
+	}
+
+	while (frm->len >= length) {
 		uint16_t handle = btohs(htons(get_u16(frm)));
 		int val_len = length - 2;
 		int i;
 
 		p_indent(level + 1, frm);
-		printf("handle 0x%2.2x, value ", handle);
+		printf("handle 0x%2.2x", handle);
+		att_attr_name(frm, handle, frm->in);
+		printf(", value ");
 		for (i = 0; i < val_len; i++) {
 			printf("0x%.2x ", get_u8(frm));
 		}
 		printf("\n");
 	}
+
+	att_trailer(level + 1, frm);
 }
 
 static void att_read_req_dump(int level, struct frame *frm)
@@ -411,7 +484,9 @@ static void att_read_req_dump(int level, struct frame *frm)
 	uint16_t handle = btohs(htons(get_u16(frm)));
 
 	p_indent(level, frm);
-	printf("handle 0x%2.2x\n", handle);
+	printf("handle 0x%2.2x", handle);
+	att_attr_name(frm, handle, !frm->in);
+	printf("\n");
 }
 
 static void att_read_blob_req_dump(int level, struct frame *frm)
@@ -420,7 +495,9 @@ static void att_read_blob_req_dump(int level, struct frame *frm)
 	uint16_t offset = btohs(htons(get_u16(frm)));
 
 	p_indent(level, frm);
-	printf("handle 0x%4.4x offset 0x%4.4x\n", handle, offset);
+	printf("handle 0x%4.4x offset 0x%4.4x", handle, offset);
+	att_attr_name(frm, handle, !frm->in);
+	printf("\n");
 }
 
 static void att_read_blob_resp_dump(int level, struct frame *frm)
@@ -438,10 +515,16 @@ static void att_read_multi_req_dump(int level, struct frame *frm)
 	p_indent(level, frm);
 	printf("Handles\n");
 
-	while (frm->len > 0) {
+	while (frm->len >= 2) {
+		uint16_t handle = btohs(htons(get_u16(frm)));
+
 		p_indent(level, frm);
-		printf("handle 0x%4.4x\n", btohs(htons(get_u16(frm))));
+		printf("handle 0x%4.4x", handle);
+		att_attr_name(frm, handle, !frm->in);
+		printf("\n");
 	}
+
+	att_trailer(level, frm);
 }
 
 static void att_read_multi_resp_dump(int level, struct frame *frm)
@@ -458,22 +541,31 @@ static void att_read_by_group_resp_dump(int level, struct frame *frm)
 {
 	uint8_t length = get_u8(frm);
 
-	while (frm->len > 0) {
+	if (length < 4) {
+		att_trailer(level, frm);
+		return;
+	}
+
+	while (frm->len >= length) {
 		uint16_t attr_handle = btohs(htons(get_u16(frm)));
 		uint16_t end_grp_handle = btohs(htons(get_u16(frm)));
 		uint8_t remaining = length - 4;
 
 		p_indent(level, frm);
-		printf("attr handle 0x%4.4x, end group handle 0x%4.4x\n",
+		printf("attr handle 0x%4.4x, end group handle 0x%4.4x",
 						attr_handle, end_grp_handle);
+		att_attr_name(frm, attr_handle, frm->in);
+		printf("\n");
 
 		p_indent(level, frm);
 		printf("value");
-		while (remaining > 0) {
+		while (remaining-- > 0) {
 			printf(" 0x%2.2x", get_u8(frm));
 		}
 		printf("\n");
 	}
+
+	att_trailer(level, frm);
 }
 
 static void att_write_req_dump(int level, struct frame *frm)
@@ -481,7 +573,9 @@ static void att_write_req_dump(int level, struct frame *frm)
 	uint16_t handle = btohs(htons(get_u16(frm)));
 
 	p_indent(level, frm);
-	printf("handle 0x%4.4x value ", handle);
+	printf("handle 0x%4.4x", handle);
+	att_attr_name(frm, handle, !frm->in);
+	printf(" value ");
 
 	while (frm->len > 0)
 		printf(" 0x%2.2x", get_u8(frm));
@@ -491,10 +585,13 @@ static void att_write_req_dump(int level, struct frame *frm)
 static void att_signed_write_dump(int level, struct frame *frm)
 {
 	uint16_t handle = btohs(htons(get_u16(frm)));
+	/* att_dump() made sure the signature is there */
 	int value_len = frm->len - 12; /* handle:2 already accounted, sig: 12 */
 
 	p_indent(level, frm);
-	printf("handle 0x%4.4x value ", handle);
+	printf("handle 0x%4.4x", handle);
+	att_attr_name(frm, handle, !frm->in);
+	printf(" value ");
 
 	while (value_len--)
 		printf(" 0x%2.2x", get_u8(frm));
@@ -507,14 +604,16 @@ static void att_signed_write_dump(int level, struct frame *frm)
 	printf("\n");
 }
 
-static void att_prep_write_dump(int level, struct frame *frm)
+static void att_prep_write_dump(int level, struct frame *frm, int resp)
 {
 	uint16_t handle = btohs(htons(get_u16(frm)));
 	uint16_t val_offset = btohs(htons(get_u16(frm)));
 
 	p_indent(level, frm);
-	printf("attr handle 0x%4.4x, value offset 0x%4.4x\n", handle,
+	printf("attr handle 0x%4.4x, value offset 0x%4.4x", handle,
 								val_offset);
+	att_attr_name(frm, handle, resp ? frm->in : !frm->in);
+	printf("\n");
 
 	p_indent(level, frm);
 	printf("part attr value ");
@@ -541,7 +640,9 @@ static void att_handle_notify_dump(int level, struct frame *frm)
 	uint16_t handle = btohs(htons(get_u16(frm)));
 
 	p_indent(level, frm);
-	printf("handle 0x%4.4x\n", handle);
+	printf("handle 0x%4.4x", handle);
+	att_attr_name(frm, handle, frm->in);
+	printf("\n");
 
 	p_indent(level, frm);
 	printf("value ");
@@ -550,15 +651,128 @@ static void att_handle_notify_dump(int level, struct frame *frm)
 	printf("\n");
 }
 
+/* ATT carries UUIDs in little endian order */
+static void att_uuid_field(const char *name, struct frame *frm, int size)
+{
+	uint8_t uuid[16];
+	int i;
+
+	for (i = size - 1; i >= 0; i--)
+		uuid[i] = get_u8(frm);
+
+	f_uuid(name, uuid, size);
+}
+
+/* Fields reported by the structured output */
+const char *att_field_names[] = {
+	"opcode", "name", "req", "handle", "error", "mtu", "start",
+	"end", "type", "offset", "vlen", "value", "flags", NULL
+};
+
+/* Structured counterpart of att_dump() */
+static void att_fields(uint8_t op, struct frame *frm)
+{
+	f_layer("att");
+	f_u8("opcode", op);
+	f_str("name", attop2str(op));
+
+	switch (op) {
+	case ATT_OP_ERROR:
+		if (frm->len < 4)
+			break;
+		f_u8("req", get_u8(frm));
+		f_u16("handle", btohs(htons(get_u16(frm))));
+		f_u8("error", get_u8(frm));
+		break;
+	case ATT_OP_MTU_REQ:
+	case ATT_OP_MTU_RESP:
+		if (frm->len >= 2)
+			f_u16("mtu", btohs(htons(get_u16(frm))));
+		break;
+	case ATT_OP_FIND_INFO_REQ:
+	case ATT_OP_FIND_BY_TYPE_REQ:
+	case ATT_OP_READ_BY_TYPE_REQ:
+	case ATT_OP_READ_BY_GROUP_REQ:
+		if (frm->len < 4)
+			break;
+		f_u16("start", btohs(htons(get_u16(frm))));
+		f_u16("end", btohs(htons(get_u16(frm))));
+		if (op == ATT_OP_FIND_BY_TYPE_REQ && frm->len >= 2)
+			att_uuid_field("type", frm, 2);
+		else if (op != ATT_OP_FIND_INFO_REQ &&
+				(frm->len == 2 || frm->len == 16))
+			att_uuid_field("type", frm, frm->len);
+		break;
+	case ATT_OP_READ_REQ:
+	case ATT_OP_READ_BLOB_REQ:
+	case ATT_OP_WRITE_REQ:
+	case ATT_OP_WRITE_CMD:
+	case ATT_OP_SIGNED_WRITE_CMD:
+	case ATT_OP_PREP_WRITE_REQ:
+	case ATT_OP_PREP_WRITE_RESP:
+	case ATT_OP_HANDLE_NOTIFY:
+	case ATT_OP_HANDLE_IND:
+		if (frm->len < 2)
+			break;
+		f_u16("handle", btohs(htons(get_u16(frm))));
+		if ((op == ATT_OP_READ_BLOB_REQ || op == ATT_OP_PREP_WRITE_REQ ||
+				op == ATT_OP_PREP_WRITE_RESP) && frm->len >= 2)
+			f_u16("offset", btohs(htons(get_u16(frm))));
+		if (op == ATT_OP_SIGNED_WRITE_CMD && frm->len >= 12)
+			frm->len -= 12;
+		if (op != ATT_OP_READ_REQ && op != ATT_OP_READ_BLOB_REQ) {
+			f_u16("vlen", frm->len);
+			f_bytes("value", frm->ptr, frm->len);
+		}
+		break;
+	case ATT_OP_READ_RESP:
+	case ATT_OP_READ_BLOB_RESP:
+	case ATT_OP_READ_MULTI_RESP:
+		f_u16("vlen", frm->len);
+		f_bytes("value", frm->ptr, frm->len);
+		break;
+	case ATT_OP_EXEC_WRITE_REQ:
+		if (frm->len >= 1)
+			f_u8("flags", get_u8(frm));
+		break;
+	}
+}
+
 void att_dump(int level, struct frame *frm)
 {
 	uint8_t op;
 
+	/* Not behind an option, see gatt_frame() */
+	gatt_frame(frm);
+
+	if (parser.flags & DUMP_ATT)
+		att_stats_frame(frm);
+
+	if (frm->len < 1) {
+		if (!parser.sink)
+			raw_dump(level, frm);
+		return;
+	}
+
 	op = get_u8(frm);
 
+	if (parser.sink) {
+		att_fields(op, frm);
+		return;
+	}
+
 	p_indent(level, frm);
 	printf("ATT: %s (0x%.2x)\n", attop2str(op), op);
 
+	/* Any LE capture gets here, so lengths from the packet are checked */
+	if ((int) frm->len < att_min_len(op)) {
+		p_indent(level + 1, frm);
+		printf("malformed (expected at least %d octets)\n",
+							att_min_len(op));
+		raw_dump(level + 1, frm);
+		return;
+	}
+
 	switch (op) {
 		case ATT_OP_ERROR:
 			att_error_dump(level + 1, frm);
@@ -618,7 +832,8 @@ void att_dump(int level, struct frame *frm)
 			break;
 		case ATT_OP_PREP_WRITE_REQ:
 		case ATT_OP_PREP_WRITE_RESP:
-			att_prep_write_dump(level + 1, frm);
+			att_prep_write_dump(level + 1, frm,
+						op == ATT_OP_PREP_WRITE_RESP);
 			break;
 		case ATT_OP_EXEC_WRITE_REQ:
 			att_exec_write_req_dump(level + 1, frm);
@@ -0,0 +1,602 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+
+#include "parser.h"
+
+#define ATT_CONNS	16
+#define ATT_ATTR_SLOTS	1024
+#define ATT_ATTR_PROBE	16
+
+/* Requests are the even opcodes from Exchange MTU to Execute Write */
+#define ATT_REQ_FIRST	0x02
+#define ATT_REQ_LAST	0x18
+#define ATT_REQ_TYPES	((ATT_REQ_LAST - ATT_REQ_FIRST) / 2 + 1)
+
+#define ATT_OP_ERROR		0x01
+#define ATT_OP_READ_REQ		0x0A
+#define ATT_OP_READ_BLOB_REQ	0x0C
+#define ATT_OP_WRITE_REQ	0x12
+#define ATT_OP_PREP_WRITE_REQ	0x16
+#define ATT_OP_NOTIFY		0x1B
+#define ATT_OP_INDICATE		0x1D
+#define ATT_OP_CONFIRM		0x1E
+#define ATT_OP_WRITE_CMD	0x52
+#define ATT_OP_SIGNED_WRITE_CMD	0xD2
+
+static const char *req_names[ATT_REQ_TYPES] = {
+	"Exchange MTU", "Find Information", "Find By Type Value",
+	"Read By Type", "Read", "Read Blob", "Read Multiple",
+	"Read By Group Type", "Write", NULL, "Prepare Write",
+	"Execute Write"
+};
+
+/* A request or indication waiting for its answer */
+struct att_pending {
+	uint8_t		opcode;		/* Zero if there is none */
+	uint16_t	attr;
+	struct timeval	ts;
+};
+
+struct att_req_stats {
+	unsigned long	count;
+	unsigned long	errors;
+	unsigned long	lost;		/* Never answered */
+	struct lat_hist	*hist;
+};
+
+struct att_conn {
+	uint8_t		used;
+	uint8_t		slot;		/* Device slot */
+	uint16_t	handle;
+	uint16_t	dev_id;
+	char		addr[18];
+	struct att_pending req[2];	/* By direction of the request */
+	struct att_pending ind[2];
+	struct att_req_stats stats[ATT_REQ_TYPES];
+	unsigned long	notifications;
+	unsigned long	indications;
+	unsigned long	unconfirmed;
+	struct lat_hist	*confirm;
+};
+
+struct att_attr {
+	uint8_t		used;
+	uint8_t		slot;
+	uint16_t	handle;		/* Of the connection */
+	uint16_t	attr;
+	uint32_t	notify;
+	uint32_t	indicate;
+	uint64_t	bytes;
+	uint16_t	size_min;
+	uint16_t	size_max;
+	uint64_t	first;
+	uint64_t	last;
+	uint64_t	second;		/* Start of the current second */
+	uint32_t	this_second;
+	uint32_t	peak;		/* Most values within a second */
+	uint32_t	reads;
+	uint64_t	read_usec;
+	uint32_t	writes;
+	uint64_t	write_usec;
+	uint32_t	write_max;
+	uint32_t	write_cmds;
+};
+
+static struct att_conn conns[ATT_CONNS];
+static struct att_attr attr_table[ATT_ATTR_SLOTS];
+static unsigned long attr_dropped = 0;
+
+static uint64_t interval;	/* Between periodic reports in usec */
+static uint64_t next_report;
+
+static inline uint16_t get_le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint64_t tv_usec(const struct timeval *tv)
+{
+	return tv->tv_sec * 1000000ull + tv->tv_usec;
+}
+
+void att_stats_init(int sec)
+{
+	interval = sec > 0 ? sec * 1000000ull : 0;
+}
+
+static struct att_conn *get_conn(struct frame *frm)
+{
+	struct att_conn *c, *free_c = NULL;
+	struct conn_info *ci;
+	int i;
+
+	for (i = 0; i < ATT_CONNS; i++) {
+		c = &conns[i];
+
+		if (!c->used) {
+			if (!free_c)
+				free_c = c;
+			continue;
+		}
+
+		if (c->slot == parser.slot && c->handle == frm->handle)
+			return c;
+	}
+
+	if (!free_c) {
+		static int warned;
+
+		if (!warned)
+			fprintf(stderr, "Too many ATT connections\n");
+		warned = 1;
+		return NULL;
+	}
+
+	c = free_c;
+	memset(c, 0, sizeof(*c));
+	c->used   = 1;
+	c->slot   = parser.slot;
+	c->handle = frm->handle;
+	c->dev_id = frm->dev_id;
+
+	ci = conn_get(frm->handle);
+	strcpy(c->addr, ci ? ci->addr : "unknown");
+
+	return c;
+}
+
+static struct att_attr *get_attr(uint16_t handle, uint16_t attr)
+{
+	unsigned int h = ((handle * 31 + attr) ^ parser.slot) * 2654435761u;
+	int i;
+
+	for (i = 0; i < ATT_ATTR_PROBE; i++) {
+		struct att_attr *a = &attr_table[(h + i) % ATT_ATTR_SLOTS];
+
+		if (!a->used) {
+			a->used     = 1;
+			a->slot     = parser.slot;
+			a->handle   = handle;
+			a->attr     = attr;
+			a->size_min = 0xffff;
+			return a;
+		}
+
+		if (a->slot == parser.slot && a->handle == handle &&
+							a->attr == attr)
+			return a;
+	}
+
+	attr_dropped++;
+
+	return NULL;
+}
+
+/* Notifications and indications per attribute and second */
+static void attr_value(struct att_attr *a, int indication, int size,
+								uint64_t now)
+{
+	if (indication)
+		a->indicate++;
+	else
+		a->notify++;
+
+	a->bytes += size;
+	if (size < a->size_min)
+		a->size_min = size;
+	if (size > a->size_max)
+		a->size_max = size;
+
+	if (!a->first)
+		a->first = now;
+	a->last = now;
+
+	if (now - a->second >= 1000000) {
+		a->second = now - now % 1000000;
+		a->this_second = 0;
+	}
+
+	if (++a->this_second > a->peak)
+		a->peak = a->this_second;
+}
+
+static void request(struct att_conn *c, struct frame *frm, uint8_t op,
+					const uint8_t *data, int len)
+{
+	struct att_pending *p = &c->req[frm->in];
+	struct att_req_stats *s = &c->stats[(op - ATT_REQ_FIRST) / 2];
+
+	/* Only one request at a time, the one before got no answer */
+	if (p->opcode)
+		c->stats[(p->opcode - ATT_REQ_FIRST) / 2].lost++;
+
+	s->count++;
+
+	p->opcode = op;
+	p->ts     = frm->ts;
+
+	switch (op) {
+	case ATT_OP_READ_REQ:
+	case ATT_OP_READ_BLOB_REQ:
+	case ATT_OP_WRITE_REQ:
+	case ATT_OP_PREP_WRITE_REQ:
+		p->attr = len >= 2 ? get_le16(data) : 0;
+		break;
+	default:
+		p->attr = 0;
+		break;
+	}
+}
+
+static void response(struct att_conn *c, struct frame *frm, uint8_t req,
+								int error)
+{
+	struct att_pending *p = &c->req[!frm->in];
+	struct att_req_stats *s;
+	struct att_attr *a;
+	uint64_t usec;
+
+	if (!p->opcode || p->opcode != req)
+		return;
+
+	s = &c->stats[(req - ATT_REQ_FIRST) / 2];
+
+	if (!s->hist)
+		s->hist = lat_hist_new();
+	if (s->hist)
+		lat_hist_add(s->hist, &p->ts, &frm->ts);
+
+	if (error)
+		s->errors++;
+
+	usec = tv_usec(&frm->ts) > tv_usec(&p->ts) ?
+			tv_usec(&frm->ts) - tv_usec(&p->ts) : 0;
+
+	switch (req) {
+	case ATT_OP_READ_REQ:
+	case ATT_OP_READ_BLOB_REQ:
+		a = get_attr(c->handle, p->attr);
+		if (a) {
+			a->reads++;
+			a->read_usec += usec;
+		}
+		break;
+
+	case ATT_OP_WRITE_REQ:
+	case ATT_OP_PREP_WRITE_REQ:
+		a = get_attr(c->handle, p->attr);
+		if (a) {
+			a->writes++;
+			a->write_usec += usec;
+			if (usec > a->write_max)
+				a->write_max = usec;
+		}
+		break;
+	}
+
+	p->opcode = 0;
+}
+
+void att_stats_frame(struct frame *frm)
+{
+	const uint8_t *data = frm->ptr;
+	int len = frm->len;
+	uint64_t now = tv_usec(&frm->ts);
+	struct att_conn *c;
+	struct att_attr *a;
+	uint8_t op;
+
+	if (len < 1)
+		return;
+
+	c = get_conn(frm);
+	if (!c)
+		return;
+
+	op = data[0];
+	data++;
+	len--;
+
+	if (op >= ATT_REQ_FIRST && op <= ATT_REQ_LAST && !(op & 0x01) &&
+						req_names[(op - ATT_REQ_FIRST) / 2])
+		request(c, frm, op, data, len);
+	else if (op > ATT_REQ_FIRST && op <= ATT_REQ_LAST + 1 && (op & 0x01))
+		response(c, frm, op - 1, 0);
+	else {
+		switch (op) {
+		case ATT_OP_ERROR:
+			if (len >= 1)
+				response(c, frm, data[0], 1);
+			break;
+
+		case ATT_OP_NOTIFY:
+		case ATT_OP_INDICATE:
+			if (len < 2)
+				break;
+
+			a = get_attr(c->handle, get_le16(data));
+			if (a)
+				attr_value(a, op == ATT_OP_INDICATE, len - 2,
+									now);
+
+			if (op == ATT_OP_NOTIFY) {
+				c->notifications++;
+				break;
+			}
+
+			c->indications++;
+			if (c->ind[frm->in].opcode)
+				c->unconfirmed++;
+
+			c->ind[frm->in].opcode = op;
+			c->ind[frm->in].attr   = get_le16(data);
+			c->ind[frm->in].ts     = frm->ts;
+			break;
+
+		case ATT_OP_CONFIRM:
+			if (!c->ind[!frm->in].opcode)
+				break;
+
+			if (!c->confirm)
+				c->confirm = lat_hist_new();
+			if (c->confirm)
+				lat_hist_add(c->confirm, &c->ind[!frm->in].ts,
+								&frm->ts);
+			c->ind[!frm->in].opcode = 0;
+			break;
+
+		case ATT_OP_WRITE_CMD:
+		case ATT_OP_SIGNED_WRITE_CMD:
+			if (len < 2)
+				break;
+
+			a = get_attr(c->handle, get_le16(data));
+			if (a)
+				a->write_cmds++;
+			break;
+		}
+	}
+
+	if (interval && now >= next_report) {
+		if (next_report) {
+			fflush(stdout);
+			att_stats_dump(stderr);
+		}
+		next_report = now + interval;
+	}
+}
+
+static int cmp_attr(const void *a, const void *b)
+{
+	const struct att_attr *a1 = *(struct att_attr * const *) a;
+	const struct att_attr *a2 = *(struct att_attr * const *) b;
+
+	return a1->attr - a2->attr;
+}
+
+static void conn_dump(FILE *out, struct att_conn *c, struct att_attr **list)
+{
+	unsigned long requests = 0, errors = 0, open = 0;
+	int i, n = 0;
+
+	for (i = 0; i < ATT_REQ_TYPES; i++) {
+		requests += c->stats[i].count;
+		errors += c->stats[i].errors;
+	}
+
+	open = !!c->req[0].opcode + !!c->req[1].opcode;
+
+	fprintf(out, "att: hci%d handle %d %s requests %lu errors %lu "
+			"open %lu notifications %lu indications %lu "
+			"unconfirmed %lu\n", c->dev_id, c->handle, c->addr,
+			requests, errors, open, c->notifications,
+			c->indications, c->unconfirmed);
+
+	fprintf(out, "  %-40s %7s %5s %9s %9s %9s\n", "request",
+			"count", "open", "p50 ms", "p99 ms", "max ms");
+
+	for (i = 0; i < ATT_REQ_TYPES; i++) {
+		struct att_req_stats *s = &c->stats[i];
+		struct att_pending *p;
+		unsigned long pending = s->lost;
+
+		if (!s->count)
+			continue;
+
+		for (p = c->req; p < c->req + 2; p++)
+			if (p->opcode == ATT_REQ_FIRST + i * 2)
+				pending++;
+
+		if (s->hist)
+			lat_line(out, req_names[i], s->count, pending, s->hist);
+		else
+			fprintf(out, "  %-40.40s %7lu %5lu %9s %9s %9s\n",
+					req_names[i], s->count, pending,
+					"-", "-", "-");
+	}
+
+	if (c->confirm)
+		lat_line(out, "Indication until confirmed", c->indications,
+				c->unconfirmed + !!c->ind[0].opcode +
+				!!c->ind[1].opcode, c->confirm);
+
+	for (i = 0; i < ATT_ATTR_SLOTS; i++)
+		if (attr_table[i].used && attr_table[i].slot == c->slot &&
+					attr_table[i].handle == c->handle)
+			list[n++] = &attr_table[i];
+
+	if (!n)
+		return;
+
+	qsort(list, n, sizeof(list[0]), cmp_attr);
+
+	fprintf(out, "  %-6s %7s %7s %13s %8s %6s %6s %8s %6s %8s %8s %6s "
+			"%s\n", "attr", "notify", "ind", "size", "rate/s",
+			"peak", "reads", "avg ms", "writes", "avg ms",
+			"max ms", "cmds", "name");
+
+	for (i = 0; i < n; i++) {
+		struct att_attr *a = list[i];
+		uint32_t values = a->notify + a->indicate;
+		const char *name;
+		char size[16];
+
+		if (values)
+			snprintf(size, sizeof(size), "%u/%.1f/%u",
+				a->size_min, (double) a->bytes / values,
+				a->size_max);
+		else
+			strcpy(size, "-");
+
+		/* Either side may be the server */
+		name = gatt_name(c->slot, c->handle, a->attr, 1);
+		if (!name)
+			name = gatt_name(c->slot, c->handle, a->attr, 0);
+
+		fprintf(out, "  0x%4.4x %7u %7u %13s %8.1f %6u %6u %8.3f "
+				"%6u %8.3f %8.3f %6u %s\n", a->attr, a->notify,
+				a->indicate, size,
+				a->last > a->first ? (values - 1) * 1000000.0 /
+						(a->last - a->first) : 0.0,
+				a->peak, a->reads,
+				a->reads ? a->read_usec / 1000.0 / a->reads :
+									0.0,
+				a->writes,
+				a->writes ? a->write_usec / 1000.0 / a->writes :
+									0.0,
+				a->write_max / 1000.0, a->write_cmds,
+				name ? name : "-");
+	}
+}
+
+/*
+ * Drop the attributes of a link. The others are put back, so none of
+ * them ends up behind a slot that became free.
+ */
+static void attr_remove(uint8_t slot, uint16_t handle)
+{
+	struct att_attr *old, *a;
+	uint8_t cur = parser.slot;
+	int i;
+
+	for (i = 0; i < ATT_ATTR_SLOTS; i++)
+		if (attr_table[i].used && attr_table[i].slot == slot &&
+					attr_table[i].handle == handle)
+			break;
+
+	if (i == ATT_ATTR_SLOTS)
+		return;
+
+	old = malloc(sizeof(attr_table));
+	if (!old) {
+		perror("Can't allocate attribute table");
+		return;
+	}
+
+	memcpy(old, attr_table, sizeof(attr_table));
+	memset(attr_table, 0, sizeof(attr_table));
+
+	for (i = 0; i < ATT_ATTR_SLOTS; i++) {
+		if (!old[i].used || (old[i].slot == slot &&
+						old[i].handle == handle))
+			continue;
+
+		parser.slot = old[i].slot;
+		a = get_attr(old[i].handle, old[i].attr);
+		if (a)
+			*a = old[i];
+	}
+
+	parser.slot = cur;
+	free(old);
+}
+
+/* Like the connection table, an entry goes with Disconnection Complete */
+void att_stats_disconnect(uint16_t handle)
+{
+	struct att_attr **list;
+	struct att_conn *c;
+	int i, j;
+
+	for (i = 0; i < ATT_CONNS; i++) {
+		c = &conns[i];
+
+		if (!c->used || c->slot != parser.slot || c->handle != handle)
+			continue;
+
+		list = malloc(ATT_ATTR_SLOTS * sizeof(*list));
+		if (list) {
+			conn_dump(stderr, c, list);
+			free(list);
+		}
+
+		for (j = 0; j < ATT_REQ_TYPES; j++)
+			free(c->stats[j].hist);
+		free(c->confirm);
+
+		c->used = 0;
+		break;
+	}
+
+	attr_remove(parser.slot, handle);
+}
+
+void att_stats_dump(FILE *out)
+{
+	struct att_attr **list;
+	int i;
+
+	list = malloc(ATT_ATTR_SLOTS * sizeof(*list));
+	if (!list) {
+		perror("Can't allocate attribute list");
+		return;
+	}
+
+	for (i = 0; i < ATT_CONNS; i++)
+		if (conns[i].used)
+			conn_dump(out, &conns[i], list);
+
+	if (attr_dropped)
+		fprintf(out, "att: %lu values of attributes that didn't fit "
+						"the table\n", attr_dropped);
+
+	free(list);
+	fflush(out);
+}
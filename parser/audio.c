@@ -0,0 +1,635 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+
+#include "parser.h"
+
+#define MAX_STREAMS	16
+#define WAV_HDR_SIZE	44
+
+/* Voice setting, the format of the data on HCI */
+#define VOICE_INPUT(v)		(((v) >> 8) & 0x03)
+#define VOICE_16BIT(v)		((v) & 0x0020)
+#define VOICE_FORMAT(v)		(((v) >> 6) & 0x03)
+#define VOICE_AIR(v)		((v) & 0x0003)
+
+#define INPUT_LINEAR		0x00
+#define INPUT_ULAW		0x01
+#define INPUT_ALAW		0x02
+
+#define FORMAT_UNSIGNED		0x03
+
+#define AIR_TRANSPARENT		0x03
+
+/* Air mode of Synchronous Connection Complete */
+#define AIR_MODE_TRANSPARENT	0x03
+
+#define WAV_FORMAT_PCM		0x0001
+#define WAV_FORMAT_ALAW		0x0006
+#define WAV_FORMAT_ULAW		0x0007
+
+struct audio_stream {
+	uint8_t		used;
+	uint8_t		slot;		/* Device slot */
+	uint16_t	handle;
+	uint16_t	dev_id;
+	FILE		*file;
+	char		*name;
+	int		wav;		/* Has a header to fill in */
+	uint8_t		silence;	/* Byte value of silence */
+	uint8_t		flip;		/* Turns signed 8 bit samples unsigned */
+	uint32_t	rate;		/* Bytes per second */
+	uint32_t	bytes;
+	uint32_t	packets;
+	uint32_t	gaps;
+	uint32_t	filled;		/* Bytes of silence inserted */
+	uint64_t	skipped;	/* Bytes of silence left out */
+	uint64_t	end;		/* Time the received audio reaches */
+	char		addr[18];
+
+	/* Timing statistics, all times in usec */
+	uint64_t	first;		/* Arrival of the first packet */
+	uint64_t	last;		/* Arrival of the previous packet */
+	uint64_t	last_dur;	/* Audio length of the previous packet */
+	uint32_t	jitter;		/* Estimate scaled by 16 */
+	uint32_t	jitter_max;
+	uint32_t	lost;		/* Packets missing in the gaps */
+	uint64_t	gap_max;
+	uint32_t	status[4];	/* Packet status flags */
+	uint32_t	sizes[256];
+};
+
+static struct audio_stream streams[MAX_STREAMS];
+
+/* CVSD with 16 bit linear PCM on HCI is what controllers start with */
+static uint16_t voice_setting[DEVICE_SLOTS];
+static uint16_t voice_pending[DEVICE_SLOTS];
+static uint16_t voice_next[DEVICE_SLOTS];	/* Of the next sync link */
+static uint8_t voice_next_set[DEVICE_SLOTS];
+
+static char *audio_base = NULL;
+static const char *audio_ext;
+static int audio_count = 0;
+
+static inline uint16_t get_le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline void put_le16(uint8_t *p, uint16_t val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+}
+
+static inline void put_le32(uint8_t *p, uint32_t val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+}
+
+static void voice_init(void)
+{
+	int i;
+
+	for (i = 0; i < DEVICE_SLOTS; i++)
+		voice_setting[i] = 0x0060;
+}
+
+void audio_init(const char *file)
+{
+	const char *dot = strrchr(file, '.');
+
+	if (!dot || strchr(dot, '/'))
+		dot = file + strlen(file);
+
+	audio_base = strndup(file, dot - file);
+	if (!audio_base) {
+		perror("Can't allocate memory");
+		exit(1);
+	}
+
+	audio_ext = *dot ? dot : ".wav";
+
+	voice_init();
+}
+
+void audio_stats_init(void)
+{
+	voice_init();
+}
+
+static void wav_header(struct audio_stream *s, uint16_t voice)
+{
+	uint8_t hdr[WAV_HDR_SIZE];
+	uint16_t format, bits;
+
+	switch (VOICE_INPUT(voice)) {
+	case INPUT_ULAW:
+		format = WAV_FORMAT_ULAW;
+		bits = 8;
+		break;
+	case INPUT_ALAW:
+		format = WAV_FORMAT_ALAW;
+		bits = 8;
+		break;
+	default:
+		format = WAV_FORMAT_PCM;
+		bits = VOICE_16BIT(voice) ? 16 : 8;
+		break;
+	}
+
+	memcpy(hdr, "RIFF", 4);
+	put_le32(hdr + 4, WAV_HDR_SIZE - 8);
+	memcpy(hdr + 8, "WAVEfmt ", 8);
+	put_le32(hdr + 16, 16);
+	put_le16(hdr + 20, format);
+	put_le16(hdr + 22, 1);
+	put_le32(hdr + 24, 8000);
+	put_le32(hdr + 28, 8000 * bits / 8);
+	put_le16(hdr + 32, bits / 8);
+	put_le16(hdr + 34, bits);
+	memcpy(hdr + 36, "data", 4);
+	put_le32(hdr + 40, 0);
+
+	fwrite(hdr, sizeof(hdr), 1, s->file);
+}
+
+static struct audio_stream *get_stream(uint16_t handle)
+{
+	int i;
+
+	for (i = 0; i < MAX_STREAMS; i++)
+		if (streams[i].used && streams[i].slot == parser.slot &&
+					streams[i].handle == handle)
+			return &streams[i];
+
+	return NULL;
+}
+
+static void open_stream(uint16_t dev_id, uint16_t handle, uint16_t voice,
+						uint8_t air_mode, const uint8_t *bdaddr)
+{
+	struct audio_stream *s = get_stream(handle);
+	int i;
+
+	if (s)
+		return;
+
+	for (i = 0; i < MAX_STREAMS; i++)
+		if (!streams[i].used)
+			break;
+
+	if (i == MAX_STREAMS) {
+		fprintf(stderr, "Too many audio connections\n");
+		return;
+	}
+
+	s = &streams[i];
+	memset(s, 0, sizeof(*s));
+
+	/* Transparent data isn't PCM, keep it as it is */
+	s->wav = air_mode != AIR_MODE_TRANSPARENT;
+
+	if (s->wav) {
+		switch (VOICE_INPUT(voice)) {
+		case INPUT_ULAW:
+			s->silence = 0xff;
+			s->rate = 8000;
+			break;
+		case INPUT_ALAW:
+			s->silence = 0xd5;
+			s->rate = 8000;
+			break;
+		default:
+			s->silence = VOICE_16BIT(voice) ? 0x00 : 0x80;
+			s->rate = VOICE_16BIT(voice) ? 16000 : 8000;
+
+			/* 8 bit samples in a WAV file are unsigned */
+			if (!VOICE_16BIT(voice) &&
+					VOICE_FORMAT(voice) != FORMAT_UNSIGNED)
+				s->flip = 0x80;
+			break;
+		}
+	} else {
+		/* mSBC, a 60 byte frame every 7.5 ms */
+		s->rate = 8000;
+	}
+
+	if (bdaddr)
+		p_ba2str((const bdaddr_t *) bdaddr, s->addr);
+	else
+		strcpy(s->addr, "unknown");
+
+	s->used   = 1;
+	s->slot   = parser.slot;
+	s->dev_id = dev_id;
+	s->handle = handle;
+
+	/* Only the statistics are wanted */
+	if (!audio_base)
+		return;
+
+	s->name = malloc(strlen(audio_base) + strlen(audio_ext) + 12);
+	if (!s->name) {
+		perror("Can't allocate memory");
+		exit(1);
+	}
+
+	sprintf(s->name, "%s-%d%s", audio_base, ++audio_count,
+					s->wav ? audio_ext : ".raw");
+
+	s->file = fopen(s->name, "w");
+	if (!s->file) {
+		perror("Can't open audio file");
+		free(s->name);
+		s->name = NULL;
+		return;
+	}
+
+	setvbuf(s->file, NULL, _IOFBF, 32768);
+
+	if (s->wav)
+		wav_header(s, voice);
+
+	fprintf(stderr, "audio: hci%d handle %d %s voice 0x%4.4x -> %s\n",
+				dev_id, handle, s->addr, voice, s->name);
+}
+
+static void print_stats(FILE *out, struct audio_stream *s)
+{
+	uint64_t span = s->packets ? s->last - s->first : 0;
+	int i, n = 0;
+
+	fprintf(out, "sco: hci%d handle %d %s packets %u in %llu.%03llu s\n",
+				s->dev_id, s->handle, s->addr, s->packets,
+				(unsigned long long) (span / 1000000),
+				(unsigned long long) (span % 1000000 / 1000));
+
+	fprintf(out, "  jitter %.3f ms max %.3f ms gaps %u lost %u (%.1f%%) "
+			"longest %.3f ms\n", (s->jitter >> 4) / 1000.0,
+			(s->jitter_max >> 4) / 1000.0, s->gaps, s->lost,
+			s->lost ? 100.0 * s->lost / (s->packets + s->lost) : 0.0,
+			s->gap_max / 1000.0);
+
+	fprintf(out, "  status correct %u invalid %u no data %u partial %u\n",
+				s->status[0], s->status[1], s->status[2],
+				s->status[3]);
+
+	fprintf(out, "  sizes");
+	for (i = 0; i < 256; i++) {
+		if (!s->sizes[i])
+			continue;
+
+		if (n++ == 8) {
+			fprintf(out, " ...");
+			break;
+		}
+
+		fprintf(out, " %d:%u", i, s->sizes[i]);
+	}
+	fprintf(out, "\n");
+}
+
+static void close_stream(struct audio_stream *s)
+{
+	uint8_t size[4];
+
+	if (s->file) {
+		if (s->wav && s->bytes) {
+			fflush(s->file);
+
+			put_le32(size, WAV_HDR_SIZE - 8 + s->bytes);
+			if (!fseek(s->file, 4, SEEK_SET))
+				fwrite(size, 4, 1, s->file);
+
+			put_le32(size, s->bytes);
+			if (!fseek(s->file, 40, SEEK_SET))
+				fwrite(size, 4, 1, s->file);
+		}
+
+		if (fclose(s->file) < 0)
+			perror("Write error");
+
+		fprintf(stderr, "audio: %s %u packets %u bytes %u gaps "
+					"%u bytes of silence", s->name, s->packets,
+					s->bytes, s->gaps, s->filled);
+		if (s->skipped)
+			fprintf(stderr, " %llu left out",
+					(unsigned long long) s->skipped);
+		fprintf(stderr, "\n");
+
+		free(s->name);
+	}
+
+	if (parser.flags & DUMP_SCO)
+		print_stats(stderr, s);
+
+	s->used = 0;
+}
+
+/*
+ * RFC 3550 interarrival jitter. The sender clock is the audio itself, it
+ * moves on by the length of the previous packet and of those that were
+ * lost in between.
+ */
+static void update_stats(struct audio_stream *s, uint64_t now, uint8_t status,
+				int len, uint64_t dur, uint64_t missing)
+{
+	int64_t d;
+
+	s->status[status]++;
+	s->sizes[len]++;
+
+	if (s->packets) {
+		d = (int64_t) (now - s->last) -
+				(int64_t) (s->last_dur + missing * dur);
+		if (d < 0)
+			d = -d;
+
+		s->jitter += d - ((s->jitter + 8) >> 4);
+		if (s->jitter > s->jitter_max)
+			s->jitter_max = s->jitter;
+	} else
+		s->first = now;
+
+	s->last = now;
+	s->last_dur = dur;
+}
+
+/*
+ * Lost packets are replaced by silence, raw data is kept as it came. A
+ * long gap, a link on hold or a broken time stamp, is filled for one
+ * second at most and the rest is only counted.
+ */
+static void write_audio(struct audio_stream *s, const uint8_t *data, int len,
+							uint64_t missing)
+{
+	uint8_t buf[256];
+	int i, k;
+
+	if (s->wav && missing > 0) {
+		uint64_t fill = missing * len;
+		uint32_t n = fill > s->rate ? s->rate : fill;
+
+		memset(buf, s->silence, sizeof(buf));
+
+		s->skipped += fill - n;
+		s->filled += n;
+		s->bytes += n;
+
+		while (n > 0) {
+			k = n > sizeof(buf) ? sizeof(buf) : n;
+
+			fwrite(buf, k, 1, s->file);
+			n -= k;
+		}
+	}
+
+	s->bytes += len;
+
+	if (!s->flip) {
+		fwrite(data, len, 1, s->file);
+		return;
+	}
+
+	while (len > 0) {
+		k = len > (int) sizeof(buf) ? (int) sizeof(buf) : len;
+
+		for (i = 0; i < k; i++)
+			buf[i] = data[i] ^ s->flip;
+
+		fwrite(buf, k, 1, s->file);
+		data += k;
+		len -= k;
+	}
+}
+
+/*
+ * The packet ends at its time stamp. If it starts later than the audio
+ * received so far, the packets that fit in between, rounded to allow for
+ * jitter, were lost. Bursts just move on from where the audio ends.
+ */
+static void sco_data(struct audio_stream *s, const struct timeval *ts,
+				uint8_t status, const uint8_t *data, int len)
+{
+	uint64_t now = ts->tv_sec * 1000000ull + ts->tv_usec;
+	uint64_t dur, start, missing;
+
+	dur = len * 1000000ull / s->rate;
+	start = now > dur ? now - dur : 0;
+
+	missing = s->packets && dur && start > s->end ?
+				(start - s->end + dur / 2) / dur : 0;
+
+	if (missing > 0) {
+		s->gaps++;
+		s->lost += missing;
+		if (start - s->end > s->gap_max)
+			s->gap_max = start - s->end;
+	}
+
+	if (parser.flags & DUMP_SCO)
+		update_stats(s, now, status, len, dur, missing);
+
+	if (s->file)
+		write_audio(s, data, len, missing);
+
+	s->end += missing * dur;
+	if (!s->packets || start > s->end)
+		s->end = start;
+
+	s->end += dur;
+	s->packets++;
+}
+
+static void audio_command(const uint8_t *data, int len)
+{
+	uint16_t opcode;
+
+	if (len < 3)
+		return;
+
+	opcode = get_le16(data);
+	data += 3;
+	len -= 3;
+
+	if (opcode == cmd_opcode_pack(OGF_HOST_CTL, OCF_WRITE_VOICE_SETTING) &&
+									len >= 2)
+		voice_pending[parser.slot] = get_le16(data);
+
+	/* Links set up with these use their own voice setting */
+	if (opcode == cmd_opcode_pack(OGF_LINK_CTL, OCF_SETUP_SYNC_CONN) &&
+									len >= 17) {
+		voice_next[parser.slot] = get_le16(data + 12);
+		voice_next_set[parser.slot] = 1;
+	}
+
+	if (opcode == cmd_opcode_pack(OGF_LINK_CTL, OCF_ACCEPT_SYNC_CONN_REQ) &&
+									len >= 21) {
+		voice_next[parser.slot] = get_le16(data + 16);
+		voice_next_set[parser.slot] = 1;
+	}
+}
+
+static void audio_event(uint16_t dev_id, const uint8_t *data, int len)
+{
+	uint8_t event = data[0];
+	struct audio_stream *s;
+	uint16_t opcode, voice;
+
+	data += 2;
+	len -= 2;
+
+	switch (event) {
+	case EVT_CMD_COMPLETE:
+		if (len < 4 || data[3])
+			break;
+
+		opcode = get_le16(data + 1);
+		if (opcode == cmd_opcode_pack(OGF_HOST_CTL,
+						OCF_WRITE_VOICE_SETTING))
+			voice_setting[parser.slot] = voice_pending[parser.slot];
+		else if (opcode == cmd_opcode_pack(OGF_HOST_CTL,
+					OCF_READ_VOICE_SETTING) && len >= 6)
+			voice_setting[parser.slot] = get_le16(data + 4);
+		break;
+
+	case EVT_CONN_COMPLETE:
+		/* Link type 0 is SCO */
+		if (len >= 10 && !data[0] && data[9] == 0x00)
+			open_stream(dev_id, get_le16(data + 1) & 0x0fff,
+					voice_setting[parser.slot],
+					VOICE_AIR(voice_setting[parser.slot]) ==
+						AIR_TRANSPARENT ?
+						AIR_MODE_TRANSPARENT : 0,
+					data + 3);
+		break;
+
+	case EVT_SYNC_CONN_COMPLETE:
+		if (len < 17 || data[0])
+			break;
+
+		voice = voice_next_set[parser.slot] ? voice_next[parser.slot] :
+						voice_setting[parser.slot];
+		voice_next_set[parser.slot] = 0;
+
+		open_stream(dev_id, get_le16(data + 1) & 0x0fff, voice,
+							data[16], data + 3);
+		break;
+
+	case EVT_DISCONN_COMPLETE:
+		if (len < 3 || data[0])
+			break;
+
+		s = get_stream(get_le16(data + 1) & 0x0fff);
+		if (s)
+			close_stream(s);
+		break;
+	}
+}
+
+void __audio_frame(struct frame *frm)
+{
+	const uint8_t *data = frm->ptr;
+	int len = frm->len;
+	struct audio_stream *s;
+	uint16_t handle, flags;
+
+	if (len < 3)
+		return;
+
+	set_device(frm->dev_id);
+
+	switch (data[0]) {
+	case HCI_COMMAND_PKT:
+		audio_command(data + 1, len - 1);
+		break;
+
+	case HCI_EVENT_PKT:
+		audio_event(frm->dev_id, data + 1, len - 1);
+		break;
+
+	case HCI_SCODATA_PKT:
+		if (len < 1 + HCI_SCO_HDR_SIZE)
+			return;
+
+		handle = get_le16(data + 1) & 0x0fff;
+		flags = get_le16(data + 1) >> 12;
+
+		/* Links that were up before the capture started */
+		s = get_stream(handle);
+		if (!s) {
+			open_stream(frm->dev_id, handle,
+					voice_setting[parser.slot], 0, NULL);
+			s = get_stream(handle);
+			if (!s)
+				return;
+		}
+
+		if (data[3] > len - 1 - HCI_SCO_HDR_SIZE)
+			return;
+
+		sco_data(s, &frm->ts, flags & 0x03,
+				data + 1 + HCI_SCO_HDR_SIZE, data[3]);
+		break;
+	}
+}
+
+void audio_dump(FILE *out)
+{
+	int i;
+
+	for (i = 0; i < MAX_STREAMS; i++)
+		if (streams[i].used)
+			print_stats(out, &streams[i]);
+
+	fflush(out);
+}
+
+void audio_close(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_STREAMS; i++)
+		if (streams[i].used)
+			close_stream(&streams[i]);
+}
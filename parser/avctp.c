@@ -38,6 +38,19 @@
 
 void avctp_dump(int level, struct frame *frm)
 {
+	uint8_t hdr;
+
+	if (parser.sink) {
+		f_layer("avctp");
+		if (frm->len < 3)
+			return;
+		hdr = get_u8(frm);
+		f_u8("transaction", hdr >> 4);
+		f_u8("response", (hdr >> 1) & 0x01);
+		f_u16("pid", get_u16(frm));
+		return;
+	}
+
 	p_indent(level, frm);
 	printf("AVCTP:\n");
 
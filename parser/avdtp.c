@@ -445,12 +445,75 @@ static inline void delay_report(int level, uint8_t hdr, struct frame *frm)
 	}
 }
 
+/* Fields reported by the structured output */
+const char *avdtp_field_names[] = {
+	"transaction", "type", "packet", "nsp", "signal", "name",
+	"acp_seid", "version", "marker", "pt", "seqn", "time", "ssrc",
+	"plen", NULL
+};
+
+/* Structured counterpart of avdtp_dump() */
+static void avdtp_fields(struct frame *frm)
+{
+	uint8_t hdr, sid, type;
+
+	f_layer("avdtp");
+
+	switch (frm->num) {
+	case 1:
+		if (frm->len < 1)
+			break;
+		hdr = get_u8(frm);
+		f_u8("transaction", hdr >> 4);
+		f_str("type", mt2str(hdr));
+		f_str("packet", pt2str(hdr));
+
+		if ((hdr & 0x0c) == 0x04 && frm->len >= 1)
+			f_u8("nsp", get_u8(frm));
+
+		if (hdr & 0x08 || frm->len < 1)
+			break;
+
+		sid = get_u8(frm);
+		f_u8("signal", sid & 0x7f);
+		f_str("name", si2str(sid));
+
+		/* Every command but discover starts with the ACP SEID */
+		if ((hdr & 0x03) == 0x00 && (sid & 0x7f) != 0x01 &&
+							frm->len >= 1)
+			f_u8("acp_seid", get_u8(frm) >> 2);
+		break;
+
+	case 2:
+		if (frm->len < 12)
+			break;
+		hdr  = get_u8(frm);
+		type = get_u8(frm);
+		f_u8("version", hdr >> 6);
+		f_u8("marker", type >> 7);
+		f_u8("pt", type & 0x7f);
+		f_u16("seqn", get_u16(frm));
+		f_u32("time", get_u32(frm));
+		f_u32("ssrc", get_u32(frm));
+		f_u16("plen", frm->len);
+		break;
+	}
+}
+
 void avdtp_dump(int level, struct frame *frm)
 {
 	uint8_t hdr, sid, nsp, type;
 	uint16_t seqn;
 	uint32_t time, ssrc;
 
+	if (parser.flags & (DUMP_A2DP | DUMP_MEDIA))
+		a2dp_frame(frm);
+
+	if (parser.sink) {
+		avdtp_fields(frm);
+		return;
+	}
+
 	switch (frm->num) {
 	case 1:
 		p_indent(level, frm);
@@ -515,6 +578,10 @@ void avdtp_dump(int level, struct frame *frm)
 		printf("AVDTP(m): ver %d %s%scc %d %spt %d seqn %d time %d ssrc %d\n",
 			hdr >> 6, hdr & 0x20 ? "pad " : "", hdr & 0x10 ? "ext " : "",
 			hdr & 0xf, type & 0x80 ? "mark " : "", type & 0x7f, seqn, time, ssrc);
+
+		if ((parser.flags & DUMP_A2DP) &&
+					a2dp_media_dump(level + 1, frm))
+			return;
 		break;
 	}
 
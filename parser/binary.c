@@ -0,0 +1,244 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "parser.h"
+#include "evtstream.h"
+
+#define NAME_SLOTS	1024
+
+struct buffer {
+	unsigned char	*data;
+	int		len;
+	int		size;
+};
+
+static struct buffer names;	/* Name records not written yet */
+static struct buffer rec;	/* Frame record being built */
+
+/* Field names are string literals, so they are looked up by address */
+static struct {
+	const char	*name;
+	uint16_t	id;
+} name_table[NAME_SLOTS];
+
+static int name_count = 0;
+static int started = 0;
+
+static unsigned char *buf_reserve(struct buffer *b, int len)
+{
+	if (b->len + len > b->size) {
+		unsigned char *data;
+		int size = b->size ? b->size : 1024;
+
+		while (size < b->len + len)
+			size *= 2;
+
+		data = realloc(b->data, size);
+		if (!data) {
+			perror("Can't allocate record buffer");
+			exit(1);
+		}
+
+		b->data = data;
+		b->size = size;
+	}
+
+	return b->data + b->len;
+}
+
+static inline void put_le16(unsigned char *p, uint16_t val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+}
+
+static inline void put_le32(unsigned char *p, uint32_t val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+}
+
+static uint16_t name_id(const char *name)
+{
+	unsigned long h = ((unsigned long) name >> 2) % NAME_SLOTS;
+	unsigned char *p;
+	int len;
+
+	while (name_table[h].name) {
+		if (name_table[h].name == name)
+			return name_table[h].id;
+		h = (h + 1) % NAME_SLOTS;
+	}
+
+	if (name_count == NAME_SLOTS - 1) {
+		fprintf(stderr, "Too many field names\n");
+		exit(1);
+	}
+
+	name_table[h].name = name;
+	name_table[h].id = name_count++;
+
+	/* Define the name ahead of the frame that uses it */
+	len = strlen(name);
+	p = buf_reserve(&names, EVT_REC_HDR_SIZE + 2 + len);
+	put_le32(p, 2 + len);
+	put_le16(p + 4, EVT_REC_NAME);
+	put_le16(p + 6, 0);
+	put_le16(p + 8, name_table[h].id);
+	memcpy(p + 10, name, len);
+	names.len += EVT_REC_HDR_SIZE + 2 + len;
+
+	return name_table[h].id;
+}
+
+static unsigned char *bin_field(uint8_t type, const char *name, int len)
+{
+	uint16_t id = name_id(name);
+	unsigned char *p;
+
+	p = buf_reserve(&rec, EVT_FIELD_HDR_SIZE + len);
+	p[0] = type;
+	put_le16(p + 1, id);
+	put_le16(p + 3, len);
+	rec.len += EVT_FIELD_HDR_SIZE + len;
+
+	return p + EVT_FIELD_HDR_SIZE;
+}
+
+static void bin_begin(struct frame *frm)
+{
+	unsigned char *p;
+
+	if (!started) {
+		p = buf_reserve(&names, EVT_HDR_SIZE);
+		memcpy(p, EVT_MAGIC, EVT_MAGIC_SIZE);
+		put_le32(p + EVT_MAGIC_SIZE, EVT_VERSION);
+		names.len += EVT_HDR_SIZE;
+		started = 1;
+	}
+
+	rec.len = 0;
+
+	p = buf_reserve(&rec, EVT_REC_HDR_SIZE + EVT_FRAME_HDR_SIZE);
+	put_le16(p + 4, EVT_REC_FRAME);
+	put_le16(p + 6, 0);
+
+	p += EVT_REC_HDR_SIZE;
+	put_le32(p, frm->ts.tv_sec);
+	put_le32(p + 4, frm->ts.tv_usec);
+	put_le32(p + 8, frm->data_len);
+	put_le16(p + 12, frm->dev_id);
+	p[14] = frm->in;
+	p[15] = 0;
+
+	rec.len = EVT_REC_HDR_SIZE + EVT_FRAME_HDR_SIZE;
+}
+
+static void bin_layer(const char *name)
+{
+	bin_field(EVT_FIELD_LAYER, name, 0);
+}
+
+static void bin_uint(const char *name, uint32_t val, int size)
+{
+	unsigned char *p;
+
+	switch (size) {
+	case 1:
+		p = bin_field(EVT_FIELD_U8, name, 1);
+		p[0] = val;
+		break;
+	case 2:
+		p = bin_field(EVT_FIELD_U16, name, 2);
+		put_le16(p, val);
+		break;
+	default:
+		p = bin_field(EVT_FIELD_U32, name, 4);
+		put_le32(p, val);
+		break;
+	}
+}
+
+static void bin_str(const char *name, const char *val)
+{
+	int len = strlen(val);
+
+	memcpy(bin_field(EVT_FIELD_STR, name, len), val, len);
+}
+
+static void bin_bdaddr(const char *name, const bdaddr_t *ba)
+{
+	memcpy(bin_field(EVT_FIELD_BDADDR, name, 6), ba, 6);
+}
+
+static void bin_uuid(const char *name, const void *uuid, int size)
+{
+	memcpy(bin_field(EVT_FIELD_UUID, name, size), uuid, size);
+}
+
+static void bin_bytes(const char *name, const void *data, int len)
+{
+	if (len > 0xffff)
+		len = 0xffff;
+
+	memcpy(bin_field(EVT_FIELD_BYTES, name, len), data, len);
+}
+
+static void bin_end(struct frame *frm)
+{
+	put_le32(rec.data, rec.len - EVT_REC_HDR_SIZE);
+
+	prof_enter(PROF_OUTPUT);
+	if (names.len > 0) {
+		fwrite(names.data, 1, names.len, stdout);
+		names.len = 0;
+	}
+	fwrite(rec.data, 1, rec.len, stdout);
+	prof_leave();
+}
+
+struct field_sink binary_sink = {
+	.begin	= bin_begin,
+	.layer	= bin_layer,
+	.uint	= bin_uint,
+	.str	= bin_str,
+	.bdaddr	= bin_bdaddr,
+	.uuid	= bin_uuid,
+	.bytes	= bin_bytes,
+	.end	= bin_end,
+};
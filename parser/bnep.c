@@ -74,6 +74,94 @@ static char *get_macaddr(struct frame *frm)
 	return str;
 }
 
+static FILE *pan_pcap = NULL;
+
+void bnep_pcap_init(int fd)
+{
+	pan_pcap = pcap_open(fd, DLT_EN10MB);
+}
+
+static inline void bdaddr2mac(uint8_t *mac, const bdaddr_t *ba)
+{
+	int i;
+
+	for (i = 0; i < 6; i++)
+		mac[i] = ba->b[5 - i];
+}
+
+/* Rebuild the Ethernet header and write the frame to the capture */
+static void bnep_export(struct frame *frm)
+{
+	const bdaddr_t *local = conn_local(), *remote = BDADDR_ANY;
+	const uint8_t *p = frm->ptr;
+	struct conn_info *c;
+	uint8_t type, ext, eth[14];
+	int len = frm->len;
+
+	if (len < 1)
+		return;
+
+	type = *p++;
+	len--;
+
+	c = conn_get(frm->handle);
+	if (c)
+		remote = &c->bdaddr;
+
+	/* Addresses left out are those of the two ends of the link */
+	bdaddr2mac(eth, frm->in ? local : remote);
+	bdaddr2mac(eth + 6, frm->in ? remote : local);
+
+	switch (type & 0x7f) {
+	case BNEP_GENERAL_ETHERNET:
+		if (len < 14)
+			return;
+		memcpy(eth, p, 14);
+		p += 14;
+		len -= 14;
+		break;
+
+	case BNEP_COMPRESSED_ETHERNET:
+		if (len < 2)
+			return;
+		memcpy(eth + 12, p, 2);
+		p += 2;
+		len -= 2;
+		break;
+
+	case BNEP_COMPRESSED_ETHERNET_SOURCE_ONLY:
+		if (len < 8)
+			return;
+		memcpy(eth + 6, p, 8);
+		p += 8;
+		len -= 8;
+		break;
+
+	case BNEP_COMPRESSED_ETHERNET_DEST_ONLY:
+		if (len < 8)
+			return;
+		memcpy(eth, p, 6);
+		memcpy(eth + 12, p + 6, 2);
+		p += 8;
+		len -= 8;
+		break;
+
+	default:
+		return;
+	}
+
+	/* Extension headers sit between the BNEP header and the payload */
+	for (ext = type & 0x80; ext; ) {
+		if (len < 2 || len < 2 + p[1])
+			return;
+		ext = p[0] & 0x80;
+		len -= 2 + p[1];
+		p += 2 + p[1];
+	}
+
+	pcap_write(pan_pcap, &frm->ts, eth, sizeof(eth), p, len);
+}
+
 static void bnep_control(int level, struct frame *frm, int header_length)
 {
 	uint8_t uuid_size;
@@ -209,11 +297,66 @@ static void bnep_eval_extension(int level, struct frame *frm)
 		bnep_eval_extension(level, frm);
 }
 
+/* Structured counterpart of bnep_dump() */
+static void bnep_fields(uint8_t type, struct frame *frm)
+{
+	f_layer("bnep");
+	f_u8("type", type & 0x7f);
+	f_u8("ext", type >> 7);
+
+	switch (type & 0x7f) {
+	case BNEP_CONTROL:
+		if (frm->len >= 1)
+			f_u8("control", get_u8(frm));
+		return;
+
+	case BNEP_GENERAL_ETHERNET:
+		if (frm->len < 14)
+			return;
+		f_str("dst", get_macaddr(frm));
+		f_str("src", get_macaddr(frm));
+		break;
+
+	case BNEP_COMPRESSED_ETHERNET_DEST_ONLY:
+		if (frm->len < 8)
+			return;
+		f_str("dst", get_macaddr(frm));
+		break;
+
+	case BNEP_COMPRESSED_ETHERNET_SOURCE_ONLY:
+		if (frm->len < 8)
+			return;
+		f_str("src", get_macaddr(frm));
+		break;
+
+	case BNEP_COMPRESSED_ETHERNET:
+		if (frm->len < 2)
+			return;
+		break;
+
+	default:
+		return;
+	}
+
+	f_u16("proto", get_u16(frm));
+}
+
 void bnep_dump(int level, struct frame *frm)
 {
-	uint8_t type = get_u8(frm);
+	uint8_t type;
 	uint16_t proto = 0x0000;
-	int extension = type & 0x80;
+	int extension;
+
+	if (pan_pcap)
+		bnep_export(frm);
+
+	type = get_u8(frm);
+	extension = type & 0x80;
+
+	if (parser.sink) {
+		bnep_fields(type, frm);
+		return;
+	}
 
 	p_indent(level, frm);
 
@@ -161,6 +161,7 @@ void cmtp_dump(int level, struct frame *frm)
 	struct frame *msg;
 	uint8_t hdr, bid;
 	uint16_t len;
+	int shown = 0;
 
 	while (frm->len > 0) {
 
@@ -179,9 +180,21 @@ void cmtp_dump(int level, struct frame *frm)
 			break;
 		}
 
-		p_indent(level, frm);
-
-		printf("CMTP: %s: id %d len %d\n", bst2str(hdr & 0x03), bid, len);
+		if (parser.sink) {
+			/* Only the first block of a frame is shown */
+			if (!shown) {
+				f_layer("cmtp");
+				f_str("type", bst2str(hdr & 0x03));
+				f_u8("id", bid);
+				f_u16("blen", len);
+			}
+			shown = 1;
+		} else {
+			p_indent(level, frm);
+
+			printf("CMTP: %s: id %d len %d\n",
+					bst2str(hdr & 0x03), bid, len);
+		}
 
 		switch (hdr & 0x03) {
 		case 0x00:
@@ -190,8 +203,10 @@ void cmtp_dump(int level, struct frame *frm)
 			if (!msg)
 				break;
 
-			if (!p_filter(FILT_CAPI))
-				capi_dump(level + 1, msg);
+			if (parser.sink)
+				;
+			else if (!p_filter(FILT_CAPI))
+				PROF_CALL(PROF_CAPI, capi_dump(level + 1, msg));
 			else
 				raw_dump(level, msg);
 
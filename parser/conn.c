@@ -0,0 +1,264 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+
+#include "parser.h"
+
+#define CONN_TABLE_SIZE	16
+#define NAME_CACHE_SIZE	8
+
+static struct conn_info conn_table[DEVICE_SLOTS][CONN_TABLE_SIZE];
+
+/* Names often arrive before the connection is up */
+static struct {
+	bdaddr_t	bdaddr;
+	char		name[CONN_NAME_SIZE];
+} name_cache[DEVICE_SLOTS][NAME_CACHE_SIZE];
+
+static int name_next[DEVICE_SLOTS];
+
+/* Next entry to give up when every one is in use */
+static int conn_next[DEVICE_SLOTS];
+
+/* Address of the controller itself, from Read BD_ADDR */
+static bdaddr_t local_bdaddr[DEVICE_SLOTS];
+
+struct conn_info *conn_get(uint16_t handle)
+{
+	register struct conn_info *t = conn_table[parser.slot];
+	register int i;
+
+	for (i = 0; i < CONN_TABLE_SIZE; i++)
+		if (t[i].active && t[i].handle == handle)
+			return &t[i];
+
+	return NULL;
+}
+
+const bdaddr_t *conn_local(void)
+{
+	return &local_bdaddr[parser.slot];
+}
+
+/* Data of other devices and of links that weren't seen coming up */
+int __conn_filtered(uint16_t handle)
+{
+	struct conn_info *c = conn_get(handle);
+
+	return !c || bacmp(&c->bdaddr, parser.bdaddr);
+}
+
+static struct conn_info *get_bdaddr(const bdaddr_t *ba)
+{
+	register struct conn_info *t = conn_table[parser.slot];
+	register int i;
+
+	for (i = 0; i < CONN_TABLE_SIZE; i++)
+		if (t[i].active && !bacmp(&t[i].bdaddr, ba))
+			return &t[i];
+
+	return NULL;
+}
+
+/* A device may have SCO links too, only the ACL or LE one has a role */
+static struct conn_info *get_acl_bdaddr(const bdaddr_t *ba)
+{
+	register struct conn_info *t = conn_table[parser.slot];
+	register int i;
+
+	for (i = 0; i < CONN_TABLE_SIZE; i++)
+		if (t[i].active && !bacmp(&t[i].bdaddr, ba) &&
+				(t[i].link_type == ACL_LINK ||
+					t[i].link_type == LINK_TYPE_LE))
+			return &t[i];
+
+	return NULL;
+}
+
+static void add_conn(uint16_t handle, const bdaddr_t *ba, uint8_t link_type,
+							uint8_t role, uint8_t encrypt)
+{
+	register struct conn_info *t = conn_table[parser.slot];
+	register int i, pos = -1;
+
+	for (i = 0; i < CONN_TABLE_SIZE; i++) {
+		if (t[i].active && t[i].handle == handle) {
+			pos = i;
+			break;
+		}
+		if (pos < 0 && !t[i].active)
+			pos = i;
+	}
+
+	/* Links whose disconnect was missed would otherwise fill the table */
+	if (pos < 0) {
+		static int warned;
+
+		pos = conn_next[parser.slot];
+		conn_next[parser.slot] = (pos + 1) % CONN_TABLE_SIZE;
+
+		if (!warned) {
+			fprintf(stderr, "Too many connections, "
+					"forgetting handle %d\n", t[pos].handle);
+			warned = 1;
+		}
+	}
+
+	t[pos].active    = 1;
+	t[pos].handle    = handle;
+	t[pos].link_type = link_type;
+	t[pos].role      = role;
+	t[pos].encrypt   = encrypt;
+	bacpy(&t[pos].bdaddr, ba);
+	p_ba2str(ba, t[pos].addr);
+	t[pos].name[0]   = '\0';
+
+	for (i = 0; i < NAME_CACHE_SIZE; i++) {
+		if (!bacmp(&name_cache[parser.slot][i].bdaddr, ba)) {
+			strcpy(t[pos].name, name_cache[parser.slot][i].name);
+			break;
+		}
+	}
+}
+
+static void set_name(const bdaddr_t *ba, const uint8_t *name)
+{
+	struct conn_info *c = get_bdaddr(ba);
+	int i = name_next[parser.slot];
+
+	bacpy(&name_cache[parser.slot][i].bdaddr, ba);
+	memcpy(name_cache[parser.slot][i].name, name, CONN_NAME_SIZE - 1);
+	name_cache[parser.slot][i].name[CONN_NAME_SIZE - 1] = '\0';
+	name_next[parser.slot] = (i + 1) % NAME_CACHE_SIZE;
+
+	if (c)
+		strcpy(c->name, name_cache[parser.slot][i].name);
+}
+
+/* Keep the handle table in step with the events that change it */
+void conn_update(uint8_t event, void *ptr, int len)
+{
+	struct conn_info *c;
+
+	switch (event) {
+	case EVT_CMD_COMPLETE:
+		if (len >= EVT_CMD_COMPLETE_SIZE + READ_BD_ADDR_RP_SIZE) {
+			evt_cmd_complete *evt = ptr;
+			read_bd_addr_rp *rp = ptr + EVT_CMD_COMPLETE_SIZE;
+
+			if (btohs(evt->opcode) == cmd_opcode_pack(OGF_INFO_PARAM,
+							OCF_READ_BD_ADDR) &&
+								!rp->status)
+				bacpy(&local_bdaddr[parser.slot], &rp->bdaddr);
+		}
+		break;
+
+	case EVT_CONN_COMPLETE:
+		if (len >= EVT_CONN_COMPLETE_SIZE) {
+			evt_conn_complete *evt = ptr;
+
+			/* The role is only known after a Role Change */
+			if (!evt->status)
+				add_conn(btohs(evt->handle), &evt->bdaddr,
+					evt->link_type, 0xff, evt->encr_mode);
+		}
+		break;
+
+	case EVT_SYNC_CONN_COMPLETE:
+		if (len >= EVT_SYNC_CONN_COMPLETE_SIZE) {
+			evt_sync_conn_complete *evt = ptr;
+
+			if (!evt->status)
+				add_conn(btohs(evt->handle), &evt->bdaddr,
+						evt->link_type, 0xff, 0);
+		}
+		break;
+
+	case EVT_LE_META_EVENT:
+		if (len >= 1 + EVT_LE_CONN_COMPLETE_SIZE &&
+				((evt_le_meta_event *) ptr)->subevent ==
+							EVT_LE_CONN_COMPLETE) {
+			evt_le_connection_complete *evt = ptr + 1;
+
+			if (!evt->status)
+				add_conn(btohs(evt->handle), &evt->peer_bdaddr,
+						LINK_TYPE_LE, evt->role, 0);
+		}
+		break;
+
+	case EVT_ROLE_CHANGE:
+		if (len >= EVT_ROLE_CHANGE_SIZE) {
+			evt_role_change *evt = ptr;
+
+			c = get_acl_bdaddr(&evt->bdaddr);
+			if (c && !evt->status)
+				c->role = evt->role;
+		}
+		break;
+
+	case EVT_ENCRYPT_CHANGE:
+		if (len >= EVT_ENCRYPT_CHANGE_SIZE) {
+			evt_encrypt_change *evt = ptr;
+
+			c = conn_get(btohs(evt->handle));
+			if (c && !evt->status)
+				c->encrypt = evt->encrypt;
+		}
+		break;
+
+	case EVT_REMOTE_NAME_REQ_COMPLETE:
+		if (len >= EVT_REMOTE_NAME_REQ_COMPLETE_SIZE) {
+			evt_remote_name_req_complete *evt = ptr;
+
+			if (!evt->status)
+				set_name(&evt->bdaddr, evt->name);
+		}
+		break;
+
+	case EVT_DISCONN_COMPLETE:
+		if (len >= EVT_DISCONN_COMPLETE_SIZE) {
+			evt_disconn_complete *evt = ptr;
+
+			c = conn_get(btohs(evt->handle));
+			if (c && !evt->status)
+				c->active = 0;
+		}
+		break;
+	}
+}
@@ -0,0 +1,323 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Reader for the binary event stream. It has no dependencies besides
+ * libc so that it can be built into the programs consuming the stream.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "evtstream.h"
+
+#define EVT_BUF_SIZE	(256 * 1024)
+
+/* Far above any decoded frame, and no overflow when adding the header */
+#define EVT_REC_MAX	(16 * 1024 * 1024)
+
+struct evt_stream {
+	int		fd;
+	uint8_t		*map;		/* Whole file when mapped */
+	size_t		map_size;
+	uint8_t		*buf;
+	size_t		size;
+	size_t		len;
+	size_t		pos;
+	char		**names;
+	int		names_size;
+};
+
+static inline uint16_t le16(const uint8_t *p)
+{
+	return p[0] | p[1] << 8;
+}
+
+static inline uint32_t le32(const uint8_t *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+/* Make sure len bytes are available at the current position */
+static const uint8_t *evt_fill(struct evt_stream *s, size_t len)
+{
+	ssize_t n;
+
+	while (s->len - s->pos < len) {
+		if (s->map)
+			return NULL;
+
+		if (s->pos > 0) {
+			memmove(s->buf, s->buf + s->pos, s->len - s->pos);
+			s->len -= s->pos;
+			s->pos = 0;
+		}
+
+		if (len > s->size) {
+			uint8_t *buf;
+			size_t size = s->size;
+
+			while (size < len)
+				size *= 2;
+
+			buf = realloc(s->buf, size);
+			if (!buf)
+				return NULL;
+
+			s->buf = buf;
+			s->size = size;
+		}
+
+		n = read(s->fd, s->buf + s->len, s->size - s->len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return NULL;
+
+		s->len += n;
+	}
+
+	return s->buf + s->pos;
+}
+
+static int evt_add_name(struct evt_stream *s, uint16_t id,
+					const uint8_t *name, int len)
+{
+	char *str;
+
+	if (id >= s->names_size) {
+		char **names;
+		int size = s->names_size ? s->names_size : 256;
+
+		while (size <= id)
+			size *= 2;
+
+		names = realloc(s->names, size * sizeof(char *));
+		if (!names)
+			return -1;
+
+		memset(names + s->names_size, 0,
+				(size - s->names_size) * sizeof(char *));
+		s->names = names;
+		s->names_size = size;
+	}
+
+	str = malloc(len + 1);
+	if (!str)
+		return -1;
+
+	memcpy(str, name, len);
+	str[len] = '\0';
+
+	free(s->names[id]);
+	s->names[id] = str;
+
+	return 0;
+}
+
+struct evt_stream *evt_open(const char *file)
+{
+	struct evt_stream *s;
+	const uint8_t *hdr;
+	struct stat st;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+
+	if (!strcmp(file, "-"))
+		s->fd = dup(0);
+	else
+		s->fd = open(file, O_RDONLY);
+
+	if (s->fd < 0) {
+		free(s);
+		return NULL;
+	}
+
+	if (fstat(s->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		s->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+								s->fd, 0);
+		if (s->map == MAP_FAILED)
+			s->map = NULL;
+	}
+
+	if (s->map) {
+		madvise(s->map, st.st_size, MADV_SEQUENTIAL);
+		s->map_size = st.st_size;
+		s->buf = s->map;
+		s->len = s->size = st.st_size;
+	} else {
+		s->buf = malloc(EVT_BUF_SIZE);
+		s->size = EVT_BUF_SIZE;
+		if (!s->buf)
+			goto fail;
+	}
+
+	hdr = evt_fill(s, EVT_HDR_SIZE);
+	if (!hdr || memcmp(hdr, EVT_MAGIC, EVT_MAGIC_SIZE) ||
+				le32(hdr + EVT_MAGIC_SIZE) > EVT_VERSION) {
+		errno = EINVAL;
+		goto fail;
+	}
+
+	s->pos += EVT_HDR_SIZE;
+
+	return s;
+
+fail:
+	evt_close(s);
+	return NULL;
+}
+
+void evt_close(struct evt_stream *s)
+{
+	int i;
+
+	if (s->map)
+		munmap(s->map, s->map_size);
+	else
+		free(s->buf);
+
+	for (i = 0; i < s->names_size; i++)
+		free(s->names[i]);
+	free(s->names);
+
+	close(s->fd);
+	free(s);
+}
+
+int evt_next_frame(struct evt_stream *s, struct evt_frame *frm)
+{
+	const uint8_t *rec;
+	uint32_t len;
+	uint16_t type;
+
+	while (1) {
+		rec = evt_fill(s, EVT_REC_HDR_SIZE);
+		if (!rec)
+			return s->pos == s->len ? 0 : -1;
+
+		len = le32(rec);
+		type = le16(rec + 4);
+
+		/* The length is untrusted, don't let it wrap the sum */
+		if (len > EVT_REC_MAX - EVT_REC_HDR_SIZE) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		rec = evt_fill(s, EVT_REC_HDR_SIZE + len);
+		if (!rec)
+			return -1;
+
+		s->pos += EVT_REC_HDR_SIZE + len;
+		rec += EVT_REC_HDR_SIZE;
+
+		switch (type) {
+		case EVT_REC_NAME:
+			if (len < 2)
+				return -1;
+			if (evt_add_name(s, le16(rec), rec + 2, len - 2) < 0)
+				return -1;
+			break;
+
+		case EVT_REC_FRAME:
+			if (len < EVT_FRAME_HDR_SIZE)
+				return -1;
+
+			frm->sec   = le32(rec);
+			frm->usec  = le32(rec + 4);
+			frm->len   = le32(rec + 8);
+			frm->dev   = le16(rec + 12);
+			frm->in    = rec[14];
+			frm->layer = NULL;
+			frm->ptr   = rec + EVT_FRAME_HDR_SIZE;
+			frm->end   = rec + len;
+			return 1;
+		}
+	}
+}
+
+int evt_next_field(struct evt_stream *s, struct evt_frame *frm,
+						struct evt_field *f)
+{
+	const uint8_t *p = frm->ptr;
+
+	if (p == frm->end)
+		return 0;
+
+	if (frm->end - p < EVT_FIELD_HDR_SIZE)
+		return -1;
+
+	f->type = p[0];
+	f->id   = le16(p + 1);
+	f->len  = le16(p + 3);
+	f->data = p + EVT_FIELD_HDR_SIZE;
+	f->name = evt_name(s, f->id);
+
+	if (frm->end - f->data < f->len)
+		return -1;
+
+	frm->ptr = f->data + f->len;
+
+	if (f->type == EVT_FIELD_LAYER)
+		frm->layer = f->name;
+	f->layer = frm->layer;
+
+	return 1;
+}
+
+const char *evt_name(struct evt_stream *s, uint16_t id)
+{
+	if (id >= s->names_size || !s->names[id])
+		return "?";
+
+	return s->names[id];
+}
+
+uint32_t evt_uint(const struct evt_field *f)
+{
+	switch (f->len) {
+	case 1:
+		return f->data[0];
+	case 2:
+		return le16(f->data);
+	case 4:
+		return le32(f->data);
+	default:
+		return 0;
+	}
+}
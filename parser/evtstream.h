@@ -0,0 +1,123 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __EVTSTREAM_H
+#define __EVTSTREAM_H
+
+#include <stdint.h>
+
+/*
+ * Binary decoded event stream written by hcidump --binary.
+ * All numbers are little endian.
+ *
+ * The stream starts with an 8 byte magic and a 32 bit version,
+ * followed by records of an 8 byte header and a payload:
+ *
+ *	uint32_t len		payload length
+ *	uint16_t type		EVT_REC_*
+ *	uint16_t reserved
+ *
+ * EVT_REC_NAME defines a field or layer name before its first use:
+ *
+ *	uint16_t id
+ *	char     name[]		rest of the payload, not terminated
+ *
+ * EVT_REC_FRAME is one decoded frame:
+ *
+ *	uint32_t sec, usec	timestamp
+ *	uint32_t len		original frame length
+ *	uint16_t dev		device or source
+ *	uint8_t  in		direction, 1 for received
+ *	uint8_t  reserved
+ *
+ * followed by fields up to the end of the payload:
+ *
+ *	uint8_t  type		EVT_FIELD_*
+ *	uint16_t id		name
+ *	uint16_t len		value length
+ *	uint8_t  value[len]
+ *
+ * An EVT_FIELD_LAYER field with no value starts each protocol layer,
+ * the fields after it belong to that layer. UUIDs are 2, 4 or 16 bytes
+ * in big endian order, and bdaddr values are 6 bytes as on the air.
+ * Readers skip record and field types they don't know.
+ */
+
+#define EVT_MAGIC		"hcievts\0"
+#define EVT_MAGIC_SIZE		8
+#define EVT_VERSION		1
+
+#define EVT_HDR_SIZE		12
+#define EVT_REC_HDR_SIZE	8
+#define EVT_FRAME_HDR_SIZE	16
+#define EVT_FIELD_HDR_SIZE	5
+
+#define EVT_REC_NAME		1
+#define EVT_REC_FRAME		2
+
+#define EVT_FIELD_LAYER		0
+#define EVT_FIELD_U8		1
+#define EVT_FIELD_U16		2
+#define EVT_FIELD_U32		3
+#define EVT_FIELD_BDADDR	4
+#define EVT_FIELD_UUID		5
+#define EVT_FIELD_BYTES		6
+#define EVT_FIELD_STR		7
+
+struct evt_stream;
+
+struct evt_frame {
+	uint32_t	sec;
+	uint32_t	usec;
+	uint32_t	len;
+	uint16_t	dev;
+	uint8_t		in;
+	const char	*layer;		/* Current layer */
+	const uint8_t	*ptr;		/* Next field */
+	const uint8_t	*end;
+};
+
+struct evt_field {
+	uint8_t		type;
+	uint16_t	id;
+	const char	*name;
+	const char	*layer;		/* Name of the enclosing layer */
+	uint16_t	len;
+	const uint8_t	*data;
+};
+
+struct evt_stream *evt_open(const char *file);
+void evt_close(struct evt_stream *s);
+
+/*
+ * Return 1 for a frame, 0 at the end of the stream or -1 on error.
+ * The fields of a frame stay valid until the next evt_next_frame().
+ */
+int evt_next_frame(struct evt_stream *s, struct evt_frame *frm);
+int evt_next_field(struct evt_stream *s, struct evt_frame *frm,
+						struct evt_field *f);
+
+const char *evt_name(struct evt_stream *s, uint16_t id);
+uint32_t evt_uint(const struct evt_field *f);
+
+#endif /* __EVTSTREAM_H */
@@ -0,0 +1,403 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "parser.h"
+
+#define MAX_COLUMNS	32
+
+static const char *frame_field_names[] = {
+	"time", "dev", "dir", "len", NULL
+};
+
+/* Layers that fields can be extracted from */
+static const struct {
+	const char	*name;
+	const char	**fields;
+	unsigned long	filter;		/* Needed to decode the layer */
+} layers[] = {
+	{ "frame",	frame_field_names,	0			},
+	{ "hci",	hci_field_names,	FILT_HCI | FILT_SCO	},
+	{ "l2cap",	l2cap_field_names,	FILT_L2CAP		},
+	{ "rfcomm",	rfcomm_field_names,	FILT_RFCOMM		},
+	{ "sdp",	sdp_field_names,	FILT_SDP		},
+	{ "att",	att_field_names,	FILT_ATT		},
+	{ "avdtp",	avdtp_field_names,	FILT_AVDTP		},
+	{ }
+};
+
+struct buffer {
+	char		*data;
+	int		len;
+	int		size;
+};
+
+static struct {
+	int		layer;
+	const char	*name;
+	int		set;
+	int		text;		/* Value is in buf instead of val */
+	uint32_t	val;
+	struct buffer	buf;
+} columns[MAX_COLUMNS];
+
+static int num_columns = 0;
+
+static unsigned long layer_mask[sizeof(layers) / sizeof(layers[0])];
+static unsigned long cur_mask;		/* Columns of the current layer */
+static int frame_only = 1;
+static char sep = '\t';
+
+static struct buffer row;
+
+static const char hex[] = "0123456789abcdef";
+
+static char *buf_reserve(struct buffer *b, int len)
+{
+	if (b->len + len > b->size) {
+		char *data;
+		int size = b->size ? b->size : 64;
+
+		while (size < b->len + len)
+			size *= 2;
+
+		data = realloc(b->data, size);
+		if (!data) {
+			perror("Can't allocate row buffer");
+			exit(1);
+		}
+
+		b->data = data;
+		b->size = size;
+	}
+
+	return b->data + b->len;
+}
+
+static inline void buf_putc(struct buffer *b, char c)
+{
+	*buf_reserve(b, 1) = c;
+	b->len++;
+}
+
+static inline void buf_put(struct buffer *b, const char *str, int len)
+{
+	memcpy(buf_reserve(b, len), str, len);
+	b->len += len;
+}
+
+static void buf_uint(struct buffer *b, uint32_t val)
+{
+	char tmp[10];
+	int n = 0;
+
+	do {
+		tmp[n++] = '0' + val % 10;
+		val /= 10;
+	} while (val);
+
+	buf_reserve(b, n);
+	while (n > 0)
+		b->data[b->len++] = tmp[--n];
+}
+
+static void buf_hex(struct buffer *b, const unsigned char *data, int len)
+{
+	char *p = buf_reserve(b, len * 2);
+	int i;
+
+	for (i = 0; i < len; i++) {
+		*p++ = hex[data[i] >> 4];
+		*p++ = hex[data[i] & 0x0f];
+	}
+
+	b->len += len * 2;
+}
+
+static void buf_str(struct buffer *b, const char *str)
+{
+	int i, len = strlen(str);
+	char *p;
+
+	/* Quote the string if it contains the separator */
+	if (!memchr(str, sep, len) && !memchr(str, '"', len) &&
+						!memchr(str, '\n', len)) {
+		buf_put(b, str, len);
+		return;
+	}
+
+	p = buf_reserve(b, len * 2 + 2);
+	*p++ = '"';
+	for (i = 0; i < len; i++) {
+		if (str[i] == '"')
+			*p++ = '"';
+		*p++ = str[i] == '\n' ? ' ' : str[i];
+	}
+	*p++ = '"';
+
+	b->len = p - b->data;
+}
+
+static int find_field(const char *layer, int len, const char *name)
+{
+	int i, j;
+
+	for (i = 0; layers[i].name; i++) {
+		if (strlen(layers[i].name) != (size_t) len ||
+				strncmp(layers[i].name, layer, len))
+			continue;
+
+		for (j = 0; layers[i].fields[j]; j++)
+			if (!strcmp(layers[i].fields[j], name))
+				return i;
+	}
+
+	return -1;
+}
+
+unsigned long extract_init(char *fields, int csv)
+{
+	unsigned long filter = 0;
+	char *name, *dot;
+	int i, layer;
+
+	if (csv)
+		sep = ',';
+
+	for (name = strtok(fields, ","); name; name = strtok(NULL, ",")) {
+		dot = strchr(name, '.');
+		layer = dot ? find_field(name, dot - name, dot + 1) : -1;
+
+		if (layer < 0) {
+			fprintf(stderr, "Unknown field %s\n", name);
+			exit(1);
+		}
+
+		if (num_columns == MAX_COLUMNS) {
+			fprintf(stderr, "Too many fields\n");
+			exit(1);
+		}
+
+		columns[num_columns].layer = layer;
+		columns[num_columns].name = dot + 1;
+		layer_mask[layer] |= 1ul << num_columns;
+		num_columns++;
+
+		if (layer > 0)
+			frame_only = 0;
+
+		filter |= layers[layer].filter;
+	}
+
+	/* Header line with the field names */
+	for (i = 0; i < num_columns; i++) {
+		if (i > 0)
+			buf_putc(&row, sep);
+		buf_str(&row, layers[columns[i].layer].name);
+		buf_putc(&row, '.');
+		buf_str(&row, columns[i].name);
+	}
+	buf_putc(&row, '\n');
+
+	fwrite(row.data, 1, row.len, stdout);
+
+	return filter;
+}
+
+static void ext_begin(struct frame *frm)
+{
+	int i;
+
+	for (i = 0; i < num_columns; i++)
+		columns[i].set = 0;
+
+	cur_mask = 0;
+}
+
+static void ext_layer(const char *name)
+{
+	int i;
+
+	cur_mask = 0;
+
+	for (i = 1; layers[i].name; i++) {
+		if (!strcmp(layers[i].name, name)) {
+			cur_mask = layer_mask[i];
+			break;
+		}
+	}
+}
+
+/*
+ * Column for a field of the current layer, if it was asked for. Values
+ * that aren't plain numbers are formatted right away since they may
+ * point to temporary storage of the dissector.
+ */
+static inline int ext_column(const char *name, int text)
+{
+	unsigned long mask = cur_mask;
+	int i;
+
+	for (i = 0; mask; i++, mask >>= 1) {
+		if (!(mask & 1) || columns[i].set)
+			continue;
+
+		if (!strcmp(columns[i].name, name)) {
+			columns[i].set = 1;
+			columns[i].text = text;
+			columns[i].buf.len = 0;
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void ext_uint(const char *name, uint32_t val, int size)
+{
+	int i;
+
+	if (!cur_mask || (i = ext_column(name, 0)) < 0)
+		return;
+
+	columns[i].val = val;
+}
+
+static void ext_str(const char *name, const char *val)
+{
+	int i;
+
+	if (!cur_mask || (i = ext_column(name, 1)) < 0)
+		return;
+
+	buf_str(&columns[i].buf, val);
+}
+
+static void ext_bdaddr(const char *name, const bdaddr_t *ba)
+{
+	char addr[18];
+	int i;
+
+	if (!cur_mask || (i = ext_column(name, 1)) < 0)
+		return;
+
+	p_ba2str(ba, addr);
+	buf_put(&columns[i].buf, addr, strlen(addr));
+}
+
+static void ext_bytes(const char *name, const void *data, int len)
+{
+	int i;
+
+	if (!cur_mask || (i = ext_column(name, 1)) < 0)
+		return;
+
+	buf_hex(&columns[i].buf, data, len);
+}
+
+static void ext_uuid(const char *name, const void *uuid, int size)
+{
+	ext_bytes(name, uuid, size);
+}
+
+static void frame_column(int i, struct frame *frm)
+{
+	uint32_t usec = frm->ts.tv_usec;
+	const char *name = columns[i].name;
+	char *p;
+	int n;
+
+	switch (name[0]) {
+	case 't':
+		buf_uint(&row, frm->ts.tv_sec);
+		p = buf_reserve(&row, 7);
+		*p = '.';
+		for (n = 6; n > 0; n--, usec /= 10)
+			p[n] = '0' + usec % 10;
+		row.len += 7;
+		break;
+	case 'd':
+		if (name[1] == 'e')
+			buf_uint(&row, frm->dev_id);
+		else
+			buf_str(&row, frm->in ? "in" : "out");
+		break;
+	case 'l':
+		buf_uint(&row, frm->data_len);
+		break;
+	}
+}
+
+static void ext_end(struct frame *frm)
+{
+	int i, any = frame_only;
+
+	for (i = 0; i < num_columns && !any; i++)
+		any = columns[i].set;
+
+	if (!any)
+		return;
+
+	row.len = 0;
+
+	for (i = 0; i < num_columns; i++) {
+		if (i > 0)
+			buf_putc(&row, sep);
+
+		if (columns[i].layer == 0)
+			frame_column(i, frm);
+		else if (!columns[i].set)
+			continue;
+		else if (columns[i].text)
+			buf_put(&row, columns[i].buf.data, columns[i].buf.len);
+		else
+			buf_uint(&row, columns[i].val);
+	}
+
+	buf_putc(&row, '\n');
+
+	PROF_CALL(PROF_OUTPUT, fwrite(row.data, 1, row.len, stdout));
+}
+
+struct field_sink extract_sink = {
+	.begin	= ext_begin,
+	.layer	= ext_layer,
+	.uint	= ext_uint,
+	.str	= ext_str,
+	.bdaddr	= ext_bdaddr,
+	.uuid	= ext_uuid,
+	.bytes	= ext_bytes,
+	.end	= ext_end,
+};
@@ -0,0 +1,465 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+
+#include "parser.h"
+
+/* Indexed directly by the 12 bit connection handle */
+#define CONN_SLOTS	4096
+
+enum {
+	POOL_ACL,
+	POOL_SCO,
+	POOL_LE,
+	POOL_MAX
+};
+
+static const char *pool_str[POOL_MAX] = { "acl", "sco", "le" };
+
+struct flow_pool {
+	uint16_t	max;		/* Controller buffers, 0 if unknown */
+	uint16_t	used;		/* Packets not completed yet */
+	uint16_t	peak;
+	unsigned long	sent;
+	unsigned long	overruns;	/* Sent with no buffer left */
+	int		stalled;
+	struct timeval	stall_start;
+	unsigned long	stalls;
+	uint64_t	stall_usec;
+	uint64_t	stall_max;
+	struct timeval	last;		/* For the average occupancy */
+	uint64_t	span;
+	uint64_t	area;		/* Sum of used times microseconds */
+};
+
+struct flow_conn {
+	uint16_t	handle;
+	uint8_t		active;
+	uint8_t		pool;
+	uint16_t	outstanding;
+	uint16_t	peak;
+	unsigned long	sent;
+	unsigned long	completed;
+};
+
+static struct flow_dev {
+	uint16_t		dev_id;
+	int			seen;
+	int			sco_flow;	/* SCO packets are flow controlled */
+	struct flow_pool	pool[POOL_MAX];
+	struct flow_conn	conn[CONN_SLOTS];
+} flow_table[DEVICE_SLOTS];
+
+static FILE *flow_log;
+
+static inline uint16_t get_le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint64_t tv_diff(const struct timeval *a,
+						const struct timeval *b)
+{
+	long long usec = (a->tv_sec - b->tv_sec) * 1000000ll +
+						(a->tv_usec - b->tv_usec);
+
+	return usec > 0 ? usec : 0;
+}
+
+void flow_init(int fd)
+{
+	if (fd < 0)
+		return;
+
+	flow_log = fdopen(fd, "w");
+	if (!flow_log) {
+		perror("Can't open flow log");
+		exit(1);
+	}
+
+	fprintf(flow_log, "time\tdev\tpool\tused\tmax\thandle\toutstanding\n");
+}
+
+static inline struct flow_conn *get_conn(struct flow_dev *d,
+						uint16_t handle, int create)
+{
+	struct flow_conn *c = &d->conn[handle & 0x0fff];
+
+	if (!c->active) {
+		if (!create)
+			return NULL;
+
+		c->handle = handle & 0x0fff;
+		c->active = 1;
+		c->pool = POOL_ACL;
+	}
+
+	return c;
+}
+
+/* LE links use the ACL buffers when the controller has no LE ones */
+static inline struct flow_pool *conn_pool(struct flow_dev *d,
+							struct flow_conn *c)
+{
+	if (c->pool == POOL_LE && !d->pool[POOL_LE].max)
+		return &d->pool[POOL_ACL];
+
+	return &d->pool[c->pool];
+}
+
+/* Account the time spent at the current level before it changes */
+static void pool_advance(struct flow_pool *p, const struct timeval *ts)
+{
+	uint64_t usec = 0;
+
+	if (p->last.tv_sec || p->last.tv_usec)
+		usec = tv_diff(ts, &p->last);
+
+	p->span += usec;
+	p->area += (uint64_t) p->used * usec;
+	p->last = *ts;
+}
+
+static void pool_log(struct flow_dev *d, struct flow_pool *p,
+				struct flow_conn *c, const struct timeval *ts)
+{
+	if (!flow_log)
+		return;
+
+	fprintf(flow_log, "%lu.%06lu\t%d\t%s\t%u\t%u\t%u\t%u\n",
+			(unsigned long) ts->tv_sec, (unsigned long) ts->tv_usec,
+			d->dev_id, pool_str[p - d->pool], p->used, p->max,
+			c ? c->handle : 0, c ? c->outstanding : 0);
+}
+
+static void pool_release(struct flow_dev *d, struct flow_pool *p,
+				struct flow_conn *c, uint16_t count,
+				const struct timeval *ts)
+{
+	pool_advance(p, ts);
+
+	p->used = count < p->used ? p->used - count : 0;
+
+	if (p->stalled && p->used < p->max) {
+		uint64_t usec = tv_diff(ts, &p->stall_start);
+
+		p->stalled = 0;
+		p->stalls++;
+		p->stall_usec += usec;
+		if (usec > p->stall_max)
+			p->stall_max = usec;
+	}
+
+	pool_log(d, p, c, ts);
+}
+
+static void flow_sent(struct flow_dev *d, uint16_t handle, int sco,
+						const struct timeval *ts)
+{
+	struct flow_conn *c = get_conn(d, handle, 1);
+	struct flow_pool *p;
+
+	if (sco)
+		c->pool = POOL_SCO;
+
+	p = conn_pool(d, c);
+
+	pool_advance(p, ts);
+
+	if (p->max && p->used >= p->max)
+		p->overruns++;
+
+	p->used++;
+	p->sent++;
+	if (p->used > p->peak)
+		p->peak = p->used;
+
+	c->outstanding++;
+	c->sent++;
+	if (c->outstanding > c->peak)
+		c->peak = c->outstanding;
+
+	/* The host has to wait for the controller from here on */
+	if (p->max && p->used >= p->max && !p->stalled) {
+		p->stalled = 1;
+		p->stall_start = *ts;
+	}
+
+	pool_log(d, p, c, ts);
+}
+
+static void flow_completed(struct flow_dev *d, const uint8_t *data, int len,
+						const struct timeval *ts)
+{
+	int i, num;
+
+	if (len < 1)
+		return;
+
+	num = data[0];
+	data++; len--;
+
+	for (i = 0; i < num && len >= 4; i++, data += 4, len -= 4) {
+		struct flow_conn *c = get_conn(d, get_le16(data), 0);
+		uint16_t count = get_le16(data + 2);
+
+		if (!c)
+			continue;
+
+		c->completed += count;
+		c->outstanding = count < c->outstanding ?
+						c->outstanding - count : 0;
+
+		pool_release(d, conn_pool(d, c), c, count, ts);
+	}
+}
+
+static void flow_connected(struct flow_dev *d, uint16_t handle, int pool)
+{
+	struct flow_conn *c = &d->conn[handle & 0x0fff];
+
+	/* Handles are reused, so start over */
+	memset(c, 0, sizeof(*c));
+	c->handle = handle & 0x0fff;
+	c->active = 1;
+	c->pool = pool;
+}
+
+/* Packets of a link that goes away are implicitly completed */
+static void flow_disconnected(struct flow_dev *d, uint16_t handle,
+						const struct timeval *ts)
+{
+	struct flow_conn *c = get_conn(d, handle, 0);
+
+	if (!c || !c->outstanding)
+		return;
+
+	pool_release(d, conn_pool(d, c), c, c->outstanding, ts);
+	c->outstanding = 0;
+}
+
+static void flow_reset(struct flow_dev *d, const struct timeval *ts)
+{
+	int i;
+
+	for (i = 0; i < POOL_MAX; i++) {
+		if (d->pool[i].used)
+			pool_release(d, &d->pool[i], NULL,
+						d->pool[i].used, ts);
+		d->pool[i].max = 0;
+	}
+
+	for (i = 0; i < CONN_SLOTS; i++)
+		d->conn[i].outstanding = 0;
+
+	d->sco_flow = 0;
+}
+
+static void flow_command(struct flow_dev *d, const uint8_t *data, int len,
+						const struct timeval *ts)
+{
+	uint16_t opcode = get_le16(data);
+
+	data += 3;
+	len -= 3;
+
+	switch (opcode) {
+	case cmd_opcode_pack(OGF_HOST_CTL, OCF_RESET):
+		flow_reset(d, ts);
+		break;
+
+	case cmd_opcode_pack(OGF_HOST_CTL, OCF_WRITE_SYNC_FLOW_ENABLE):
+		if (len >= 1)
+			d->sco_flow = data[0];
+		break;
+	}
+}
+
+static void flow_cmd_complete(struct flow_dev *d, const uint8_t *data,
+								int len)
+{
+	uint16_t opcode;
+
+	if (len < 4 || data[3])
+		return;
+
+	opcode = get_le16(data + 1);
+	data += 4;
+	len -= 4;
+
+	switch (opcode) {
+	case cmd_opcode_pack(OGF_INFO_PARAM, OCF_READ_BUFFER_SIZE):
+		if (len < 7)
+			break;
+		d->pool[POOL_ACL].max = get_le16(data + 3);
+		d->pool[POOL_SCO].max = get_le16(data + 5);
+		break;
+
+	case cmd_opcode_pack(OGF_LE_CTL, OCF_LE_READ_BUFFER_SIZE):
+		if (len < 3)
+			break;
+		d->pool[POOL_LE].max = data[2];
+		break;
+	}
+}
+
+static void flow_event(struct flow_dev *d, uint8_t event,
+			const uint8_t *data, int len, const struct timeval *ts)
+{
+	switch (event) {
+	case EVT_NUM_COMP_PKTS:
+		flow_completed(d, data, len, ts);
+		break;
+
+	case EVT_CMD_COMPLETE:
+		flow_cmd_complete(d, data, len);
+		break;
+
+	case EVT_CONN_COMPLETE:
+		/* Link type 0 is SCO, 1 is ACL */
+		if (len >= 10 && !data[0])
+			flow_connected(d, get_le16(data + 1),
+					data[9] == 0x01 ? POOL_ACL : POOL_SCO);
+		break;
+
+	case EVT_SYNC_CONN_COMPLETE:
+		if (len >= 3 && !data[0])
+			flow_connected(d, get_le16(data + 1), POOL_SCO);
+		break;
+
+	case EVT_LE_META_EVENT:
+		if (len >= 4 && data[0] == EVT_LE_CONN_COMPLETE && !data[1])
+			flow_connected(d, get_le16(data + 2), POOL_LE);
+		break;
+
+	case EVT_DISCONN_COMPLETE:
+		if (len >= 3 && !data[0])
+			flow_disconnected(d, get_le16(data + 1), ts);
+		break;
+	}
+}
+
+void __flow_frame(struct frame *frm)
+{
+	const uint8_t *data = frm->ptr;
+	int len = frm->len;
+	struct flow_dev *d;
+
+	if (len < 3)
+		return;
+
+	set_device(frm->dev_id);
+	d = &flow_table[parser.slot];
+	d->dev_id = frm->dev_id;
+	d->seen = 1;
+
+	switch (data[0]) {
+	case HCI_COMMAND_PKT:
+		if (len >= 4)
+			flow_command(d, data + 1, len - 1, &frm->ts);
+		break;
+
+	case HCI_EVENT_PKT:
+		flow_event(d, data[1], data + 3, len - 3, &frm->ts);
+		break;
+
+	case HCI_ACLDATA_PKT:
+		if (!frm->in)
+			flow_sent(d, get_le16(data + 1) & 0x0fff, 0, &frm->ts);
+		break;
+
+	case HCI_SCODATA_PKT:
+		if (!frm->in && d->sco_flow)
+			flow_sent(d, get_le16(data + 1) & 0x0fff, 1, &frm->ts);
+		break;
+	}
+}
+
+void flow_dump(FILE *out)
+{
+	int i, j;
+
+	if (flow_log)
+		fflush(flow_log);
+
+	for (i = 0; i < DEVICE_SLOTS; i++) {
+		struct flow_dev *d = &flow_table[i];
+
+		if (!d->seen)
+			continue;
+
+		for (j = 0; j < POOL_MAX; j++) {
+			struct flow_pool *p = &d->pool[j];
+			uint64_t stall = p->stall_usec;
+
+			if (!p->sent)
+				continue;
+
+			/* Count a stall that is still going on */
+			if (p->stalled)
+				stall += tv_diff(&p->last, &p->stall_start);
+
+			fprintf(out, "flow: hci%d %s buffers %u sent %lu "
+					"peak %u avg %.2f now %u\n",
+					d->dev_id, pool_str[j], p->max, p->sent,
+					p->peak, p->span ? (double) p->area / p->span :
+					0.0, p->used);
+
+			fprintf(out, "flow: hci%d %s stalls %lu%s total %.3f ms "
+					"max %.3f ms overruns %lu\n",
+					d->dev_id, pool_str[j], p->stalls,
+					p->stalled ? "+1" : "", stall / 1000.0,
+					p->stall_max / 1000.0, p->overruns);
+		}
+
+		for (j = 0; j < CONN_SLOTS; j++) {
+			struct flow_conn *c = &d->conn[j];
+
+			if (!c->active || !c->sent)
+				continue;
+
+			fprintf(out, "  handle %d %s sent %lu completed %lu "
+					"outstanding %u peak %u\n",
+					c->handle, pool_str[c->pool], c->sent,
+					c->completed, c->outstanding, c->peak);
+		}
+	}
+
+	fflush(out);
+}
@@ -0,0 +1,847 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+
+#include "parser.h"
+
+#define GATT_DBS	16
+#define GATT_CONNS	16
+
+/* Attribute handles are looked up through a two level table */
+#define GATT_PAGE_BITS	8
+#define GATT_PAGE_SIZE	(1 << GATT_PAGE_BITS)
+#define GATT_PAGES	(0x10000 >> GATT_PAGE_BITS)
+
+#define GATT_PRIM_SVC_UUID	0x2800
+#define GATT_SND_SVC_UUID	0x2801
+#define GATT_INCLUDE_UUID	0x2802
+#define GATT_CHARAC_UUID	0x2803
+#define GATT_SERVICE_CHANGED	0x2A05
+
+#define ATT_OP_FIND_INFO_RESP		0x05
+#define ATT_OP_FIND_BY_TYPE_REQ		0x06
+#define ATT_OP_FIND_BY_TYPE_RESP	0x07
+#define ATT_OP_READ_BY_TYPE_REQ		0x08
+#define ATT_OP_READ_BY_TYPE_RESP	0x09
+#define ATT_OP_READ_BY_GROUP_REQ	0x10
+#define ATT_OP_READ_BY_GROUP_RESP	0x11
+#define ATT_OP_HANDLE_IND		0x1D
+
+enum {
+	GATT_NONE,
+	GATT_SERVICE,		/* Service declaration */
+	GATT_CHARAC,		/* Characteristic declaration */
+	GATT_VALUE,		/* Characteristic value */
+	GATT_DESC,		/* Characteristic descriptor */
+};
+
+/* In the little endian order of the air, 16 bit if it fits the base */
+struct gatt_uuid {
+	uint8_t		len;
+	uint8_t		val[16];
+};
+
+struct gatt_attr {
+	uint8_t		kind;
+	uint8_t		props;
+	uint16_t	owner;		/* Service of a declaration, declaration
+					   of a value, value of a descriptor */
+	uint16_t	end;		/* Last handle of a service */
+	struct gatt_uuid uuid;
+};
+
+struct gatt_db {
+	uint8_t		used;
+	uint8_t		slot;		/* Device slot */
+	uint8_t		known;		/* Keyed by address, else by handle */
+	uint16_t	handle;
+	bdaddr_t	bdaddr;
+	struct gatt_attr *page[GATT_PAGES];
+};
+
+/* The discovery request a response is the answer to */
+struct gatt_pending {
+	uint8_t		opcode;
+	uint16_t	type;
+	struct gatt_uuid value;
+};
+
+struct gatt_conn {
+	uint8_t		used;
+	uint8_t		slot;
+	uint8_t		known;
+	uint16_t	handle;
+	bdaddr_t	bdaddr;
+	struct gatt_db	*remote;
+	struct gatt_pending pending[2];	/* By direction of the request */
+};
+
+/* Databases of peers outlive their connections */
+static struct gatt_db dbs[GATT_DBS];
+static int db_next = 0;
+
+/* Our own database is the same for every peer */
+static struct gatt_db local_dbs[DEVICE_SLOTS];
+
+static struct gatt_conn conns[GATT_CONNS];
+static int conn_next = 0;
+
+static const uint8_t base_uuid[12] = {
+	0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80,
+	0x00, 0x10, 0x00, 0x00
+};
+
+struct uuid_name {
+	uint16_t	uuid;
+	const char	*name;
+};
+
+/* Sorted by UUID for the binary search */
+static const struct uuid_name uuid_names[] = {
+	{ 0x1800, "Generic Access"			},
+	{ 0x1801, "Generic Attribute"			},
+	{ 0x1802, "Immediate Alert"			},
+	{ 0x1803, "Link Loss"				},
+	{ 0x1804, "Tx Power"				},
+	{ 0x1805, "Current Time"			},
+	{ 0x1806, "Reference Time Update"		},
+	{ 0x1807, "Next DST Change"			},
+	{ 0x1808, "Glucose"				},
+	{ 0x1809, "Health Thermometer"			},
+	{ 0x180a, "Device Information"			},
+	{ 0x180d, "Heart Rate"				},
+	{ 0x180e, "Phone Alert Status"			},
+	{ 0x180f, "Battery"				},
+	{ 0x1810, "Blood Pressure"			},
+	{ 0x1811, "Alert Notification"			},
+	{ 0x1812, "Human Interface Device"		},
+	{ 0x1813, "Scan Parameters"			},
+	{ 0x1814, "Running Speed and Cadence"		},
+	{ 0x1816, "Cycling Speed and Cadence"		},
+	{ 0x1818, "Cycling Power"			},
+	{ 0x1819, "Location and Navigation"		},
+	{ 0x2900, "Characteristic Extended Properties"	},
+	{ 0x2901, "Characteristic User Description"	},
+	{ 0x2902, "Client Characteristic Configuration"	},
+	{ 0x2903, "Server Characteristic Configuration"	},
+	{ 0x2904, "Characteristic Presentation Format"	},
+	{ 0x2905, "Characteristic Aggregate Format"	},
+	{ 0x2906, "Valid Range"				},
+	{ 0x2907, "External Report Reference"		},
+	{ 0x2908, "Report Reference"			},
+	{ 0x2a00, "Device Name"				},
+	{ 0x2a01, "Appearance"				},
+	{ 0x2a02, "Peripheral Privacy Flag"		},
+	{ 0x2a03, "Reconnection Address"		},
+	{ 0x2a04, "Peripheral Preferred Connection Parameters" },
+	{ 0x2a05, "Service Changed"			},
+	{ 0x2a06, "Alert Level"				},
+	{ 0x2a07, "Tx Power Level"			},
+	{ 0x2a08, "Date Time"				},
+	{ 0x2a09, "Day of Week"				},
+	{ 0x2a0a, "Day Date Time"			},
+	{ 0x2a0c, "Exact Time 256"			},
+	{ 0x2a0d, "DST Offset"				},
+	{ 0x2a0e, "Time Zone"				},
+	{ 0x2a0f, "Local Time Information"		},
+	{ 0x2a11, "Time with DST"			},
+	{ 0x2a12, "Time Accuracy"			},
+	{ 0x2a13, "Time Source"				},
+	{ 0x2a14, "Reference Time Information"		},
+	{ 0x2a16, "Time Update Control Point"		},
+	{ 0x2a17, "Time Update State"			},
+	{ 0x2a18, "Glucose Measurement"			},
+	{ 0x2a19, "Battery Level"			},
+	{ 0x2a1c, "Temperature Measurement"		},
+	{ 0x2a1d, "Temperature Type"			},
+	{ 0x2a1e, "Intermediate Temperature"		},
+	{ 0x2a21, "Measurement Interval"		},
+	{ 0x2a22, "Boot Keyboard Input Report"		},
+	{ 0x2a23, "System ID"				},
+	{ 0x2a24, "Model Number String"			},
+	{ 0x2a25, "Serial Number String"		},
+	{ 0x2a26, "Firmware Revision String"		},
+	{ 0x2a27, "Hardware Revision String"		},
+	{ 0x2a28, "Software Revision String"		},
+	{ 0x2a29, "Manufacturer Name String"		},
+	{ 0x2a2a, "IEEE 11073-20601 Regulatory Certification Data List" },
+	{ 0x2a2b, "Current Time"			},
+	{ 0x2a31, "Scan Refresh"			},
+	{ 0x2a32, "Boot Keyboard Output Report"		},
+	{ 0x2a33, "Boot Mouse Input Report"		},
+	{ 0x2a34, "Glucose Measurement Context"		},
+	{ 0x2a35, "Blood Pressure Measurement"		},
+	{ 0x2a36, "Intermediate Cuff Pressure"		},
+	{ 0x2a37, "Heart Rate Measurement"		},
+	{ 0x2a38, "Body Sensor Location"		},
+	{ 0x2a39, "Heart Rate Control Point"		},
+	{ 0x2a3f, "Alert Status"			},
+	{ 0x2a40, "Ringer Control Point"		},
+	{ 0x2a41, "Ringer Setting"			},
+	{ 0x2a42, "Alert Category ID Bit Mask"		},
+	{ 0x2a43, "Alert Category ID"			},
+	{ 0x2a44, "Alert Notification Control Point"	},
+	{ 0x2a45, "Unread Alert Status"			},
+	{ 0x2a46, "New Alert"				},
+	{ 0x2a47, "Supported New Alert Category"	},
+	{ 0x2a48, "Supported Unread Alert Category"	},
+	{ 0x2a49, "Blood Pressure Feature"		},
+	{ 0x2a4a, "HID Information"			},
+	{ 0x2a4b, "Report Map"				},
+	{ 0x2a4c, "HID Control Point"			},
+	{ 0x2a4d, "Report"				},
+	{ 0x2a4e, "Protocol Mode"			},
+	{ 0x2a4f, "Scan Interval Window"		},
+	{ 0x2a50, "PnP ID"				},
+	{ 0x2a51, "Glucose Feature"			},
+	{ 0x2a52, "Record Access Control Point"		},
+	{ 0x2a53, "RSC Measurement"			},
+	{ 0x2a54, "RSC Feature"				},
+	{ 0x2a55, "SC Control Point"			},
+	{ 0x2a5b, "CSC Measurement"			},
+	{ 0x2a5c, "CSC Feature"				},
+	{ 0x2a5d, "Sensor Location"			},
+};
+
+static const char *props_names[8] = {
+	"broadcast", "read", "write-cmd", "write", "notify", "indicate",
+	"signed-write", "extended"
+};
+
+static inline uint16_t get_le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+/* UUIDs on the Bluetooth base are kept in their 16 bit form */
+static void set_uuid(struct gatt_uuid *u, const uint8_t *data, int len)
+{
+	if (len == 16 && !memcmp(data, base_uuid, sizeof(base_uuid)) &&
+						!data[14] && !data[15]) {
+		data += 12;
+		len = 2;
+	}
+
+	if (len != 2 && len != 16) {
+		u->len = 0;
+		return;
+	}
+
+	u->len = len;
+	memcpy(u->val, data, len);
+}
+
+static inline uint16_t uuid16(const struct gatt_uuid *u)
+{
+	return u->len == 2 ? get_le16(u->val) : 0;
+}
+
+static int cmp_uuid_name(const void *key, const void *elem)
+{
+	return *(const uint16_t *) key - ((const struct uuid_name *) elem)->uuid;
+}
+
+static char *uuid_str(const struct gatt_uuid *u, char *str, size_t size)
+{
+	const uint8_t *v = u->val;
+	uint16_t uuid;
+
+	if (u->len == 16) {
+		snprintf(str, size, "%02x%02x%02x%02x-%02x%02x-%02x%02x-"
+				"%02x%02x-%02x%02x%02x%02x%02x%02x",
+				v[15], v[14], v[13], v[12], v[11], v[10],
+				v[9], v[8], v[7], v[6], v[5], v[4],
+				v[3], v[2], v[1], v[0]);
+		return str;
+	}
+
+	uuid = uuid16(u);
+
+	if (uuid) {
+		const struct uuid_name *n = bsearch(&uuid, uuid_names,
+				sizeof(uuid_names) / sizeof(uuid_names[0]),
+				sizeof(uuid_names[0]), cmp_uuid_name);
+
+		if (n)
+			snprintf(str, size, "%s", n->name);
+		else
+			snprintf(str, size, "0x%4.4x", uuid);
+		return str;
+	}
+
+	snprintf(str, size, "unknown");
+	return str;
+}
+
+static inline struct gatt_attr *lookup(struct gatt_db *db, uint16_t handle)
+{
+	struct gatt_attr *p = db->page[handle >> GATT_PAGE_BITS];
+
+	if (!p)
+		return NULL;
+
+	p += handle & (GATT_PAGE_SIZE - 1);
+
+	return p->kind != GATT_NONE ? p : NULL;
+}
+
+static struct gatt_attr *insert(struct gatt_db *db, uint16_t handle)
+{
+	struct gatt_attr **p = &db->page[handle >> GATT_PAGE_BITS];
+
+	if (!*p) {
+		*p = calloc(GATT_PAGE_SIZE, sizeof(struct gatt_attr));
+		if (!*p) {
+			perror("Can't allocate GATT database");
+			exit(1);
+		}
+	}
+
+	return *p + (handle & (GATT_PAGE_SIZE - 1));
+}
+
+static void clear_db(struct gatt_db *db, uint16_t start, uint16_t end)
+{
+	unsigned int h = start;
+
+	while (h <= end) {
+		struct gatt_attr **p = &db->page[h >> GATT_PAGE_BITS];
+		unsigned int first = h & ~(GATT_PAGE_SIZE - 1);
+		unsigned int last = first + GATT_PAGE_SIZE - 1;
+
+		if (*p && h == first && last <= end) {
+			free(*p);
+			*p = NULL;
+		} else if (*p) {
+			unsigned int n = (last < end ? last : end) - h + 1;
+
+			memset(*p + (h - first), 0, n * sizeof(**p));
+		}
+
+		h = last + 1;
+	}
+}
+
+/* Nearest service or characteristic value above a handle */
+static uint16_t find_owner(struct gatt_db *db, uint16_t handle, int kind)
+{
+	unsigned int h = handle;
+
+	while (h > 1) {
+		struct gatt_attr *a, *s;
+
+		h--;
+
+		if (!db->page[h >> GATT_PAGE_BITS]) {
+			h &= ~(GATT_PAGE_SIZE - 1);
+			continue;
+		}
+
+		a = lookup(db, h);
+		if (!a)
+			continue;
+
+		if (a->kind == kind)
+			return kind != GATT_SERVICE || a->end >= handle ? h : 0;
+
+		if (kind == GATT_SERVICE) {
+			if (a->kind != GATT_CHARAC || !a->owner)
+				continue;
+
+			/* The characteristic before knows it already */
+			s = lookup(db, a->owner);
+			return s && s->end >= handle ? a->owner : 0;
+		}
+
+		/* A descriptor follows the value of its characteristic */
+		if (a->kind == GATT_SERVICE || a->kind == GATT_CHARAC)
+			return 0;
+	}
+
+	return 0;
+}
+
+static void add_service(struct gatt_db *db, uint16_t start, uint16_t end,
+						const struct gatt_uuid *uuid)
+{
+	struct gatt_attr *a;
+	unsigned int h;
+
+	if (!start || start > end)
+		return;
+
+	a = insert(db, start);
+	a->kind  = GATT_SERVICE;
+	a->uuid  = *uuid;
+	a->end   = end;
+	a->owner = 0;
+
+	/* Characteristics that were discovered first */
+	for (h = start + 1; h <= end; h++) {
+		if (!db->page[h >> GATT_PAGE_BITS]) {
+			h |= GATT_PAGE_SIZE - 1;
+			continue;
+		}
+
+		a = lookup(db, h);
+		if (a && a->kind == GATT_CHARAC)
+			a->owner = start;
+	}
+}
+
+static void add_charac(struct gatt_db *db, uint16_t handle, uint8_t props,
+				uint16_t value, const struct gatt_uuid *uuid)
+{
+	struct gatt_attr *a = insert(db, handle);
+
+	a->kind  = GATT_CHARAC;
+	a->props = props;
+	a->uuid  = *uuid;
+	a->owner = find_owner(db, handle, GATT_SERVICE);
+
+	if (value <= handle)
+		return;
+
+	a = insert(db, value);
+	a->kind  = GATT_VALUE;
+	a->props = props;
+	a->uuid  = *uuid;
+	a->owner = handle;
+}
+
+static void add_desc(struct gatt_db *db, uint16_t handle,
+						const struct gatt_uuid *uuid)
+{
+	struct gatt_attr *a;
+	uint16_t type = uuid16(uuid);
+
+	/* Declarations show up with their type, they are known already */
+	if (lookup(db, handle) || type == GATT_PRIM_SVC_UUID ||
+				type == GATT_SND_SVC_UUID ||
+				type == GATT_INCLUDE_UUID ||
+				type == GATT_CHARAC_UUID)
+		return;
+
+	a = insert(db, handle);
+	a->kind  = GATT_DESC;
+	a->uuid  = *uuid;
+	a->owner = find_owner(db, handle, GATT_VALUE);
+}
+
+static struct gatt_db *find_db(const struct gatt_conn *c)
+{
+	struct gatt_db *db;
+	int i;
+
+	for (i = 0; i < GATT_DBS; i++) {
+		db = &dbs[i];
+
+		if (!db->used || db->slot != c->slot || db->known != c->known)
+			continue;
+
+		if (c->known ? !bacmp(&db->bdaddr, &c->bdaddr) :
+						db->handle == c->handle)
+			return db;
+	}
+
+	return NULL;
+}
+
+static struct gatt_db *get_db(const struct gatt_conn *c)
+{
+	struct gatt_db *db = find_db(c);
+	int i;
+
+	if (db)
+		return db;
+
+	/* Evict in turn, connections still using it forget it */
+	db = &dbs[db_next];
+	db_next = (db_next + 1) % GATT_DBS;
+
+	if (db->used) {
+		for (i = 0; i < GATT_CONNS; i++)
+			if (conns[i].remote == db)
+				conns[i].remote = NULL;
+		clear_db(db, 0x0000, 0xffff);
+	}
+
+	db->used   = 1;
+	db->slot   = c->slot;
+	db->known  = c->known;
+	db->handle = c->handle;
+	bacpy(&db->bdaddr, &c->bdaddr);
+
+	return db;
+}
+
+static struct gatt_conn *find_conn(uint8_t slot, uint16_t handle)
+{
+	int i;
+
+	for (i = 0; i < GATT_CONNS; i++)
+		if (conns[i].used && conns[i].slot == slot &&
+						conns[i].handle == handle)
+			return &conns[i];
+
+	return NULL;
+}
+
+/* Handles are reused, so check that the peer is still the same */
+static struct gatt_conn *get_conn(struct frame *frm)
+{
+	struct gatt_conn *c = find_conn(parser.slot, frm->handle);
+	struct conn_info *ci = conn_get(frm->handle);
+
+	if (c && (!ci || (c->known && !bacmp(&c->bdaddr, &ci->bdaddr))))
+		return c;
+
+	if (!c) {
+		c = &conns[conn_next];
+		conn_next = (conn_next + 1) % GATT_CONNS;
+	}
+
+	memset(c, 0, sizeof(*c));
+	c->used   = 1;
+	c->slot   = parser.slot;
+	c->handle = frm->handle;
+
+	if (ci) {
+		c->known = 1;
+		bacpy(&c->bdaddr, &ci->bdaddr);
+	}
+
+	/* What was learned on an earlier connection */
+	c->remote = find_db(c);
+
+	return c;
+}
+
+/* The database of the server, whichever side that is */
+static struct gatt_db *server_db(struct gatt_conn *c, int remote)
+{
+	if (!remote) {
+		local_dbs[c->slot].used = 1;
+		return &local_dbs[c->slot];
+	}
+
+	if (!c->remote)
+		c->remote = get_db(c);
+
+	return c->remote;
+}
+
+static void read_by_group_resp(struct gatt_db *db, struct gatt_pending *p,
+					const uint8_t *data, int len)
+{
+	struct gatt_uuid uuid;
+	int size;
+
+	/* Only services are grouping attributes */
+	if (len < 1 || (p->opcode == ATT_OP_READ_BY_GROUP_REQ &&
+				p->type != GATT_PRIM_SVC_UUID &&
+				p->type != GATT_SND_SVC_UUID))
+		return;
+
+	size = data[0];
+	data++;
+	len--;
+
+	if (size < 6)
+		return;
+
+	for (; len >= size; data += size, len -= size) {
+		set_uuid(&uuid, data + 4, size - 4);
+		if (uuid.len)
+			add_service(db, get_le16(data), get_le16(data + 2),
+									&uuid);
+	}
+}
+
+static void find_by_type_resp(struct gatt_db *db, struct gatt_pending *p,
+					const uint8_t *data, int len)
+{
+	if (p->opcode != ATT_OP_FIND_BY_TYPE_REQ || !p->value.len ||
+				(p->type != GATT_PRIM_SVC_UUID &&
+				p->type != GATT_SND_SVC_UUID))
+		return;
+
+	for (; len >= 4; data += 4, len -= 4)
+		add_service(db, get_le16(data), get_le16(data + 2), &p->value);
+}
+
+static void read_by_type_resp(struct gatt_db *db, struct gatt_pending *p,
+					const uint8_t *data, int len)
+{
+	struct gatt_uuid uuid;
+	int size;
+
+	if (len < 1 || p->opcode != ATT_OP_READ_BY_TYPE_REQ || !p->type)
+		return;
+
+	size = data[0];
+	data++;
+	len--;
+
+	if (size < 2)
+		return;
+
+	for (; len >= size; data += size, len -= size) {
+		uint16_t handle = get_le16(data);
+		struct gatt_attr *a;
+
+		switch (p->type) {
+		case GATT_CHARAC_UUID:
+			if (size < 7)
+				return;
+			set_uuid(&uuid, data + 5, size - 5);
+			if (uuid.len)
+				add_charac(db, handle, data[2],
+						get_le16(data + 3), &uuid);
+			break;
+
+		case GATT_PRIM_SVC_UUID:
+		case GATT_SND_SVC_UUID:
+		case GATT_INCLUDE_UUID:
+			break;
+
+		default:
+			/* Reading a characteristic by its type names it */
+			if (lookup(db, handle))
+				break;
+			a = insert(db, handle);
+			a->kind = GATT_VALUE;
+			a->uuid.len = 2;
+			a->uuid.val[0] = p->type & 0xff;
+			a->uuid.val[1] = p->type >> 8;
+			break;
+		}
+	}
+}
+
+static void find_info_resp(struct gatt_db *db, const uint8_t *data, int len)
+{
+	struct gatt_uuid uuid;
+	int size;
+
+	if (len < 1)
+		return;
+
+	size = data[0] == 0x01 ? 4 : 18;
+	data++;
+	len--;
+
+	for (; len >= size; data += size, len -= size) {
+		set_uuid(&uuid, data + 2, size - 2);
+		add_desc(db, get_le16(data), &uuid);
+	}
+}
+
+/* Service Changed drops what was learned about the range */
+static void indication(struct gatt_db *db, const uint8_t *data, int len)
+{
+	struct gatt_attr *a;
+	uint16_t start, end;
+
+	if (len < 6)
+		return;
+
+	a = lookup(db, get_le16(data));
+	if (!a || a->kind != GATT_VALUE ||
+				uuid16(&a->uuid) != GATT_SERVICE_CHANGED)
+		return;
+
+	start = get_le16(data + 2);
+	end = get_le16(data + 4);
+
+	if (start <= end)
+		clear_db(db, start, end);
+}
+
+/*
+ * Called for every ATT packet that is decoded, with or without an option,
+ * since the names show up in the normal output. That bookkeeping is meant
+ * to be always on. The databases are kept for the whole run on purpose,
+ * a device keeps its handles across reconnections; at most GATT_DBS peers
+ * are remembered and the oldest one makes room for the next.
+ */
+void gatt_frame(struct frame *frm)
+{
+	const uint8_t *data = frm->ptr;
+	int len = frm->len;
+	struct gatt_conn *c;
+	struct gatt_pending *p;
+	uint8_t op;
+
+	if (len < 1)
+		return;
+
+	/* Names are looked up through the connection */
+	c = get_conn(frm);
+
+	op = data[0];
+	data++;
+	len--;
+
+	switch (op) {
+	case ATT_OP_FIND_BY_TYPE_REQ:
+	case ATT_OP_READ_BY_TYPE_REQ:
+	case ATT_OP_READ_BY_GROUP_REQ:
+		p = &c->pending[frm->in];
+		memset(p, 0, sizeof(*p));
+		p->opcode = op;
+
+		if (op == ATT_OP_FIND_BY_TYPE_REQ) {
+			if (len < 6)
+				break;
+			p->type = get_le16(data + 4);
+			set_uuid(&p->value, data + 6, len - 6);
+		} else if (len > 4) {
+			struct gatt_uuid type;
+
+			set_uuid(&type, data + 4, len - 4);
+			p->type = uuid16(&type);
+		}
+		break;
+
+	case ATT_OP_FIND_INFO_RESP:
+		find_info_resp(server_db(c, frm->in), data, len);
+		break;
+
+	case ATT_OP_FIND_BY_TYPE_RESP:
+		find_by_type_resp(server_db(c, frm->in), &c->pending[!frm->in],
+								data, len);
+		break;
+
+	case ATT_OP_READ_BY_TYPE_RESP:
+		read_by_type_resp(server_db(c, frm->in), &c->pending[!frm->in],
+								data, len);
+		break;
+
+	case ATT_OP_READ_BY_GROUP_RESP:
+		read_by_group_resp(server_db(c, frm->in), &c->pending[!frm->in],
+								data, len);
+		break;
+
+	case ATT_OP_HANDLE_IND:
+		indication(server_db(c, frm->in), data, len);
+		break;
+	}
+}
+
+static int props_str(uint8_t props, char *str, size_t size)
+{
+	int i, n = 0;
+
+	for (i = 0; i < 8 && n < (int) size; i++)
+		if (props & (1 << i))
+			n += snprintf(str + n, size - n, "%s%s", n ? " " : "",
+							props_names[i]);
+
+	return n;
+}
+
+/*
+ * Name of an attribute of the connection, or NULL if its discovery
+ * wasn't seen. Remote is set for the database of the peer, otherwise
+ * our own is used. The string is overwritten by the next call.
+ */
+const char *gatt_name(uint8_t slot, uint16_t handle, uint16_t attr,
+								int remote)
+{
+	static char str[160];
+	char owner[64], name[64];
+	struct gatt_conn *c;
+	struct gatt_db *db;
+	struct gatt_attr *a, *o;
+
+	if (remote) {
+		c = find_conn(slot, handle);
+		db = c ? c->remote : NULL;
+	} else
+		db = local_dbs[slot].used ? &local_dbs[slot] : NULL;
+
+	if (!db)
+		return NULL;
+
+	a = lookup(db, attr);
+	if (!a)
+		return NULL;
+
+	uuid_str(&a->uuid, name, sizeof(name));
+	o = a->owner ? lookup(db, a->owner) : NULL;
+
+	switch (a->kind) {
+	case GATT_SERVICE:
+		snprintf(str, sizeof(str), "%s service", name);
+		break;
+
+	case GATT_CHARAC:
+		if (props_str(a->props, owner, sizeof(owner)))
+			snprintf(str, sizeof(str), "%s declaration, %s",
+								name, owner);
+		else
+			snprintf(str, sizeof(str), "%s declaration", name);
+		break;
+
+	case GATT_VALUE:
+		/* The service is found through the declaration */
+		if (o && o->owner)
+			o = lookup(db, o->owner);
+		else
+			o = NULL;
+
+		if (o)
+			snprintf(str, sizeof(str), "%s: %s",
+				uuid_str(&o->uuid, owner, sizeof(owner)), name);
+		else
+			snprintf(str, sizeof(str), "%s", name);
+		break;
+
+	case GATT_DESC:
+		if (o)
+			snprintf(str, sizeof(str), "%s: %s",
+				uuid_str(&o->uuid, owner, sizeof(owner)), name);
+		else
+			snprintf(str, sizeof(str), "%s", name);
+		break;
+	}
+
+	return str;
+}
@@ -43,11 +43,15 @@
 
 #include "parser.h"
 
-static uint16_t manufacturer = DEFAULT_COMPID;
+static uint16_t manufacturer[DEVICE_SLOTS] = {
+	[0 ... DEVICE_SLOTS - 1] = DEFAULT_COMPID
+};
 
 static inline uint16_t get_manufacturer(void)
 {
-	return (manufacturer == DEFAULT_COMPID ? parser.defcompid : manufacturer);
+	uint16_t compid = manufacturer[parser.slot];
+
+	return (compid == DEFAULT_COMPID ? parser.defcompid : compid);
 }
 
 #define EVENT_NUM 76
@@ -558,6 +562,11 @@ static char *opcode2str(uint16_t opcode)
 	return cmd;
 }
 
+char *hci_cmd2str(uint16_t opcode)
+{
+	return opcode2str(opcode);
+}
+
 static char *linktype2str(uint8_t type)
 {
 	switch (type) {
@@ -3473,6 +3482,27 @@ static inline void extended_inq_result_dump(int level, struct frame *frm)
 		frm->ptr += INQUIRY_INFO_WITH_RSSI_SIZE;
 		frm->len -= INQUIRY_INFO_WITH_RSSI_SIZE;
 
+		if (parser.flags & DUMP_INQ) {
+			struct inq_entry *e = inq_get(&info->bdaddr);
+
+			/* Decoding the EIR is most of the work */
+			if (e && e->decoded && e->eir_decoded == e->eir_hash) {
+				p_indent(level, frm);
+				printf("EIR unchanged, seen %u times\n", e->count);
+
+				frm->ptr += EXTENDED_INQUIRY_INFO_SIZE -
+						INQUIRY_INFO_WITH_RSSI_SIZE;
+				frm->len -= EXTENDED_INQUIRY_INFO_SIZE -
+						INQUIRY_INFO_WITH_RSSI_SIZE;
+				continue;
+			}
+
+			if (e) {
+				e->eir_decoded = e->eir_hash;
+				e->decoded = 1;
+			}
+		}
+
 		ext_inquiry_response_dump(level, frm);
 	}
 }
@@ -3560,7 +3590,24 @@ static inline void evt_le_advertising_report_dump(int level, struct frame *frm)
 		frm->len -= LE_ADVERTISING_INFO_SIZE + info->length;
 
 		p_indent(level, frm);
-		printf("RSSI: %d\n", ((int8_t *) frm->ptr)[frm->len - 1]);
+		printf("RSSI: %d\n", *(int8_t *) frm->ptr);
+
+		if (parser.flags & DUMP_ADV) {
+			struct adv_stats *s = adv_get(&info->bdaddr,
+					info->bdaddr_type, info->evt_type);
+
+			if (s && s->rssi_count) {
+				p_indent(level, frm);
+				printf("seen %u times, RSSI min %d avg %d max %d\n",
+					s->count, s->rssi_min,
+					(int) (s->rssi_sum /
+						(int64_t) s->rssi_count),
+					s->rssi_max);
+			} else if (s) {
+				p_indent(level, frm);
+				printf("seen %u times, no RSSI\n", s->count);
+			}
+		}
 
 		frm->ptr += RSSI_SIZE;
 		frm->len -= RSSI_SIZE;
@@ -3712,6 +3759,19 @@ static inline void event_dump(int level, struct frame *frm)
 	hci_event_hdr *hdr = frm->ptr;
 	uint8_t event = hdr->evt;
 
+	/* Connection state has to follow even when events aren't shown */
+	if (event == EVT_DISCONN_COMPLETE) {
+		evt_disconn_complete *evt = frm->ptr + HCI_EVENT_HDR_SIZE;
+		l2cap_clear(btohs(evt->handle));
+		if (parser.flags & (DUMP_A2DP | DUMP_MEDIA))
+			a2dp_disconnect(btohs(evt->handle));
+		if ((parser.flags & DUMP_ATT) && !evt->status)
+			att_stats_disconnect(btohs(evt->handle));
+	}
+
+	conn_update(event, frm->ptr + HCI_EVENT_HDR_SIZE,
+					frm->len - HCI_EVENT_HDR_SIZE);
+
 	if (p_filter(FILT_HCI))
 		return;
 
@@ -3759,15 +3819,10 @@ static inline void event_dump(int level, struct frame *frm)
 		evt_cmd_complete *cc = frm->ptr;
 		if (cc->opcode == cmd_opcode_pack(OGF_INFO_PARAM, OCF_READ_LOCAL_VERSION)) {
 			read_local_version_rp *rp = frm->ptr + EVT_CMD_COMPLETE_SIZE;
-			manufacturer = rp->manufacturer;
+			manufacturer[parser.slot] = rp->manufacturer;
 		}
 	}
 
-	if (event == EVT_DISCONN_COMPLETE) {
-		evt_disconn_complete *evt = frm->ptr;
-		l2cap_clear(btohs(evt->handle));
-	}
-
 	if (!(parser.flags & DUMP_VERBOSE)) {
 		raw_dump(level, frm);
 		return;
@@ -3946,10 +4001,19 @@ static inline void acl_dump(int level, struct frame *frm)
 	uint16_t dlen = btohs(hdr->dlen);
 	uint8_t flags = acl_flags(handle);
 
+	/* Dropped before any reassembly state is touched */
+	if (p_conn_filter(acl_handle(handle)))
+		return;
+
 	if (!p_filter(FILT_HCI)) {
+		struct conn_info *c = conn_get(acl_handle(handle));
+
 		p_indent(level, frm);
-		printf("ACL data: handle %d flags 0x%2.2x dlen %d\n",
+		printf("ACL data: handle %d flags 0x%2.2x dlen %d",
 			acl_handle(handle), flags, dlen);
+		if (c)
+			printf(" [%s]", c->addr);
+		printf("\n");
 		level++;
 	}
 
@@ -3959,25 +4023,45 @@ static inline void acl_dump(int level, struct frame *frm)
 	frm->handle = acl_handle(handle);
 
 	if (parser.filter & ~FILT_HCI)
-		l2cap_dump(level, frm);
+		PROF_CALL(PROF_L2CAP, l2cap_dump(level, frm));
 	else
 		raw_dump(level, frm);
 }
 
+/* Raw SCO payload for -A, from both the text and the structured output */
+static void sco_audio(struct frame *frm)
+{
+	hci_sco_hdr *hdr = (void *) frm->ptr;
+
+	if (frm->audio_fd <= fileno(stderr))
+		return;
+
+	if (write(frm->audio_fd, frm->ptr + HCI_SCO_HDR_SIZE, hdr->dlen) < 0) {
+		perror("Can't write audio");
+		parser.audio_fd = -1;
+	}
+}
+
 static inline void sco_dump(int level, struct frame *frm)
 {
 	hci_sco_hdr *hdr = (void *) frm->ptr;
 	uint16_t handle = btohs(hdr->handle);
 	uint8_t flags = acl_flags(handle);
-	int len;
 
-	if (frm->audio_fd > fileno(stderr))
-		len = write(frm->audio_fd, frm->ptr + HCI_SCO_HDR_SIZE, hdr->dlen);
+	if (p_conn_filter(acl_handle(handle)))
+		return;
+
+	sco_audio(frm);
 
 	if (!p_filter(FILT_SCO)) {
+		struct conn_info *c = conn_get(acl_handle(handle));
+
 		p_indent(level, frm);
-		printf("SCO data: handle %d flags 0x%2.2x dlen %d\n",
+		printf("SCO data: handle %d flags 0x%2.2x dlen %d",
 				acl_handle(handle), flags, hdr->dlen);
+		if (c)
+			printf(" [%s]", c->addr);
+		printf("\n");
 		level++;
 
 		frm->ptr += HCI_SCO_HDR_SIZE;
@@ -4019,12 +4103,299 @@ static inline void vendor_dump(int level, struct frame *frm)
 	raw_dump(level, frm);
 }
 
+static inline void command_fields(struct frame *frm)
+{
+	hci_command_hdr *hdr = frm->ptr;
+	uint16_t opcode = btohs(hdr->opcode);
+	uint16_t ogf = cmd_opcode_ogf(opcode);
+
+	if (ogf == OGF_VENDOR_CMD && (parser.flags & DUMP_NOVENDOR))
+		return;
+
+	f_layer("hci");
+	f_str("type", "command");
+	f_u16("opcode", opcode);
+	f_u8("ogf", ogf);
+	f_u16("ocf", cmd_opcode_ocf(opcode));
+	f_str("name", opcode2str(opcode));
+	f_u8("plen", hdr->plen);
+}
+
+static inline void event_fields(struct frame *frm)
+{
+	hci_event_hdr *hdr = frm->ptr;
+	uint8_t event = hdr->evt;
+	void *ptr = frm->ptr + HCI_EVENT_HDR_SIZE;
+	uint32_t len = frm->len - HCI_EVENT_HDR_SIZE;
+
+	/* Keep the decoder state current even when not shown */
+	if (event == EVT_CMD_COMPLETE && len >= EVT_CMD_COMPLETE_SIZE +
+					sizeof(read_local_version_rp)) {
+		evt_cmd_complete *cc = ptr;
+		if (cc->opcode == cmd_opcode_pack(OGF_INFO_PARAM, OCF_READ_LOCAL_VERSION)) {
+			read_local_version_rp *rp = ptr + EVT_CMD_COMPLETE_SIZE;
+			manufacturer[parser.slot] = rp->manufacturer;
+		}
+	}
+
+	if (event == EVT_DISCONN_COMPLETE && len >= EVT_DISCONN_COMPLETE_SIZE) {
+		evt_disconn_complete *evt = ptr;
+		l2cap_clear(btohs(evt->handle));
+		if (parser.flags & (DUMP_A2DP | DUMP_MEDIA))
+			a2dp_disconnect(btohs(evt->handle));
+		if ((parser.flags & DUMP_ATT) && !evt->status)
+			att_stats_disconnect(btohs(evt->handle));
+	}
+
+	conn_update(event, ptr, len);
+
+	if (p_filter(FILT_HCI))
+		return;
+
+	if (event == EVT_VENDOR && (parser.flags & DUMP_NOVENDOR))
+		return;
+
+	f_layer("hci");
+	f_str("type", "event");
+	f_u8("event", event);
+	if (event <= EVENT_NUM)
+		f_str("name", event_str[event]);
+	else if (event == EVT_TESTING)
+		f_str("name", "Testing");
+	else if (event == EVT_VENDOR)
+		f_str("name", "Vendor");
+	f_u8("plen", hdr->plen);
+
+	switch (event) {
+	case EVT_CMD_COMPLETE:
+		if (len >= EVT_CMD_COMPLETE_SIZE) {
+			evt_cmd_complete *evt = ptr;
+			uint16_t opcode = btohs(evt->opcode);
+
+			f_u8("ncmd", evt->ncmd);
+			f_u16("opcode", opcode);
+			f_str("command", opcode2str(opcode));
+			if (len > EVT_CMD_COMPLETE_SIZE)
+				f_u8("status", *((uint8_t *) ptr +
+						EVT_CMD_COMPLETE_SIZE));
+		}
+		break;
+	case EVT_CMD_STATUS:
+		if (len >= EVT_CMD_STATUS_SIZE) {
+			evt_cmd_status *evt = ptr;
+			uint16_t opcode = btohs(evt->opcode);
+
+			f_u8("status", evt->status);
+			f_u8("ncmd", evt->ncmd);
+			f_u16("opcode", opcode);
+			f_str("command", opcode2str(opcode));
+		}
+		break;
+	case EVT_CONN_COMPLETE:
+		if (len >= EVT_CONN_COMPLETE_SIZE) {
+			evt_conn_complete *evt = ptr;
+
+			f_u8("status", evt->status);
+			f_u16("handle", btohs(evt->handle));
+			f_bdaddr("bdaddr", &evt->bdaddr);
+			f_u8("link_type", evt->link_type);
+		}
+		break;
+	case EVT_CONN_REQUEST:
+		if (len >= EVT_CONN_REQUEST_SIZE) {
+			evt_conn_request *evt = ptr;
+
+			f_bdaddr("bdaddr", &evt->bdaddr);
+			f_u8("link_type", evt->link_type);
+		}
+		break;
+	case EVT_DISCONN_COMPLETE:
+		if (len >= EVT_DISCONN_COMPLETE_SIZE) {
+			evt_disconn_complete *evt = ptr;
+
+			f_u8("status", evt->status);
+			f_u16("handle", btohs(evt->handle));
+			f_u8("reason", evt->reason);
+		}
+		break;
+	case EVT_SYNC_CONN_COMPLETE:
+		if (len >= EVT_SYNC_CONN_COMPLETE_SIZE) {
+			evt_sync_conn_complete *evt = ptr;
+
+			f_u8("status", evt->status);
+			f_u16("handle", btohs(evt->handle));
+			f_bdaddr("bdaddr", &evt->bdaddr);
+			f_u8("link_type", evt->link_type);
+		}
+		break;
+	case EVT_AUTH_COMPLETE:
+	case EVT_CHANGE_CONN_LINK_KEY_COMPLETE:
+	case EVT_ENCRYPT_CHANGE:
+	case EVT_READ_REMOTE_FEATURES_COMPLETE:
+	case EVT_READ_REMOTE_VERSION_COMPLETE:
+	case EVT_MODE_CHANGE:
+		/* All of these start with status and handle */
+		if (len >= 3) {
+			f_u8("status", *(uint8_t *) ptr);
+			f_u16("handle", btohs(bt_get_unaligned(
+						(uint16_t *) (ptr + 1))));
+		}
+		break;
+	case EVT_REMOTE_NAME_REQ_COMPLETE:
+		if (len >= EVT_REMOTE_NAME_REQ_COMPLETE_SIZE) {
+			evt_remote_name_req_complete *evt = ptr;
+			char name[249];
+
+			memcpy(name, evt->name, 248);
+			name[248] = '\0';
+
+			f_u8("status", evt->status);
+			f_bdaddr("bdaddr", &evt->bdaddr);
+			f_str("remote_name", name);
+		}
+		break;
+	case EVT_ROLE_CHANGE:
+		if (len >= EVT_ROLE_CHANGE_SIZE) {
+			evt_role_change *evt = ptr;
+
+			f_u8("status", evt->status);
+			f_bdaddr("bdaddr", &evt->bdaddr);
+			f_u8("role", evt->role);
+		}
+		break;
+	case EVT_NUM_COMP_PKTS:
+		if (len >= 1)
+			f_u8("num_handles", *(uint8_t *) ptr);
+		break;
+	case EVT_LE_META_EVENT:
+		if (len >= 1) {
+			evt_le_meta_event *evt = ptr;
+
+			f_u8("subevent", evt->subevent);
+			if (evt->subevent == EVT_LE_CONN_COMPLETE &&
+				len >= 1 + EVT_LE_CONN_COMPLETE_SIZE) {
+				evt_le_connection_complete *cc = (void *) evt->data;
+
+				f_u8("status", cc->status);
+				f_u16("handle", btohs(cc->handle));
+				f_bdaddr("bdaddr", &cc->peer_bdaddr);
+			}
+		}
+		break;
+	}
+}
+
+/* What is known about the device behind a handle */
+static inline void conn_fields(uint16_t handle)
+{
+	struct conn_info *c = conn_get(handle);
+
+	if (!c)
+		return;
+
+	f_bdaddr("bdaddr", &c->bdaddr);
+	if (c->name[0])
+		f_str("remote_name", c->name);
+}
+
+static inline void acl_fields(struct frame *frm)
+{
+	hci_acl_hdr *hdr = (void *) frm->ptr;
+	uint16_t handle = btohs(hdr->handle);
+
+	if (p_conn_filter(acl_handle(handle)))
+		return;
+
+	if (!p_filter(FILT_HCI)) {
+		f_layer("hci");
+		f_str("type", "acl");
+		f_u16("handle", acl_handle(handle));
+		f_u8("flags", acl_flags(handle));
+		f_u16("dlen", btohs(hdr->dlen));
+		conn_fields(acl_handle(handle));
+	}
+
+	frm->ptr += HCI_ACL_HDR_SIZE;
+	frm->len -= HCI_ACL_HDR_SIZE;
+	frm->flags  = acl_flags(handle);
+	frm->handle = acl_handle(handle);
+
+	if (parser.filter & ~FILT_HCI)
+		PROF_CALL(PROF_L2CAP, l2cap_dump(0, frm));
+}
+
+static inline void sco_fields(struct frame *frm)
+{
+	hci_sco_hdr *hdr = (void *) frm->ptr;
+	uint16_t handle = btohs(hdr->handle);
+
+	if (p_conn_filter(acl_handle(handle)))
+		return;
+
+	sco_audio(frm);
+
+	if (p_filter(FILT_SCO))
+		return;
+
+	f_layer("hci");
+	f_str("type", "sco");
+	f_u16("handle", acl_handle(handle));
+	f_u8("flags", acl_flags(handle));
+	f_u8("dlen", hdr->dlen);
+	conn_fields(acl_handle(handle));
+}
+
+/* Fields reported by the structured output */
+const char *hci_field_names[] = {
+	"type", "opcode", "ogf", "ocf", "name", "plen", "event",
+	"ncmd", "command", "status", "handle", "bdaddr", "link_type",
+	"reason", "remote_name", "role", "num_handles", "subevent",
+	"flags", "dlen", "packet_type", NULL
+};
+
+/* Structured counterpart of hci_dump() */
+static void hci_fields(uint8_t type, struct frame *frm)
+{
+	switch (type) {
+	case HCI_COMMAND_PKT:
+		if (!p_filter(FILT_HCI))
+			command_fields(frm);
+		break;
+
+	case HCI_EVENT_PKT:
+		event_fields(frm);
+		break;
+
+	case HCI_ACLDATA_PKT:
+		acl_fields(frm);
+		break;
+
+	case HCI_SCODATA_PKT:
+		sco_fields(frm);
+		break;
+
+	default:
+		if (p_filter(FILT_HCI))
+			break;
+
+		f_layer("hci");
+		f_str("type", type == HCI_VENDOR_PKT ? "vendor" : "unknown");
+		f_u8("packet_type", type);
+		break;
+	}
+}
+
 void hci_dump(int level, struct frame *frm)
 {
 	uint8_t type = *(uint8_t *)frm->ptr;
 
 	frm->ptr++; frm->len--;
 
+	if (parser.sink) {
+		hci_fields(type, frm);
+		return;
+	}
+
 	switch (type) {
 	case HCI_COMMAND_PKT:
 		command_dump(level, frm);
@@ -89,6 +89,17 @@ void hcrp_dump(int level, struct frame *frm)
 	tid = get_u16(frm);
 	plen = get_u16(frm);
 
+	if (parser.sink) {
+		f_layer("hcrp");
+		f_u16("pdu", pid);
+		f_str("name", pid2str(pid));
+		f_u16("tid", tid);
+		f_u16("plen", plen);
+		if (frm->in && frm->len >= 2)
+			f_u16("status", get_u16(frm));
+		return;
+	}
+
 	p_indent(level, frm);
 
 	printf("HCRP %s %s: tid 0x%x plen %d",
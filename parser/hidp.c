@@ -163,6 +163,15 @@ void hidp_dump(int level, struct frame *frm)
 		break;
 	}
 
+	if (parser.sink) {
+		f_layer("hidp");
+		f_u8("hdr", hdr);
+		f_str("type", type2str(hdr));
+		f_str("param", param);
+		f_u16("plen", frm->len);
+		return;
+	}
+
 	p_indent(level, frm);
 
 	printf("HIDP: %s: %s\n", type2str(hdr), param);
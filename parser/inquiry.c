@@ -0,0 +1,324 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+
+#include "parser.h"
+
+#define INQ_SLOTS	1024
+#define INQ_PROBE	16
+
+static struct inq_entry inq_table[INQ_SLOTS];
+
+static uint64_t interval;	/* Minimum time between repeats in usec */
+static unsigned long inq_responses = 0;
+static unsigned long inq_dropped = 0;
+static unsigned long inq_evicted = 0;
+
+void inq_init(int msec)
+{
+	interval = (msec > 0 ? msec : 10000) * 1000ull;
+}
+
+static inline unsigned int inq_hash(const bdaddr_t *ba)
+{
+	const uint8_t *b = (const uint8_t *) ba;
+	unsigned int h = 2166136261u;
+	int i;
+
+	for (i = 0; i < 6; i++)
+		h = (h ^ b[i]) * 16777619;
+
+	return (h ^ parser.slot) * 16777619;
+}
+
+/* Only the significant part, the rest of the 240 bytes is padding */
+static uint32_t eir_hash(const uint8_t *data, int len)
+{
+	uint32_t h = 2166136261u;
+	int i = 0;
+
+	while (i < len && data[i])
+		i += data[i] + 1;
+
+	if (i > len)
+		i = len;
+
+	while (i-- > 0)
+		h = (h ^ *data++) * 16777619;
+
+	return h;
+}
+
+struct inq_entry *inq_get(const bdaddr_t *ba)
+{
+	unsigned int h = inq_hash(ba);
+	int i;
+
+	for (i = 0; i < INQ_PROBE; i++) {
+		struct inq_entry *e = &inq_table[(h + i) % INQ_SLOTS];
+
+		if (!e->used)
+			break;
+		if (e->slot == parser.slot && !bacmp(&e->bdaddr, ba))
+			return e;
+	}
+
+	return NULL;
+}
+
+/* A full probe window takes over the device in it seen least recently */
+static struct inq_entry *inq_add(const bdaddr_t *ba, uint64_t now)
+{
+	unsigned int h = inq_hash(ba);
+	struct inq_entry *e, *oldest = NULL;
+	int i;
+
+	for (i = 0; i < INQ_PROBE; i++) {
+		e = &inq_table[(h + i) % INQ_SLOTS];
+
+		if (!e->used) {
+			oldest = e;
+			break;
+		}
+
+		if (!oldest || e->last < oldest->last)
+			oldest = e;
+	}
+
+	if (oldest->used)
+		inq_evicted++;
+
+	memset(oldest, 0, sizeof(*oldest));
+	oldest->used = 1;
+	oldest->slot = parser.slot;
+	bacpy(&oldest->bdaddr, ba);
+	oldest->first = now;
+
+	return oldest;
+}
+
+static int inq_update(const bdaddr_t *ba, const uint8_t *dev_class, int rssi,
+				const uint8_t *eir, int eir_len, uint64_t now)
+{
+	struct inq_entry *e = inq_get(ba);
+	int show = 0;
+
+	if (!e) {
+		e = inq_add(ba, now);
+		show = 1;
+	}
+
+	if (memcmp(e->dev_class, dev_class, 3)) {
+		memcpy(e->dev_class, dev_class, 3);
+		show = 1;
+	}
+
+	if (eir) {
+		uint32_t hash = eir_hash(eir, eir_len);
+
+		if (!e->has_eir || e->eir_hash != hash) {
+			e->eir_hash = hash;
+			e->has_eir = 1;
+			e->eir_changes++;
+			show = 1;
+		}
+	}
+
+	if (rssi != INQ_NO_RSSI)
+		e->rssi = rssi;
+	e->has_rssi |= rssi != INQ_NO_RSSI;
+	e->count++;
+	e->last = now;
+
+	if (now - e->shown >= interval)
+		show = 1;
+
+	if (show)
+		e->shown = now;
+
+	inq_responses++;
+
+	return show;
+}
+
+/* Update the discovery table, true if the event has nothing new */
+int __inq_skip(struct frame *frm)
+{
+	const uint8_t *data = frm->ptr;
+	int len = frm->len, show = 0;
+	uint8_t event;
+	int i, num, size;
+	uint64_t now;
+
+	if (len < 4 || data[0] != HCI_EVENT_PKT)
+		return 0;
+
+	event = data[1];
+	now = frm->ts.tv_sec * 1000000ull + frm->ts.tv_usec;
+	num = data[3];
+	data += 4;
+	len -= 4;
+
+	if (!num)
+		return 0;
+
+	switch (event) {
+	case EVT_INQUIRY_RESULT:
+		for (i = 0; i < num && len >= INQUIRY_INFO_SIZE; i++) {
+			const inquiry_info *info = (const void *) data;
+
+			show |= inq_update(&info->bdaddr, info->dev_class,
+						INQ_NO_RSSI, NULL, 0, now);
+
+			data += INQUIRY_INFO_SIZE;
+			len -= INQUIRY_INFO_SIZE;
+		}
+		break;
+
+	case EVT_INQUIRY_RESULT_WITH_RSSI:
+		/* Same guess at the layout as the decoder */
+		size = len / num;
+		for (i = 0; i < num && len >= INQUIRY_INFO_WITH_RSSI_SIZE; i++) {
+			if (size == INQUIRY_INFO_WITH_RSSI_AND_PSCAN_MODE_SIZE) {
+				const inquiry_info_with_rssi_and_pscan_mode *info =
+								(const void *) data;
+
+				show |= inq_update(&info->bdaddr,
+						info->dev_class, info->rssi,
+						NULL, 0, now);
+
+				data += INQUIRY_INFO_WITH_RSSI_AND_PSCAN_MODE_SIZE;
+				len -= INQUIRY_INFO_WITH_RSSI_AND_PSCAN_MODE_SIZE;
+			} else {
+				const inquiry_info_with_rssi *info =
+							(const void *) data;
+
+				show |= inq_update(&info->bdaddr,
+						info->dev_class, info->rssi,
+						NULL, 0, now);
+
+				data += INQUIRY_INFO_WITH_RSSI_SIZE;
+				len -= INQUIRY_INFO_WITH_RSSI_SIZE;
+			}
+		}
+		break;
+
+	case EVT_EXTENDED_INQUIRY_RESULT:
+		for (i = 0; i < num && len >= INQUIRY_INFO_WITH_RSSI_SIZE; i++) {
+			const extended_inquiry_info *info = (const void *) data;
+			int eir_len = len - INQUIRY_INFO_WITH_RSSI_SIZE;
+
+			if (eir_len > EXTENDED_INQUIRY_INFO_SIZE -
+						INQUIRY_INFO_WITH_RSSI_SIZE)
+				eir_len = EXTENDED_INQUIRY_INFO_SIZE -
+						INQUIRY_INFO_WITH_RSSI_SIZE;
+
+			show |= inq_update(&info->bdaddr, info->dev_class,
+					info->rssi, info->data, eir_len, now);
+
+			data += EXTENDED_INQUIRY_INFO_SIZE;
+			len -= EXTENDED_INQUIRY_INFO_SIZE;
+		}
+		break;
+
+	default:
+		return 0;
+	}
+
+	if (!show) {
+		inq_dropped++;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int cmp_entry(const void *a, const void *b)
+{
+	const struct inq_entry *ea = *(struct inq_entry * const *) a;
+	const struct inq_entry *eb = *(struct inq_entry * const *) b;
+
+	if (ea->first != eb->first)
+		return ea->first < eb->first ? -1 : 1;
+
+	return memcmp(&ea->bdaddr, &eb->bdaddr, sizeof(bdaddr_t));
+}
+
+void inq_dump(FILE *out)
+{
+	struct inq_entry *list[INQ_SLOTS];
+	char addr[18], rssi[8];
+	int i, n = 0;
+
+	for (i = 0; i < INQ_SLOTS; i++)
+		if (inq_table[i].used)
+			list[n++] = &inq_table[i];
+
+	qsort(list, n, sizeof(list[0]), cmp_entry);
+
+	fprintf(out, "inquiry: %lu responses %lu events suppressed "
+			"%d devices %lu evicted\n", inq_responses,
+			inq_dropped, n, inq_evicted);
+	fprintf(out, "  %-17s %-8s %5s %7s %4s %17s %17s\n", "bdaddr",
+			"class", "rssi", "count", "eir", "first seen",
+			"last seen");
+
+	for (i = 0; i < n; i++) {
+		struct inq_entry *e = list[i];
+
+		p_ba2str(&e->bdaddr, addr);
+
+		if (e->has_rssi)
+			sprintf(rssi, "%d", e->rssi);
+		else
+			strcpy(rssi, "-");
+
+		fprintf(out, "  %-17s 0x%2.2x%2.2x%2.2x %5s %7u %4u "
+				"%10llu.%06llu %10llu.%06llu\n", addr,
+				e->dev_class[2], e->dev_class[1],
+				e->dev_class[0], rssi, e->count,
+				e->eir_changes,
+				(unsigned long long) (e->first / 1000000),
+				(unsigned long long) (e->first % 1000000),
+				(unsigned long long) (e->last / 1000000),
+				(unsigned long long) (e->last % 1000000));
+	}
+
+	fflush(out);
+}
@@ -0,0 +1,276 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "parser.h"
+
+/* One JSON object per frame, built up in a buffer that is reused */
+static char *json_buf = NULL;
+static int json_len = 0;
+static int json_size = 0;
+
+static int json_open;		/* A layer object is open */
+
+static const char hex[] = "0123456789abcdef";
+
+static void json_grow(int len)
+{
+	char *buf;
+	int size = json_size ? json_size : 1024;
+
+	while (size < json_len + len)
+		size *= 2;
+
+	buf = realloc(json_buf, size);
+	if (!buf) {
+		perror("Can't allocate JSON buffer");
+		exit(1);
+	}
+
+	json_buf = buf;
+	json_size = size;
+}
+
+static inline char *json_reserve(int len)
+{
+	if (json_len + len > json_size)
+		json_grow(len);
+
+	return json_buf + json_len;
+}
+
+static inline void json_putc(char c)
+{
+	*json_reserve(1) = c;
+	json_len++;
+}
+
+static inline void json_put(const char *str, int len)
+{
+	memcpy(json_reserve(len), str, len);
+	json_len += len;
+}
+
+static void json_uint(uint32_t val)
+{
+	char tmp[10];
+	int n = 0;
+
+	do {
+		tmp[n++] = '0' + val % 10;
+		val /= 10;
+	} while (val);
+
+	json_reserve(n);
+	while (n > 0)
+		json_buf[json_len++] = tmp[--n];
+}
+
+static void json_escape(const char *str)
+{
+	const unsigned char *s = (const unsigned char *) str;
+	char *p;
+
+	/* Worst case every byte becomes \u00XX */
+	p = json_reserve(strlen(str) * 6 + 2);
+
+	*p++ = '"';
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') {
+			*p++ = '\\';
+			*p++ = *s;
+		} else if (*s < 0x20) {
+			*p++ = '\\';
+			*p++ = 'u';
+			*p++ = '0';
+			*p++ = '0';
+			*p++ = hex[*s >> 4];
+			*p++ = hex[*s & 0x0f];
+		} else
+			*p++ = *s;
+	}
+	*p++ = '"';
+
+	json_len = p - json_buf;
+}
+
+static inline void json_key(const char *name)
+{
+	char *p;
+	int len = strlen(name);
+
+	/* Field names are plain identifiers and need no escaping */
+	p = json_reserve(len + 4);
+	if (p[-1] != '{')
+		*p++ = ',';
+	*p++ = '"';
+	memcpy(p, name, len);
+	p += len;
+	*p++ = '"';
+	*p++ = ':';
+
+	json_len = p - json_buf;
+}
+
+static void json_begin(struct frame *frm)
+{
+	char usec[6];
+	uint32_t v = frm->ts.tv_usec;
+	int i;
+
+	json_len = 0;
+	json_open = 0;
+
+	json_put("{\"ts\":", 6);
+	json_uint(frm->ts.tv_sec);
+	for (i = 5; i >= 0; i--, v /= 10)
+		usec[i] = '0' + v % 10;
+	json_putc('.');
+	json_put(usec, 6);
+
+	json_key("dev");
+	json_uint(frm->dev_id);
+	json_key("dir");
+	if (frm->in)
+		json_put("\"in\"", 4);
+	else
+		json_put("\"out\"", 5);
+	json_key("len");
+	json_uint(frm->data_len);
+}
+
+static void json_layer(const char *name)
+{
+	if (json_open)
+		json_putc('}');
+
+	json_key(name);
+	json_putc('{');
+	json_open = 1;
+}
+
+static void json_field_uint(const char *name, uint32_t val, int size)
+{
+	json_key(name);
+	json_uint(val);
+}
+
+static void json_field_str(const char *name, const char *val)
+{
+	json_key(name);
+	json_escape(val);
+}
+
+static void json_field_bdaddr(const char *name, const bdaddr_t *ba)
+{
+	char addr[18];
+
+	p_ba2str(ba, addr);
+
+	json_key(name);
+	json_putc('"');
+	json_put(addr, strlen(addr));
+	json_putc('"');
+}
+
+static void json_field_uuid(const char *name, const void *uuid, int size)
+{
+	const unsigned char *u = uuid;
+	char *p;
+	int i;
+
+	json_key(name);
+
+	p = json_reserve(40);
+	*p++ = '"';
+	if (size == 16) {
+		for (i = 0; i < 16; i++) {
+			if (i == 4 || i == 6 || i == 8 || i == 10)
+				*p++ = '-';
+			*p++ = hex[u[i] >> 4];
+			*p++ = hex[u[i] & 0x0f];
+		}
+	} else {
+		*p++ = '0';
+		*p++ = 'x';
+		for (i = 0; i < size; i++) {
+			*p++ = hex[u[i] >> 4];
+			*p++ = hex[u[i] & 0x0f];
+		}
+	}
+	*p++ = '"';
+
+	json_len = p - json_buf;
+}
+
+static void json_field_bytes(const char *name, const void *data, int len)
+{
+	const unsigned char *d = data;
+	char *p;
+	int i;
+
+	json_key(name);
+
+	p = json_reserve(len * 2 + 2);
+	*p++ = '"';
+	for (i = 0; i < len; i++) {
+		*p++ = hex[d[i] >> 4];
+		*p++ = hex[d[i] & 0x0f];
+	}
+	*p++ = '"';
+
+	json_len = p - json_buf;
+}
+
+static void json_end(struct frame *frm)
+{
+	if (json_open)
+		json_putc('}');
+	json_putc('}');
+	json_putc('\n');
+
+	PROF_CALL(PROF_OUTPUT, fwrite(json_buf, 1, json_len, stdout));
+}
+
+struct field_sink json_sink = {
+	.begin	= json_begin,
+	.layer	= json_layer,
+	.uint	= json_field_uint,
+	.str	= json_field_str,
+	.bdaddr	= json_field_bdaddr,
+	.uuid	= json_field_uuid,
+	.bytes	= json_field_bytes,
+	.end	= json_end,
+};
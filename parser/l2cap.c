@@ -49,7 +49,7 @@ typedef struct {
 } handle_info;
 #define HANDLE_TABLE_SIZE 10
 
-static handle_info handle_table[HANDLE_TABLE_SIZE];
+static handle_info handle_table[DEVICE_SLOTS][HANDLE_TABLE_SIZE];
 
 typedef struct {
 	uint16_t handle;
@@ -60,14 +60,14 @@ typedef struct {
 } cid_info;
 #define CID_TABLE_SIZE 20
 
-static cid_info cid_table[2][CID_TABLE_SIZE];
+static cid_info cid_table[DEVICE_SLOTS][2][CID_TABLE_SIZE];
 
-#define SCID cid_table[0]
-#define DCID cid_table[1]
+#define SCID cid_table[parser.slot][0]
+#define DCID cid_table[parser.slot][1]
 
 static struct frame *add_handle(uint16_t handle)
 {
-	register handle_info *t = handle_table;
+	register handle_info *t = handle_table[parser.slot];
 	register int i;
 
 	for (i = 0; i < HANDLE_TABLE_SIZE; i++)
@@ -80,7 +80,7 @@ static struct frame *add_handle(uint16_t handle)
 
 static struct frame *get_frame(uint16_t handle)
 {
-	register handle_info *t = handle_table;
+	register handle_info *t = handle_table[parser.slot];
 	register int i;
 
 	for (i = 0; i < HANDLE_TABLE_SIZE; i++)
@@ -92,7 +92,7 @@ static struct frame *get_frame(uint16_t handle)
 
 static void add_cid(int in, uint16_t handle, uint16_t cid, uint16_t psm)
 {
-	register cid_info *table = cid_table[in];
+	register cid_info *table = cid_table[parser.slot][in];
 	register int i, pos = -1;
 	uint16_t num = 1;
 
@@ -127,12 +127,18 @@ static void del_cid(int in, uint16_t dcid, uint16_t scid)
 
 	for (t = 0; t < 2; t++) {
 		for (i = 0; i < CID_TABLE_SIZE; i++)
-			if (cid_table[t][i].cid == cid[t]) {
-				cid_table[t][i].handle = 0;
-				cid_table[t][i].cid    = 0;
-				cid_table[t][i].psm    = 0;
-				cid_table[t][i].num    = 0;
-				cid_table[t][i].mode   = 0;
+			if (cid_table[parser.slot][t][i].cid == cid[t]) {
+				/* Frames look up the table of the other direction */
+				if ((parser.flags & (DUMP_A2DP | DUMP_MEDIA)) &&
+					cid_table[parser.slot][t][i].psm == 0x19)
+					a2dp_channel_close(
+						cid_table[parser.slot][t][i].handle,
+						cid[t], !t);
+				cid_table[parser.slot][t][i].handle = 0;
+				cid_table[parser.slot][t][i].cid    = 0;
+				cid_table[parser.slot][t][i].psm    = 0;
+				cid_table[parser.slot][t][i].num    = 0;
+				cid_table[parser.slot][t][i].mode   = 0;
 				break;
 			}
 	}
@@ -144,19 +150,18 @@ static void del_handle(uint16_t handle)
 
 	for (t = 0; t < 2; t++) {
 		for (i = 0; i < CID_TABLE_SIZE; i++)
-			if (cid_table[t][i].handle == handle) {
-				cid_table[t][i].handle = 0;
-				cid_table[t][i].cid    = 0;
-				cid_table[t][i].psm    = 0;
-				cid_table[t][i].num    = 0;
-				cid_table[t][i].mode   = 0;
-				break;
+			if (cid_table[parser.slot][t][i].handle == handle) {
+				cid_table[parser.slot][t][i].handle = 0;
+				cid_table[parser.slot][t][i].cid    = 0;
+				cid_table[parser.slot][t][i].psm    = 0;
+				cid_table[parser.slot][t][i].num    = 0;
+				cid_table[parser.slot][t][i].mode   = 0;
 			}
 	}
 }
 static uint16_t get_psm(int in, uint16_t cid)
 {
-	register cid_info *table = cid_table[in];
+	register cid_info *table = cid_table[parser.slot][in];
 	register int i;
 
 	for (i = 0; i < CID_TABLE_SIZE; i++)
@@ -167,7 +172,7 @@ static uint16_t get_psm(int in, uint16_t cid)
 
 static uint16_t get_num(int in, uint16_t cid)
 {
-	register cid_info *table = cid_table[in];
+	register cid_info *table = cid_table[parser.slot][in];
 	register int i;
 
 	for (i = 0; i < CID_TABLE_SIZE; i++)
@@ -178,7 +183,7 @@ static uint16_t get_num(int in, uint16_t cid)
 
 static void set_mode(int in, uint16_t cid, uint8_t mode)
 {
-	register cid_info *table = cid_table[in];
+	register cid_info *table = cid_table[parser.slot][in];
 	register int i;
 
 	for (i = 0; i < CID_TABLE_SIZE; i++)
@@ -188,7 +193,7 @@ static void set_mode(int in, uint16_t cid, uint8_t mode)
 
 static uint8_t get_mode(int in, uint16_t cid)
 {
-	register cid_info *table = cid_table[in];
+	register cid_info *table = cid_table[parser.slot][in];
 	register int i;
 
 	for (i = 0; i < CID_TABLE_SIZE; i++)
@@ -707,6 +712,291 @@ static inline void info_rsp(int level, l2cap_cmd_hdr *cmd, struct frame *frm)
 	}
 }
 
+/* Track the channel mode like conf_opt() does, without any output */
+static void conf_mode(void *ptr, int len, int in, uint16_t cid)
+{
+	while (len >= L2CAP_CONF_OPT_SIZE) {
+		l2cap_conf_opt *h = ptr;
+
+		ptr += L2CAP_CONF_OPT_SIZE + h->len;
+		len -= L2CAP_CONF_OPT_SIZE + h->len;
+
+		switch (h->type & 0x7f) {
+		case L2CAP_CONF_MTU:
+			set_mode(in, cid, 0x00);
+			break;
+		case L2CAP_CONF_RFC:
+			if (h->len > 0)
+				set_mode(in, cid, h->val[0]);
+			break;
+		}
+	}
+}
+
+static void signal_fields(l2cap_cmd_hdr *cmd, struct frame *frm, int show)
+{
+	uint16_t psm, scid, dcid, result;
+	int clen;
+
+	if (show) {
+		f_layer("l2cap");
+		f_u16("cid", 0x0001);
+		f_u8("code", cmd->code);
+		f_u8("ident", cmd->ident);
+		f_u16("clen", btohs(cmd->len));
+	}
+
+	switch (cmd->code) {
+	case L2CAP_COMMAND_REJ:
+		if (show) {
+			l2cap_cmd_rej *h = frm->ptr;
+			f_str("name", "Command rej");
+			f_u16("reason", btohs(h->reason));
+		}
+		break;
+
+	case L2CAP_CONN_REQ: {
+		l2cap_conn_req *h = frm->ptr;
+
+		psm = btohs(h->psm);
+		scid = btohs(h->scid);
+		add_cid(frm->in, frm->handle, scid, psm);
+
+		if (show) {
+			f_str("name", "Connect req");
+			f_u16("psm", psm);
+			f_u16("scid", scid);
+		}
+		break;
+	}
+
+	case L2CAP_CONN_RSP: {
+		l2cap_conn_rsp *h = frm->ptr;
+
+		scid = btohs(h->scid);
+		dcid = btohs(h->dcid);
+		result = btohs(h->result);
+
+		switch (h->result) {
+		case L2CAP_CR_SUCCESS:
+			if ((psm = get_psm(!frm->in, scid)))
+				add_cid(frm->in, frm->handle, dcid, psm);
+			break;
+		case L2CAP_CR_PEND:
+			break;
+		default:
+			del_cid(frm->in, dcid, scid);
+			break;
+		}
+
+		if (show) {
+			f_str("name", "Connect rsp");
+			f_u16("dcid", dcid);
+			f_u16("scid", scid);
+			f_u16("result", result);
+			f_u16("status", btohs(h->status));
+		}
+		break;
+	}
+
+	case L2CAP_CONF_REQ: {
+		l2cap_conf_req *h = frm->ptr;
+
+		dcid = btohs(h->dcid);
+		clen = btohs(cmd->len) - L2CAP_CONF_REQ_SIZE;
+		if (clen > 0)
+			conf_mode(h->data, clen, frm->in, dcid);
+
+		if (show) {
+			f_str("name", "Config req");
+			f_u16("dcid", dcid);
+			f_u16("flags", btohs(h->flags));
+		}
+		break;
+	}
+
+	case L2CAP_CONF_RSP: {
+		l2cap_conf_rsp *h = frm->ptr;
+
+		scid = btohs(h->scid);
+		result = btohs(h->result);
+		clen = btohs(cmd->len) - L2CAP_CONF_RSP_SIZE;
+		if (clen > 0 && result != 0x0003)
+			conf_mode(h->data, clen, frm->in, scid);
+
+		if (show) {
+			f_str("name", "Config rsp");
+			f_u16("scid", scid);
+			f_u16("flags", btohs(h->flags));
+			f_u16("result", result);
+		}
+		break;
+	}
+
+	case L2CAP_DISCONN_REQ:
+	case L2CAP_DISCONN_RSP: {
+		l2cap_disconn_req *h = frm->ptr;
+
+		dcid = btohs(h->dcid);
+		scid = btohs(h->scid);
+		if (cmd->code == L2CAP_DISCONN_RSP)
+			del_cid(frm->in, dcid, scid);
+
+		if (show) {
+			f_str("name", cmd->code == L2CAP_DISCONN_REQ ?
+					"Disconn req" : "Disconn rsp");
+			f_u16("dcid", dcid);
+			f_u16("scid", scid);
+		}
+		break;
+	}
+
+	case L2CAP_ECHO_REQ:
+	case L2CAP_ECHO_RSP:
+		if (show)
+			f_str("name", cmd->code == L2CAP_ECHO_REQ ?
+					"Echo req" : "Echo rsp");
+		break;
+
+	case L2CAP_INFO_REQ:
+	case L2CAP_INFO_RSP:
+		if (show) {
+			f_str("name", cmd->code == L2CAP_INFO_REQ ?
+					"Info req" : "Info rsp");
+			f_u16("info_type", btohs(bt_get_unaligned(
+						(uint16_t *) frm->ptr)));
+		}
+		break;
+	}
+}
+
+/* Fields reported by the structured output */
+const char *l2cap_field_names[] = {
+	"cid", "code", "ident", "clen", "name", "reason", "psm",
+	"scid", "dcid", "result", "status", "flags", "info_type",
+	"dlen", "mode", NULL
+};
+
+/* Structured counterpart of l2cap_parse() */
+static void l2cap_fields(struct frame *frm, uint16_t cid, uint16_t dlen)
+{
+	int show = !p_filter(FILT_L2CAP);
+	uint16_t psm;
+	uint8_t mode;
+	uint32_t proto;
+
+	if (cid == 0x1) {
+		/* Only the first command of a signaling frame is shown */
+		while (frm->len >= L2CAP_CMD_HDR_SIZE) {
+			l2cap_cmd_hdr *hdr = frm->ptr;
+
+			frm->ptr += L2CAP_CMD_HDR_SIZE;
+			frm->len -= L2CAP_CMD_HDR_SIZE;
+
+			signal_fields(hdr, frm, show);
+			show = 0;
+
+			if (frm->len > btohs(hdr->len)) {
+				frm->len -= btohs(hdr->len);
+				frm->ptr += btohs(hdr->len);
+			} else
+				frm->len = 0;
+		}
+		return;
+	}
+
+	if (cid == 0x2) {
+		if (show) {
+			f_layer("l2cap");
+			f_u16("cid", cid);
+			f_u16("dlen", dlen);
+			f_u16("psm", btohs(bt_get_unaligned(
+						(uint16_t *) frm->ptr)));
+		}
+		return;
+	}
+
+	if (cid == 0x4) {
+		if (show) {
+			f_layer("l2cap");
+			f_u16("cid", cid);
+			f_u16("dlen", dlen);
+		}
+		if (!p_filter(FILT_ATT))
+			PROF_CALL(PROF_ATT, att_dump(0, frm));
+		return;
+	}
+
+	mode = get_mode(!frm->in, cid);
+	psm = get_psm(!frm->in, cid);
+
+	frm->cid = cid;
+	frm->num = get_num(!frm->in, cid);
+
+	if (mode > 0) {
+		uint16_t ctrl = btohs(bt_get_unaligned((uint16_t *) frm->ptr));
+
+		frm->ptr += 2;
+		frm->len -= 4;
+
+		/* The SDU length of a start fragment precedes the payload */
+		if (!(ctrl & 0x01) && ((ctrl & 0xc000) >> 14) == 1) {
+			frm->ptr += 2;
+			frm->len -= 2;
+		}
+	}
+
+	if (show) {
+		f_layer("l2cap");
+		f_u16("cid", cid);
+		f_u16("dlen", dlen);
+		f_u16("psm", psm);
+		if (mode > 0)
+			f_u8("mode", mode);
+	}
+
+	switch (psm) {
+	case 0x01:
+		if (!p_filter(FILT_SDP))
+			PROF_CALL(PROF_SDP, sdp_dump(0, frm));
+		break;
+	case 0x03:
+		if (!p_filter(FILT_RFCOMM))
+			PROF_CALL(PROF_RFCOMM, rfcomm_dump(0, frm));
+		break;
+	case 0x0f:
+		if (!p_filter(FILT_BNEP))
+			PROF_CALL(PROF_BNEP, bnep_dump(0, frm));
+		break;
+	case 0x11:
+	case 0x13:
+		if (!p_filter(FILT_HIDP))
+			PROF_CALL(PROF_HIDP, hidp_dump(0, frm));
+		break;
+	case 0x17:
+		if (!p_filter(FILT_AVCTP))
+			PROF_CALL(PROF_AVCTP, avctp_dump(0, frm));
+		break;
+	case 0x19:
+		if (!p_filter(FILT_AVDTP))
+			PROF_CALL(PROF_AVDTP, avdtp_dump(0, frm));
+		break;
+	case 0x1f:
+		if (!p_filter(FILT_ATT))
+			PROF_CALL(PROF_ATT, att_dump(0, frm));
+		break;
+	default:
+		proto = get_proto(frm->handle, psm, 0);
+
+		if (proto == SDP_UUID_CMTP && !p_filter(FILT_CMTP))
+			PROF_CALL(PROF_CMTP, cmtp_dump(0, frm));
+		else if (proto == SDP_UUID_HARDCOPY_CONTROL_CHANNEL &&
+						!p_filter(FILT_HCRP))
+			PROF_CALL(PROF_HCRP, hcrp_dump(0, frm));
+		break;
+	}
+}
+
 static void l2cap_parse(int level, struct frame *frm)
 {
 	l2cap_hdr *hdr = (void *)frm->ptr;
@@ -717,6 +1007,11 @@ static void l2cap_parse(int level, struct frame *frm)
 	frm->ptr += L2CAP_HDR_SIZE;
 	frm->len -= L2CAP_HDR_SIZE;
 
+	if (parser.sink) {
+		l2cap_fields(frm, cid, dlen);
+		return;
+	}
+
 	if (cid == 0x1) {
 		/* Signaling channel */
 
@@ -803,6 +1098,19 @@ static void l2cap_parse(int level, struct frame *frm)
 		p_indent(level, frm);
 		printf("L2CAP(c): len %d psm %d\n", dlen, psm);
 		raw_dump(level, frm);
+	} else if (cid == 0x4) {
+		/* LE attribute protocol channel */
+
+		if (!p_filter(FILT_L2CAP)) {
+			p_indent(level, frm);
+			printf("L2CAP(d): cid 0x%4.4x len %d [att]\n", cid, dlen);
+			level++;
+		}
+
+		if (!p_filter(FILT_ATT))
+			PROF_CALL(PROF_ATT, att_dump(level, frm));
+		else
+			raw_dump(level + 1, frm);
 	} else {
 		/* Connection oriented channel */
 
@@ -857,21 +1165,21 @@ static void l2cap_parse(int level, struct frame *frm)
 		switch (psm) {
 		case 0x01:
 			if (!p_filter(FILT_SDP))
-				sdp_dump(level + 1, frm);
+				PROF_CALL(PROF_SDP, sdp_dump(level + 1, frm));
 			else
 				raw_dump(level + 1, frm);
 			break;
 
 		case 0x03:
 			if (!p_filter(FILT_RFCOMM))
-				rfcomm_dump(level, frm);
+				PROF_CALL(PROF_RFCOMM, rfcomm_dump(level, frm));
 			else
 				raw_dump(level + 1, frm);
 			break;
 
 		case 0x0f:
 			if (!p_filter(FILT_BNEP))
-				bnep_dump(level, frm);
+				PROF_CALL(PROF_BNEP, bnep_dump(level, frm));
 			else
 				raw_dump(level + 1, frm);
 			break;
@@ -879,28 +1187,28 @@ static void l2cap_parse(int level, struct frame *frm)
 		case 0x11:
 		case 0x13:
 			if (!p_filter(FILT_HIDP))
-				hidp_dump(level, frm);
+				PROF_CALL(PROF_HIDP, hidp_dump(level, frm));
 			else
 				raw_dump(level + 1, frm);
 			break;
 
 		case 0x17:
 			if (!p_filter(FILT_AVCTP))
-				avctp_dump(level, frm);
+				PROF_CALL(PROF_AVCTP, avctp_dump(level, frm));
 			else
 				raw_dump(level + 1, frm);
 			break;
 
 		case 0x19:
 			if (!p_filter(FILT_AVDTP))
-				avdtp_dump(level, frm);
+				PROF_CALL(PROF_AVDTP, avdtp_dump(level, frm));
 			else
 				raw_dump(level + 1, frm);
 			break;
 
 		case 0x1f:
 			if (!p_filter(FILT_ATT))
-				att_dump(level, frm);
+				PROF_CALL(PROF_ATT, att_dump(level, frm));
 			else
 				raw_dump(level + 1, frm);
 			break;
@@ -911,14 +1219,14 @@ static void l2cap_parse(int level, struct frame *frm)
 			switch (proto) {
 			case SDP_UUID_CMTP:
 				if (!p_filter(FILT_CMTP))
-					cmtp_dump(level, frm);
+					PROF_CALL(PROF_CMTP, cmtp_dump(level, frm));
 				else
 					raw_dump(level + 1, frm);
 				break;
 
 			case SDP_UUID_HARDCOPY_CONTROL_CHANNEL:
 				if (!p_filter(FILT_HCRP))
-					hcrp_dump(level, frm);
+					PROF_CALL(PROF_HCRP, hcrp_dump(level, frm));
 				else
 					raw_dump(level + 1, frm);
 				break;
@@ -0,0 +1,509 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+
+#include "parser.h"
+
+/*
+ * Log-linear histogram: values below 16us are exact, above that every
+ * power of two is split into 16 buckets, so any latency up to ~71 min
+ * is kept within 6.25% in a fixed number of counters.
+ */
+#define SUB_BITS	4
+#define SUB_COUNT	(1 << SUB_BITS)
+#define HIST_BUCKETS	((32 - SUB_BITS + 1) * SUB_COUNT)
+
+#define MAX_PENDING	64
+#define STATS_SLOTS	256
+
+/* Commands whose outcome arrives in a separate event */
+#define LE_EVENT(sub)	(0x100 | (sub))
+
+enum {
+	KEY_NONE,
+	KEY_HANDLE,
+	KEY_BDADDR,
+};
+
+static const struct {
+	uint16_t	opcode;
+	uint16_t	event;
+	uint8_t		key;
+	uint8_t		offset;		/* Of the key in the event */
+} completions[] = {
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_INQUIRY),
+		EVT_INQUIRY_COMPLETE,			KEY_NONE,	0 },
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_CREATE_CONN),
+		EVT_CONN_COMPLETE,			KEY_BDADDR,	3 },
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_DISCONNECT),
+		EVT_DISCONN_COMPLETE,			KEY_HANDLE,	1 },
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_ACCEPT_CONN_REQ),
+		EVT_CONN_COMPLETE,			KEY_BDADDR,	3 },
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_SET_CONN_PTYPE),
+		EVT_CONN_PTYPE_CHANGED,			KEY_HANDLE,	1 },
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_AUTH_REQUESTED),
+		EVT_AUTH_COMPLETE,			KEY_HANDLE,	1 },
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_SET_CONN_ENCRYPT),
+		EVT_ENCRYPT_CHANGE,			KEY_HANDLE,	1 },
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_CHANGE_CONN_LINK_KEY),
+		EVT_CHANGE_CONN_LINK_KEY_COMPLETE,	KEY_HANDLE,	1 },
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_REMOTE_NAME_REQ),
+		EVT_REMOTE_NAME_REQ_COMPLETE,		KEY_BDADDR,	1 },
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_READ_REMOTE_FEATURES),
+		EVT_READ_REMOTE_FEATURES_COMPLETE,	KEY_HANDLE,	1 },
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_READ_REMOTE_EXT_FEATURES),
+		EVT_READ_REMOTE_EXT_FEATURES_COMPLETE,	KEY_HANDLE,	1 },
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_READ_REMOTE_VERSION),
+		EVT_READ_REMOTE_VERSION_COMPLETE,	KEY_HANDLE,	1 },
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_READ_CLOCK_OFFSET),
+		EVT_READ_CLOCK_OFFSET_COMPLETE,		KEY_HANDLE,	1 },
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_SETUP_SYNC_CONN),
+		EVT_SYNC_CONN_COMPLETE,			KEY_NONE,	0 },
+	{ cmd_opcode_pack(OGF_LINK_CTL, OCF_ACCEPT_SYNC_CONN_REQ),
+		EVT_SYNC_CONN_COMPLETE,			KEY_BDADDR,	3 },
+	{ cmd_opcode_pack(OGF_LINK_POLICY, OCF_SWITCH_ROLE),
+		EVT_ROLE_CHANGE,			KEY_BDADDR,	1 },
+	{ cmd_opcode_pack(OGF_LE_CTL, OCF_LE_CREATE_CONN),
+		LE_EVENT(EVT_LE_CONN_COMPLETE),		KEY_NONE,	0 },
+	{ cmd_opcode_pack(OGF_LE_CTL, OCF_LE_CONN_UPDATE),
+		LE_EVENT(EVT_LE_CONN_UPDATE_COMPLETE),	KEY_HANDLE,	2 },
+	{ cmd_opcode_pack(OGF_LE_CTL, OCF_LE_READ_REMOTE_USED_FEATURES),
+		LE_EVENT(EVT_LE_READ_REMOTE_USED_FEATURES_COMPLETE),
+							KEY_HANDLE,	2 },
+	{ cmd_opcode_pack(OGF_LE_CTL, OCF_LE_START_ENCRYPTION),
+		EVT_ENCRYPT_CHANGE,			KEY_HANDLE,	1 },
+	{ }
+};
+
+struct lat_hist {
+	uint32_t	count;
+	uint32_t	max;
+	uint32_t	bucket[HIST_BUCKETS];
+};
+
+struct lat_stats {
+	uint16_t	opcode;
+	unsigned long	sent;
+	unsigned long	lost;		/* Never answered or completed */
+	struct lat_hist	resp;		/* Until Command Status/Complete */
+	struct lat_hist	done;		/* Until the completion event */
+};
+
+/* Commands waiting for their response or completion event */
+static struct {
+	int		used;
+	uint16_t	dev_id;
+	uint16_t	opcode;
+	uint16_t	event;		/* Zero until the command was answered */
+	uint8_t		key[6];
+	uint8_t		key_len;
+	struct timeval	ts;
+	struct lat_stats *stats;
+} pending[MAX_PENDING];
+
+static struct lat_stats *stats_table[STATS_SLOTS];
+static int stats_count = 0;
+
+static inline uint16_t get_le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static struct lat_stats *get_stats(uint16_t opcode)
+{
+	unsigned int h = (opcode ^ (opcode >> 8)) % STATS_SLOTS;
+	struct lat_stats *s;
+
+	while ((s = stats_table[h])) {
+		if (s->opcode == opcode)
+			return s;
+		h = (h + 1) % STATS_SLOTS;
+	}
+
+	if (stats_count == STATS_SLOTS - 1)
+		return NULL;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+
+	s->opcode = opcode;
+	stats_table[h] = s;
+	stats_count++;
+
+	return s;
+}
+
+static inline int hist_bucket(uint32_t val)
+{
+	int e;
+
+	if (val < SUB_COUNT)
+		return val;
+
+	e = 31 - __builtin_clz(val);
+
+	return (e - SUB_BITS + 1) * SUB_COUNT +
+				((val >> (e - SUB_BITS)) & (SUB_COUNT - 1));
+}
+
+/* Highest value that falls into a bucket */
+static uint32_t hist_value(int bucket)
+{
+	int e, sub;
+
+	if (bucket < SUB_COUNT)
+		return bucket;
+
+	e = bucket / SUB_COUNT + SUB_BITS - 1;
+	sub = bucket % SUB_COUNT;
+
+	return ((uint32_t) (SUB_COUNT + sub) << (e - SUB_BITS)) +
+					((1u << (e - SUB_BITS)) - 1);
+}
+
+struct lat_hist *lat_hist_new(void)
+{
+	return calloc(1, sizeof(struct lat_hist));
+}
+
+void lat_hist_add(struct lat_hist *h, const struct timeval *start,
+						const struct timeval *end)
+{
+	long long usec = (end->tv_sec - start->tv_sec) * 1000000ll +
+					(end->tv_usec - start->tv_usec);
+	uint32_t val;
+
+	/* Merged sources can be slightly out of order */
+	if (usec < 0)
+		usec = 0;
+	val = usec > 0xffffffffll ? 0xffffffff : usec;
+
+	h->bucket[hist_bucket(val)]++;
+	h->count++;
+	if (val > h->max)
+		h->max = val;
+}
+
+static uint32_t hist_percentile(struct lat_hist *h, int permille)
+{
+	uint32_t rank = ((uint64_t) h->count * permille + 999) / 1000;
+	uint32_t seen = 0;
+	int i;
+
+	if (rank == 0)
+		rank = 1;
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		seen += h->bucket[i];
+		if (seen >= rank)
+			break;
+	}
+
+	/* The top bucket can't go past what was actually seen */
+	return hist_value(i) < h->max ? hist_value(i) : h->max;
+}
+
+static int find_completion(uint16_t opcode)
+{
+	int i;
+
+	for (i = 0; completions[i].opcode; i++)
+		if (completions[i].opcode == opcode)
+			return i;
+
+	return -1;
+}
+
+static void drop_pending(int i)
+{
+	if (pending[i].stats)
+		pending[i].stats->lost++;
+
+	pending[i].used = 0;
+}
+
+static void lat_command(uint16_t dev_id, const struct timeval *ts,
+				uint16_t opcode, const uint8_t *data, int len)
+{
+	struct lat_stats *s = get_stats(opcode);
+	int i, slot = -1, oldest = -1;
+
+	if (s)
+		s->sent++;
+
+	for (i = 0; i < MAX_PENDING; i++) {
+		if (!pending[i].used) {
+			if (slot < 0)
+				slot = i;
+			continue;
+		}
+
+		if (oldest < 0 || timercmp(&pending[i].ts,
+						&pending[oldest].ts, <))
+			oldest = i;
+
+		if (pending[i].dev_id != dev_id)
+			continue;
+
+		/* A reset throws away whatever the controller had queued */
+		if (opcode == cmd_opcode_pack(OGF_HOST_CTL, OCF_RESET)) {
+			drop_pending(i);
+			if (slot < 0)
+				slot = i;
+			continue;
+		}
+
+		/* Same command again while the last one is unanswered */
+		if (pending[i].opcode == opcode && !pending[i].event) {
+			drop_pending(i);
+			if (slot < 0)
+				slot = i;
+			continue;
+		}
+	}
+
+	if (slot < 0) {
+		drop_pending(oldest);
+		slot = oldest;
+	}
+
+	pending[slot].used = 1;
+	pending[slot].dev_id = dev_id;
+	pending[slot].opcode = opcode;
+	pending[slot].event = 0;
+	pending[slot].ts = *ts;
+	pending[slot].stats = s;
+
+	/* The key is the leading handle or address of the parameters */
+	i = find_completion(opcode);
+	if (i < 0 || completions[i].key == KEY_NONE)
+		pending[slot].key_len = 0;
+	else if (completions[i].key == KEY_HANDLE && len >= 2) {
+		pending[slot].key[0] = data[0];
+		pending[slot].key[1] = data[1] & 0x0f;
+		pending[slot].key_len = 2;
+	} else if (completions[i].key == KEY_BDADDR && len >= 6) {
+		memcpy(pending[slot].key, data, 6);
+		pending[slot].key_len = 6;
+	} else
+		pending[slot].key_len = 0;
+}
+
+static void lat_response(uint16_t dev_id, const struct timeval *ts,
+						uint16_t opcode, uint8_t status)
+{
+	int i, c;
+
+	for (i = 0; i < MAX_PENDING; i++) {
+		if (pending[i].used && pending[i].dev_id == dev_id &&
+				pending[i].opcode == opcode &&
+				!pending[i].event)
+			break;
+	}
+
+	if (i == MAX_PENDING)
+		return;
+
+	if (pending[i].stats)
+		lat_hist_add(&pending[i].stats->resp, &pending[i].ts, ts);
+
+	c = find_completion(opcode);
+	if (c < 0 || status) {
+		pending[i].used = 0;
+		return;
+	}
+
+	pending[i].event = completions[c].event;
+}
+
+static void lat_complete(uint16_t dev_id, const struct timeval *ts,
+				uint16_t event, const uint8_t *data, int len)
+{
+	int i, c;
+
+	for (i = 0; i < MAX_PENDING; i++) {
+		if (!pending[i].used || pending[i].dev_id != dev_id ||
+						pending[i].event != event)
+			continue;
+
+		c = find_completion(pending[i].opcode);
+
+		if (pending[i].key_len) {
+			const uint8_t *key = data + completions[c].offset;
+
+			if (completions[c].offset + pending[i].key_len > len)
+				continue;
+
+			if (pending[i].key_len == 2 ? (key[0] !=
+					pending[i].key[0] || (key[1] & 0x0f) !=
+					pending[i].key[1]) :
+					memcmp(key, pending[i].key, 6))
+				continue;
+		}
+
+		if (pending[i].stats)
+			lat_hist_add(&pending[i].stats->done, &pending[i].ts, ts);
+
+		pending[i].used = 0;
+		break;
+	}
+}
+
+void __lat_frame(struct frame *frm)
+{
+	const uint8_t *data = frm->ptr;
+	int len = frm->len;
+
+	if (len < 3)
+		return;
+
+	switch (data[0]) {
+	case HCI_COMMAND_PKT:
+		if (len < 4)
+			return;
+		lat_command(frm->dev_id, &frm->ts, get_le16(data + 1),
+							data + 4, len - 4);
+		break;
+
+	case HCI_EVENT_PKT:
+		data += 3;
+		len -= 3;
+
+		switch (data[-2]) {
+		case EVT_CMD_COMPLETE:
+			if (len < 3)
+				return;
+			lat_response(frm->dev_id, &frm->ts,
+					get_le16(data + 1), len > 3 ? data[3] : 0);
+			break;
+
+		case EVT_CMD_STATUS:
+			if (len < 4)
+				return;
+			lat_response(frm->dev_id, &frm->ts,
+						get_le16(data + 2), data[0]);
+			break;
+
+		case EVT_LE_META_EVENT:
+			if (len < 1)
+				return;
+			lat_complete(frm->dev_id, &frm->ts,
+					LE_EVENT(data[0]), data, len);
+			break;
+
+		default:
+			lat_complete(frm->dev_id, &frm->ts, data[-2], data, len);
+			break;
+		}
+		break;
+	}
+}
+
+static int cmp_stats(const void *a, const void *b)
+{
+	const struct lat_stats *s1 = *(const struct lat_stats **) a;
+	const struct lat_stats *s2 = *(const struct lat_stats **) b;
+
+	return s1->opcode - s2->opcode;
+}
+
+void lat_line(FILE *out, const char *name, unsigned long count,
+				unsigned long open, struct lat_hist *h)
+{
+	if (!h->count) {
+		fprintf(out, "  %-40.40s %7lu %5lu %9s %9s %9s\n", name,
+						count, open, "-", "-", "-");
+		return;
+	}
+
+	fprintf(out, "  %-40.40s %7lu %5lu %9.3f %9.3f %9.3f\n", name,
+				count, open,
+				hist_percentile(h, 500) / 1000.0,
+				hist_percentile(h, 990) / 1000.0,
+				h->max / 1000.0);
+}
+
+void lat_dump(FILE *out)
+{
+	struct lat_stats *list[STATS_SLOTS];
+	unsigned long total = 0, incomplete = 0, open;
+	char name[64];
+	int i, j, n = 0;
+
+	for (i = 0; i < STATS_SLOTS; i++)
+		if (stats_table[i])
+			list[n++] = stats_table[i];
+
+	qsort(list, n, sizeof(list[0]), cmp_stats);
+
+	for (i = 0; i < n; i++) {
+		total += list[i]->sent;
+		incomplete += list[i]->lost;
+	}
+
+	for (i = 0; i < MAX_PENDING; i++)
+		if (pending[i].used)
+			incomplete++;
+
+	fprintf(out, "latency: %lu commands %lu not completed\n",
+							total, incomplete);
+	fprintf(out, "  %-40s %7s %5s %9s %9s %9s\n", "command",
+			"count", "open", "p50 ms", "p99 ms", "max ms");
+
+	for (i = 0; i < n; i++) {
+		struct lat_stats *s = list[i];
+
+		open = s->lost;
+		for (j = 0; j < MAX_PENDING; j++)
+			if (pending[j].used && pending[j].stats == s)
+				open++;
+
+		snprintf(name, sizeof(name), "0x%4.4x %s", s->opcode,
+						hci_cmd2str(s->opcode));
+
+		lat_line(out, name, s->sent, open, &s->resp);
+
+		if (s->done.count)
+			lat_line(out, "  until completed", s->done.count, 0,
+								&s->done);
+	}
+
+	fflush(out);
+}
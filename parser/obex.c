@@ -36,6 +36,49 @@
 
 #include "parser.h"
 
+#define OBEX_TRANSFERS	8
+#define OBEX_NAME_SIZE	64
+#define OBEX_BUF_SIZE	65536
+
+#define OBEX_PUT	0x02
+#define OBEX_GET	0x03
+#define OBEX_CONTINUE	0x10
+#define OBEX_SUCCESS	0x20
+
+/* An object on its way over one channel, only the headers are kept */
+struct obex_transfer {
+	uint8_t		used;
+	uint8_t		slot;		/* Device slot */
+	uint8_t		dlci;
+	uint8_t		opcode;		/* Put or Get, 0 when idle */
+	uint16_t	handle;
+	uint16_t	dev_id;
+	char		name[OBEX_NAME_SIZE];
+	char		type[OBEX_NAME_SIZE];
+	uint32_t	length;
+	uint8_t		has_length;
+	FILE		*file;
+	char		*path;
+	uint64_t	bytes;
+	uint32_t	packets;
+	uint64_t	start;
+	uint64_t	last;
+};
+
+static struct obex_transfer transfers[OBEX_TRANSFERS];
+
+static char *obex_base = NULL;
+static int obex_count = 0;
+
+void obex_extract_init(const char *base)
+{
+	obex_base = strdup(base);
+	if (!obex_base) {
+		perror("Can't allocate memory");
+		exit(1);
+	}
+}
+
 static char *opcode2str(uint8_t opcode)
 {
 	switch (opcode & 0x7f) {
@@ -256,6 +299,303 @@ static void parse_headers(int level, struct frame *frm)
 	}
 }
 
+static struct obex_transfer *get_transfer(struct frame *frm)
+{
+	struct obex_transfer *t, *free_t = NULL;
+	int i;
+
+	for (i = 0; i < OBEX_TRANSFERS; i++) {
+		t = &transfers[i];
+
+		if (!t->used) {
+			if (!free_t)
+				free_t = t;
+			continue;
+		}
+
+		if (t->slot == parser.slot && t->handle == frm->handle &&
+							t->dlci == frm->dlci)
+			return t;
+	}
+
+	if (!free_t)
+		return NULL;
+
+	memset(free_t, 0, sizeof(*free_t));
+	free_t->used   = 1;
+	free_t->slot   = parser.slot;
+	free_t->handle = frm->handle;
+	free_t->dlci   = frm->dlci;
+	free_t->dev_id = frm->dev_id;
+
+	return free_t;
+}
+
+static void end_transfer(struct obex_transfer *t, uint8_t status)
+{
+	uint64_t usec = t->last - t->start;
+	char length[16];
+
+	if (t->file && fclose(t->file) < 0)
+		perror("Write error");
+
+	if (t->has_length)
+		sprintf(length, "%u", t->length);
+	else
+		strcpy(length, "-");
+
+	fprintf(stderr, "obex: hci%d handle %d dlci %d %s \"%s\" type \"%s\" "
+			"length %s -> %s %llu bytes in %u packets %.3f s "
+			"%.1f kB/s%s\n", t->dev_id, t->handle, t->dlci,
+			opcode2str(t->opcode), t->name, t->type, length,
+			t->path ? t->path : "none",
+			(unsigned long long) t->bytes, t->packets,
+			usec / 1000000.0,
+			usec ? t->bytes * 1000.0 / usec : 0.0,
+			status != OBEX_SUCCESS ? " (incomplete)" :
+			t->has_length && t->length != t->bytes ?
+						" (length mismatch)" : "");
+
+	free(t->path);
+	t->path   = NULL;
+	t->file   = NULL;
+	t->opcode = 0;
+}
+
+/* File names are made from the object name without anything path like */
+static void open_object(struct obex_transfer *t)
+{
+	char *p;
+	int n;
+
+	t->path = malloc(strlen(obex_base) + OBEX_NAME_SIZE + 16);
+	if (!t->path) {
+		perror("Can't allocate memory");
+		exit(1);
+	}
+
+	n = sprintf(t->path, "%s-%d", obex_base, ++obex_count);
+
+	if (t->name[0]) {
+		sprintf(t->path + n, "-%s", t->name);
+
+		for (p = t->path + n + 1; *p; p++)
+			if (*p == '/' || *p == '\\' || *p < 0x20 || *p > 0x7e)
+				*p = '_';
+
+		if (t->path[n + 1] == '.')
+			t->path[n + 1] = '_';
+	} else
+		strcpy(t->path + n, ".bin");
+
+	t->file = fopen(t->path, "w");
+	if (!t->file) {
+		perror("Can't open object file");
+		return;
+	}
+
+	setvbuf(t->file, NULL, _IOFBF, OBEX_BUF_SIZE);
+}
+
+/* Name is big endian Unicode, the rest of the world gets underscores */
+static void copy_name(char *dst, const uint8_t *src, int len)
+{
+	int i, n = 0;
+
+	for (i = 0; i + 1 < len && n < OBEX_NAME_SIZE - 1; i += 2) {
+		if (!src[i] && !src[i + 1])
+			break;
+		dst[n++] = src[i] || src[i + 1] < 0x20 || src[i + 1] > 0x7e ?
+							'_' : src[i + 1];
+	}
+
+	dst[n] = '\0';
+}
+
+static void copy_type(char *dst, const uint8_t *src, int len)
+{
+	int i, n = 0;
+
+	for (i = 0; i < len && n < OBEX_NAME_SIZE - 1 && src[i]; i++)
+		dst[n++] = src[i] < 0x20 || src[i] > 0x7e ? '_' : src[i];
+
+	dst[n] = '\0';
+}
+
+/* Body contents go to the file as they come, nothing is kept around */
+static void extract_headers(struct obex_transfer *t, const uint8_t *data,
+								int len)
+{
+	while (len > 0) {
+		uint8_t hi = data[0];
+		int size;
+
+		switch (hi & 0xc0) {
+		case 0x00:
+		case 0x40:
+			if (len < 3)
+				return;
+			size = (data[1] << 8) | data[2];
+			break;
+		case 0x80:
+			size = 2;
+			break;
+		default:
+			size = 5;
+			break;
+		}
+
+		if (size < 3 && (hi & 0x80) == 0x00)
+			return;
+
+		if (size > len)
+			return;
+
+		switch (hi) {
+		case 0x01:
+			copy_name(t->name, data + 3, size - 3);
+			break;
+		case 0x42:
+			copy_type(t->type, data + 3, size - 3);
+			break;
+		case 0xc3:
+			t->length = (data[1] << 24) | (data[2] << 16) |
+						(data[3] << 8) | data[4];
+			t->has_length = 1;
+			break;
+		case 0x48:
+		case 0x49:
+			if (!t->path)
+				open_object(t);
+			if (t->file && size > 3)
+				fwrite(data + 3, size - 3, 1, t->file);
+			t->bytes += size - 3;
+			break;
+		}
+
+		data += size;
+		len -= size;
+	}
+}
+
+static void extract_packet(struct frame *frm, const uint8_t *data, int len,
+								uint64_t now)
+{
+	struct obex_transfer *t = get_transfer(frm);
+	uint8_t opcode = data[0];
+	int response;
+
+	if (!t)
+		return;
+
+	/* Abort is the one command with the bits of a response */
+	response = (opcode & 0x70) && opcode != 0xff;
+
+	if (!response) {
+		/* Every other command ends what went on before */
+		if (t->opcode && (opcode & 0x7f) != t->opcode)
+			end_transfer(t, 0);
+
+		if ((opcode & 0x7f) != OBEX_PUT && (opcode & 0x7f) != OBEX_GET)
+			return;
+
+		if (!t->opcode) {
+			memset(t->name, 0, sizeof(t->name));
+			memset(t->type, 0, sizeof(t->type));
+			t->has_length = 0;
+			t->length     = 0;
+			t->bytes      = 0;
+			t->packets    = 0;
+			t->opcode     = opcode & 0x7f;
+			t->start      = now;
+		}
+	} else if (!t->opcode)
+		return;
+
+	t->packets++;
+	t->last = now;
+
+	extract_headers(t, data + 3, len - 3);
+
+	if (response && (opcode & 0x7f) != OBEX_CONTINUE)
+		end_transfer(t, opcode & 0x7f);
+}
+
+/* Goes through the complete packets without consuming them */
+static void obex_extract(struct frame *frm)
+{
+	const uint8_t *data = frm->ptr;
+	uint64_t now = frm->ts.tv_sec * 1000000ull + frm->ts.tv_usec;
+	int len = frm->len;
+
+	while (len > 2) {
+		int size = (data[1] << 8) | data[2];
+
+		if (size < 3 || size > len)
+			break;
+
+		extract_packet(frm, data, size, now);
+
+		data += size;
+		len -= size;
+	}
+}
+
+void obex_close(void)
+{
+	int i;
+
+	for (i = 0; i < OBEX_TRANSFERS; i++)
+		if (transfers[i].used && transfers[i].opcode)
+			end_transfer(&transfers[i], 0);
+}
+
+/* Structured counterpart of obex_dump() */
+static void obex_fields(struct frame *frm)
+{
+	uint8_t last_opcode, opcode, status;
+	uint16_t length;
+
+	if (frm->len < 3)
+		return;
+
+	opcode = get_u8(frm);
+	length = get_u16(frm);
+	status = opcode & 0x7f;
+
+	if ((int) frm->len < length - 3) {
+		frm->ptr -= 3;
+		frm->len += 3;
+		return;
+	}
+
+	last_opcode = get_opcode(frm->handle, frm->dlci);
+
+	f_layer("obex");
+	f_u8("final", opcode >> 7);
+	f_u16("plen", length);
+
+	if (!(opcode & 0x70)) {
+		f_u8("opcode", opcode & 0x7f);
+		f_str("name", opcode2str(opcode));
+		set_opcode(frm->handle, frm->dlci, opcode);
+	} else {
+		f_u8("opcode", last_opcode & 0x7f);
+		f_str("name", opcode2str(last_opcode));
+		f_u8("status", status);
+		f_str("status_name", opcode2str(status));
+	}
+
+	if (get_status(frm->handle, frm->dlci) == 0x10)
+		f_u8("continue", 1);
+
+	set_status(frm->handle, frm->dlci, status);
+
+	/* Headers are not broken out, the text output eats them as well */
+	frm->ptr += frm->len;
+	frm->len = 0;
+}
+
 void obex_dump(int level, struct frame *frm)
 {
 	uint8_t last_opcode, opcode, status;
@@ -264,6 +604,14 @@ void obex_dump(int level, struct frame *frm)
 
 	frm = add_frame(frm);
 
+	if (obex_base)
+		obex_extract(frm);
+
+	if (parser.sink) {
+		obex_fields(frm);
+		return;
+	}
+
 	while (frm->len > 2) {
 		opcode = get_u8(frm);
 		length = get_u16(frm);
@@ -53,8 +53,36 @@ void init_parser(unsigned long flags, unsigned long filter,
 	parser.defpsm     = defpsm;
 	parser.defcompid  = defcompid;
 	parser.state      = 0;
+	parser.slot       = 0;
 	parser.pppdump_fd = pppdump_fd;
 	parser.audio_fd   = audio_fd;
+	parser.bdaddr     = NULL;
+}
+
+static uint16_t slot_table[DEVICE_SLOTS];
+static int slot_count = 0;
+
+void set_device(uint16_t dev_id)
+{
+	int i;
+
+	if (slot_count > 0 && slot_table[parser.slot] == dev_id)
+		return;
+
+	for (i = 0; i < slot_count; i++)
+		if (slot_table[i] == dev_id) {
+			parser.slot = i;
+			return;
+		}
+
+	/* Devices beyond the last slot share its state */
+	if (slot_count == DEVICE_SLOTS) {
+		parser.slot = DEVICE_SLOTS - 1;
+		return;
+	}
+
+	slot_table[slot_count] = dev_id;
+	parser.slot = slot_count++;
 }
 
 #define PROTO_TABLE_SIZE 20
@@ -63,12 +91,14 @@ static struct {
 	uint16_t handle;
 	uint16_t psm;
 	uint8_t  channel;
+	uint8_t  slot;
 	uint32_t proto;
 } proto_table[PROTO_TABLE_SIZE];
 
 void set_proto(uint16_t handle, uint16_t psm, uint8_t channel, uint32_t proto)
 {
 	int i, pos = -1;
+	uint8_t slot;
 
 	if (psm > 0 && psm < 0x1000 && !channel)
 		return;
@@ -76,8 +106,12 @@ void set_proto(uint16_t handle, uint16_t psm, uint8_t channel, uint32_t proto)
 	if (!psm && channel)
 		psm = RFCOMM_PSM; 
 
+	/* Entries without a handle are defaults for every device */
+	slot = handle ? parser.slot : 0;
+
 	for (i = 0; i < PROTO_TABLE_SIZE; i++) {
-		if (proto_table[i].handle == handle && proto_table[i].psm == psm && proto_table[i].channel == channel) {
+		if (proto_table[i].handle == handle && proto_table[i].psm == psm && proto_table[i].channel == channel &&
+					proto_table[i].slot == slot) {
 			pos = i;
 			break;
 		}
@@ -92,6 +126,7 @@ void set_proto(uint16_t handle, uint16_t psm, uint8_t channel, uint32_t proto)
 	proto_table[pos].handle  = handle;
 	proto_table[pos].psm     = psm;
 	proto_table[pos].channel = channel;
+	proto_table[pos].slot    = slot;
 	proto_table[pos].proto   = proto;
 }
 
@@ -103,7 +138,8 @@ uint32_t get_proto(uint16_t handle, uint16_t psm, uint8_t channel)
 		psm = RFCOMM_PSM;
 
 	for (i = 0; i < PROTO_TABLE_SIZE; i++) {
-		if (proto_table[i].handle == handle && proto_table[i].psm == psm && proto_table[i].channel == channel)
+		if (proto_table[i].handle == handle && proto_table[i].psm == psm && proto_table[i].channel == channel &&
+					proto_table[i].slot == parser.slot)
 			return proto_table[i].proto;
 
 		if (!proto_table[i].handle) {
@@ -123,22 +159,22 @@ static struct {
 	uint8_t opcode;
 	uint8_t status;
 	struct frame frm;
-} frame_table[FRAME_TABLE_SIZE];
+} frame_table[DEVICE_SLOTS][FRAME_TABLE_SIZE];
 
 void del_frame(uint16_t handle, uint8_t dlci)
 {
 	int i;
 
 	for (i = 0; i < FRAME_TABLE_SIZE; i++)
-		if (frame_table[i].handle == handle &&
-					frame_table[i].dlci == dlci) {
-			frame_table[i].handle = 0;
-			frame_table[i].dlci   = 0;
-			frame_table[i].opcode = 0;
-			frame_table[i].status = 0;
-			if (frame_table[i].frm.data)
-				free(frame_table[i].frm.data);
-			memset(&frame_table[i].frm, 0, sizeof(struct frame));
+		if (frame_table[parser.slot][i].handle == handle &&
+					frame_table[parser.slot][i].dlci == dlci) {
+			frame_table[parser.slot][i].handle = 0;
+			frame_table[parser.slot][i].dlci   = 0;
+			frame_table[parser.slot][i].opcode = 0;
+			frame_table[parser.slot][i].status = 0;
+			if (frame_table[parser.slot][i].frm.data)
+				free(frame_table[parser.slot][i].frm.data);
+			memset(&frame_table[parser.slot][i].frm, 0, sizeof(struct frame));
 			break;
 		}
 }
@@ -150,22 +186,23 @@ struct frame *add_frame(struct frame *frm)
 	int i, pos = -1;
 
 	for (i = 0; i < FRAME_TABLE_SIZE; i++) {
-		if (frame_table[i].handle == frm->handle &&
-					frame_table[i].dlci == frm->dlci) {
+		if (frame_table[parser.slot][i].handle == frm->handle &&
+					frame_table[parser.slot][i].dlci == frm->dlci) {
 			pos = i;
 			break;
 		}
 
-		if (pos < 0 && !frame_table[i].handle && !frame_table[i].dlci)
+		if (pos < 0 && !frame_table[parser.slot][i].handle &&
+					!frame_table[parser.slot][i].dlci)
 			pos = i;
 	}
 
 	if (pos < 0)
 		return frm;
 
-	frame_table[pos].handle = frm->handle;
-	frame_table[pos].dlci   = frm->dlci;
-	fr = &frame_table[pos].frm;
+	frame_table[parser.slot][pos].handle = frm->handle;
+	frame_table[parser.slot][pos].dlci   = frm->dlci;
+	fr = &frame_table[parser.slot][pos].frm;
 
 	data = malloc(fr->len + frm->len);
 	if (!data) {
@@ -206,9 +243,9 @@ uint8_t get_opcode(uint16_t handle, uint8_t dlci)
 	int i;
 
 	for (i = 0; i < FRAME_TABLE_SIZE; i++)
-		if (frame_table[i].handle == handle &&
-					frame_table[i].dlci == dlci)
-			return frame_table[i].opcode;
+		if (frame_table[parser.slot][i].handle == handle &&
+					frame_table[parser.slot][i].dlci == dlci)
+			return frame_table[parser.slot][i].opcode;
 
 	return 0x00;
 }
@@ -218,9 +255,9 @@ void set_opcode(uint16_t handle, uint8_t dlci, uint8_t opcode)
 	int i;
 
 	for (i = 0; i < FRAME_TABLE_SIZE; i++)
-		if (frame_table[i].handle == handle && 
-					frame_table[i].dlci == dlci) {
-			frame_table[i].opcode = opcode;
+		if (frame_table[parser.slot][i].handle == handle && 
+					frame_table[parser.slot][i].dlci == dlci) {
+			frame_table[parser.slot][i].opcode = opcode;
 			break;
 		}
 }
@@ -230,9 +267,9 @@ uint8_t get_status(uint16_t handle, uint8_t dlci)
 	int i;
 
 	for (i = 0; i < FRAME_TABLE_SIZE; i++)
-		if (frame_table[i].handle == handle &&
-					frame_table[i].dlci == dlci)
-			return frame_table[i].status;
+		if (frame_table[parser.slot][i].handle == handle &&
+					frame_table[parser.slot][i].dlci == dlci)
+			return frame_table[parser.slot][i].status;
 
 	return 0x00;
 }
@@ -242,9 +279,9 @@ void set_status(uint16_t handle, uint8_t dlci, uint8_t status)
 	int i;
 
 	for (i = 0; i < FRAME_TABLE_SIZE; i++)
-		if (frame_table[i].handle == handle &&
-					frame_table[i].dlci == dlci) {
-			frame_table[i].status = status;
+		if (frame_table[parser.slot][i].handle == handle &&
+					frame_table[parser.slot][i].dlci == dlci) {
+			frame_table[parser.slot][i].status = status;
 			break;
 		}
 }
@@ -33,6 +33,7 @@
 struct frame {
 	void		*data;
 	uint32_t	data_len;
+	uint32_t	orig_len;	/* Before truncation, if known */
 	void		*ptr;
 	uint32_t	len;
 	uint16_t	dev_id;
@@ -59,9 +60,21 @@ struct frame {
 #define DUMP_BPA	0x0010
 #define DUMP_TSTAMP	0x0100
 #define DUMP_VERBOSE	0x0200
+#define DUMP_DEVICE	0x0400
 #define DUMP_BTSNOOP	0x1000
 #define DUMP_PKTLOG	0x2000
 #define DUMP_NOVENDOR	0x4000
+#define DUMP_PROFILE	0x8000
+#define DUMP_LATENCY	0x10000
+#define DUMP_FLOW	0x20000
+#define DUMP_RATE	0x40000
+#define DUMP_ADV	0x80000
+#define DUMP_INQ	0x100000
+#define DUMP_AUDIO	0x200000
+#define DUMP_SCO	0x400000
+#define DUMP_A2DP	0x800000
+#define DUMP_MEDIA	0x1000000
+#define DUMP_ATT	0x2000000
 #define DUMP_TYPE_MASK	(DUMP_ASCII | DUMP_HEX | DUMP_EXT)
 
 /* Parser filter */
@@ -94,14 +107,22 @@ struct frame {
 
 #define DEFAULT_COMPID	65535
 
+/* Separate decoder state is kept for up to this many devices */
+#define DEVICE_SLOTS	16
+
+struct field_sink;
+
 struct parser_t {
 	unsigned long flags;
 	unsigned long filter;
 	unsigned short defpsm;
 	unsigned short defcompid;
 	int state;
+	int slot;
 	int pppdump_fd;
 	int audio_fd;
+	struct field_sink *sink;
+	bdaddr_t *bdaddr;	/* Only show data of this device */
 };
 
 extern struct parser_t parser;
@@ -110,6 +131,34 @@ void init_parser(unsigned long flags, unsigned long filter,
 		unsigned short defpsm, unsigned short defcompid,
 		int pppdump_fd, int audio_fd);
 
+void set_device(uint16_t dev_id);
+
+#define CONN_NAME_SIZE	249
+
+/* Link type used for LE connections */
+#define LINK_TYPE_LE	0x80
+
+struct conn_info {
+	uint16_t	handle;
+	uint8_t		active;
+	uint8_t		link_type;
+	uint8_t		role;		/* 0xff while unknown */
+	uint8_t		encrypt;
+	bdaddr_t	bdaddr;
+	char		addr[18];
+	char		name[CONN_NAME_SIZE];
+};
+
+struct conn_info *conn_get(uint16_t handle);
+const bdaddr_t *conn_local(void);
+void conn_update(uint8_t event, void *ptr, int len);
+int __conn_filtered(uint16_t handle);
+
+static inline int p_conn_filter(uint16_t handle)
+{
+	return parser.bdaddr && __conn_filtered(handle);
+}
+
 static inline int p_filter(unsigned long f)
 {
 	return !(parser.filter & f);
@@ -134,6 +183,8 @@ static inline void p_indent(int level, struct frame *f)
 			} else
 				printf("%8lu.%06lu ", f->ts.tv_sec, f->ts.tv_usec);
 		}
+		if (parser.flags & DUMP_DEVICE)
+			printf("hci%d ", f->dev_id);
 		printf("%c ", (f->in ? '>' : '<'));
 		parser.state = 1;
 	} else 
@@ -213,6 +264,244 @@ void set_status(uint16_t handle, uint8_t dlci, uint8_t status);
 
 void l2cap_clear(uint16_t handle);
 
+enum {
+	PROF_RECV,
+	PROF_READ,
+	PROF_DECODE,
+	PROF_OUTPUT,
+	PROF_WRITE,
+	PROF_HCI,
+	PROF_L2CAP,
+	PROF_RFCOMM,
+	PROF_SDP,
+	PROF_BNEP,
+	PROF_CMTP,
+	PROF_HIDP,
+	PROF_HCRP,
+	PROF_AVDTP,
+	PROF_AVCTP,
+	PROF_ATT,
+	PROF_OBEX,
+	PROF_CAPI,
+	PROF_PPP,
+	PROF_MAX
+};
+
+void prof_init(void);
+void prof_dump(FILE *out);
+void __prof_enter(int id);
+void __prof_leave(void);
+void __prof_count(uint32_t len);
+
+/* Set for the frames that are timed, one in PROF_SAMPLE */
+extern int prof_sample;
+
+static inline void prof_enter(int id)
+{
+	if (prof_sample)
+		__prof_enter(id);
+}
+
+static inline void prof_leave(void)
+{
+	if (prof_sample)
+		__prof_leave();
+}
+
+static inline void prof_count(uint32_t len)
+{
+	if (parser.flags & DUMP_PROFILE)
+		__prof_count(len);
+}
+
+#define PROF_CALL(id, call) do { prof_enter(id); call; prof_leave(); } while (0)
+
+void lat_dump(FILE *out);
+void __lat_frame(struct frame *frm);
+
+/* Latency histograms for other analyzers */
+struct lat_hist;
+struct lat_hist *lat_hist_new(void);
+void lat_hist_add(struct lat_hist *h, const struct timeval *start,
+						const struct timeval *end);
+void lat_line(FILE *out, const char *name, unsigned long count,
+				unsigned long open, struct lat_hist *h);
+
+static inline void lat_frame(struct frame *frm)
+{
+	if (parser.flags & DUMP_LATENCY)
+		__lat_frame(frm);
+}
+
+void flow_init(int fd);
+void flow_dump(FILE *out);
+void __flow_frame(struct frame *frm);
+
+static inline void flow_frame(struct frame *frm)
+{
+	if (parser.flags & DUMP_FLOW)
+		__flow_frame(frm);
+}
+
+void rate_init(int fd, int msec, int json);
+void rate_close(void);
+void __rate_frame(struct frame *frm);
+
+static inline void rate_frame(struct frame *frm)
+{
+	if (parser.flags & DUMP_RATE)
+		__rate_frame(frm);
+}
+
+void audio_init(const char *file);
+void audio_stats_init(void);
+void audio_dump(FILE *out);
+void audio_close(void);
+void __audio_frame(struct frame *frm);
+
+static inline void audio_frame(struct frame *frm)
+{
+	if (parser.flags & (DUMP_AUDIO | DUMP_SCO))
+		__audio_frame(frm);
+}
+
+void att_stats_init(int sec);
+void att_stats_frame(struct frame *frm);
+void att_stats_disconnect(uint16_t handle);
+void att_stats_dump(FILE *out);
+
+void gatt_frame(struct frame *frm);
+const char *gatt_name(uint8_t slot, uint16_t handle, uint16_t attr,
+								int remote);
+
+void a2dp_init(int fd);
+void a2dp_extract_init(const char *base);
+void a2dp_frame(struct frame *frm);
+int a2dp_media_dump(int level, struct frame *frm);
+void a2dp_channel_close(uint16_t handle, uint16_t cid, int in);
+void a2dp_disconnect(uint16_t handle);
+void a2dp_dump(FILE *out);
+void a2dp_close(void);
+
+struct adv_stats {
+	uint32_t	count;
+	uint32_t	rssi_count;	/* Reports that carried an RSSI */
+	int8_t		rssi_min;
+	int8_t		rssi_max;
+	int64_t		rssi_sum;
+	uint64_t	last;		/* Last seen in usec */
+};
+
+void adv_init(int msec);
+void adv_dump(FILE *out);
+struct adv_stats *adv_get(const bdaddr_t *ba, uint8_t type, uint8_t evt_type);
+int __adv_skip(struct frame *frm);
+
+static inline int adv_skip(struct frame *frm)
+{
+	return (parser.flags & DUMP_ADV) && __adv_skip(frm);
+}
+
+#define INQ_NO_RSSI	128
+
+struct inq_entry {
+	uint8_t		used;
+	uint8_t		slot;		/* Device slot */
+	uint8_t		has_rssi;
+	uint8_t		has_eir;
+	uint8_t		decoded;	/* EIR was printed */
+	bdaddr_t	bdaddr;
+	uint8_t		dev_class[3];
+	int8_t		rssi;		/* Of the latest response */
+	uint32_t	eir_hash;
+	uint32_t	eir_decoded;	/* Hash of the EIR last printed */
+	uint32_t	eir_changes;
+	uint32_t	count;
+	uint64_t	first;		/* First and last seen in usec */
+	uint64_t	last;
+	uint64_t	shown;
+};
+
+void inq_init(int msec);
+void inq_dump(FILE *out);
+struct inq_entry *inq_get(const bdaddr_t *ba);
+int __inq_skip(struct frame *frm);
+
+static inline int inq_skip(struct frame *frm)
+{
+	return (parser.flags & DUMP_INQ) && __inq_skip(frm);
+}
+
+/*
+ * Structured output. With a sink set the dissectors skip the text
+ * output and hand each frame over as layers of named fields.
+ */
+struct field_sink {
+	void (*begin)(struct frame *frm);
+	void (*layer)(const char *name);
+	void (*uint)(const char *name, uint32_t val, int size);
+	void (*str)(const char *name, const char *val);
+	void (*bdaddr)(const char *name, const bdaddr_t *ba);
+	void (*uuid)(const char *name, const void *uuid, int size);
+	void (*bytes)(const char *name, const void *data, int len);
+	void (*end)(struct frame *frm);
+};
+
+extern struct field_sink json_sink;
+extern struct field_sink binary_sink;
+extern struct field_sink summary_sink;
+extern struct field_sink extract_sink;
+
+extern const char *hci_field_names[];
+extern const char *l2cap_field_names[];
+extern const char *rfcomm_field_names[];
+extern const char *sdp_field_names[];
+extern const char *att_field_names[];
+extern const char *avdtp_field_names[];
+
+unsigned long extract_init(char *fields, int csv);
+
+static inline void f_layer(const char *name)
+{
+	parser.sink->layer(name);
+}
+
+static inline void f_u8(const char *name, uint8_t val)
+{
+	parser.sink->uint(name, val, 1);
+}
+
+static inline void f_u16(const char *name, uint16_t val)
+{
+	parser.sink->uint(name, val, 2);
+}
+
+static inline void f_u32(const char *name, uint32_t val)
+{
+	parser.sink->uint(name, val, 4);
+}
+
+static inline void f_str(const char *name, const char *val)
+{
+	parser.sink->str(name, val);
+}
+
+static inline void f_bdaddr(const char *name, const bdaddr_t *ba)
+{
+	parser.sink->bdaddr(name, ba);
+}
+
+/* UUIDs of 2, 4 or 16 bytes in big endian order */
+static inline void f_uuid(const char *name, const void *uuid, int size)
+{
+	parser.sink->uuid(name, uuid, size);
+}
+
+static inline void f_bytes(const char *name, const void *data, int len)
+{
+	parser.sink->bytes(name, data, len);
+}
+
 void ascii_dump(int level, struct frame *frm, int num);
 void hex_dump(int level, struct frame *frm, int num);
 void ext_dump(int level, struct frame *frm, int num);
@@ -221,6 +510,7 @@ void raw_ndump(int level, struct frame *frm, int num);
 
 void lmp_dump(int level, struct frame *frm);
 void hci_dump(int level, struct frame *frm);
+char *hci_cmd2str(uint16_t opcode);
 void l2cap_dump(int level, struct frame *frm);
 void rfcomm_dump(int level, struct frame *frm);
 void sdp_dump(int level, struct frame *frm);
@@ -241,14 +531,40 @@ void ericsson_dump(int level, struct frame *frm);
 void csr_dump(int level, struct frame *frm);
 void bpa_dump(int level, struct frame *frm);
 
+/* Link types of the side channel captures */
+#define DLT_EN10MB		1
+#define DLT_PPP_WITH_DIR	204
+
+FILE *pcap_open(int fd, uint32_t linktype);
+void pcap_write(FILE *f, const struct timeval *ts, const void *hdr,
+				int hdr_len, const void *data, int len);
+void pcap_close(void);
+
+void bnep_pcap_init(int fd);
+void ppp_pcap_init(int fd);
+void ppp_close(void);
+void obex_extract_init(const char *base);
+void obex_close(void);
+
 static inline void parse(struct frame *frm)
 {
+	set_device(frm->dev_id);
+	if (adv_skip(frm) || inq_skip(frm))
+		return;
+
+	prof_enter(PROF_DECODE);
 	p_indent(-1, NULL);
-	if (parser.flags & DUMP_RAW)
+	if (parser.sink) {
+		parser.sink->begin(frm);
+		PROF_CALL(PROF_HCI, hci_dump(0, frm));
+		parser.sink->end(frm);
+	} else if (parser.flags & DUMP_RAW)
 		raw_dump(0, frm);
 	else
-		hci_dump(0, frm);
-	fflush(stdout);
+		PROF_CALL(PROF_HCI, hci_dump(0, frm));
+	prof_leave();
+
+	PROF_CALL(PROF_OUTPUT, fflush(stdout));
 }
 
 #endif /* __PARSER_H */
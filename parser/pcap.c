@@ -0,0 +1,134 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "parser.h"
+
+#define PCAP_BUF_SIZE	65536
+#define MAX_FILES	4
+
+/* Side channel captures are written in host byte order */
+struct pcap_file_hdr {
+	uint32_t	magic;
+	uint16_t	version_major;
+	uint16_t	version_minor;
+	int32_t		thiszone;
+	uint32_t	sigfigs;
+	uint32_t	snaplen;
+	uint32_t	network;
+} __attribute__ ((packed));
+
+struct pcap_rec_hdr {
+	uint32_t	ts_sec;
+	uint32_t	ts_usec;
+	uint32_t	incl_len;
+	uint32_t	orig_len;
+} __attribute__ ((packed));
+
+static FILE *files[MAX_FILES];
+static int num_files = 0;
+
+FILE *pcap_open(int fd, uint32_t linktype)
+{
+	struct pcap_file_hdr hdr;
+	FILE *f;
+
+	if (num_files == MAX_FILES) {
+		fprintf(stderr, "Too many capture files\n");
+		exit(1);
+	}
+
+	f = fdopen(fd, "w");
+	if (!f) {
+		perror("Can't open capture file");
+		exit(1);
+	}
+
+	setvbuf(f, NULL, _IOFBF, PCAP_BUF_SIZE);
+
+	hdr.magic         = 0xa1b2c3d4;
+	hdr.version_major = 2;
+	hdr.version_minor = 4;
+	hdr.thiszone      = 0;
+	hdr.sigfigs       = 0;
+	hdr.snaplen       = 65535;
+	hdr.network       = linktype;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) {
+		perror("Write error");
+		exit(1);
+	}
+
+	files[num_files++] = f;
+
+	return f;
+}
+
+/*
+ * A packet is a header the caller rebuilt plus a payload that is taken
+ * straight from the reassembled frame, so nothing is copied on the way
+ * but into the stream buffer.
+ */
+void pcap_write(FILE *f, const struct timeval *ts, const void *hdr,
+				int hdr_len, const void *data, int len)
+{
+	struct pcap_rec_hdr rec;
+	int failed = ferror(f);
+
+	rec.ts_sec   = ts->tv_sec;
+	rec.ts_usec  = ts->tv_usec;
+	rec.incl_len = hdr_len + len;
+	rec.orig_len = hdr_len + len;
+
+	/* The error indicator stays set, so a full disk is told only once */
+	if ((fwrite(&rec, sizeof(rec), 1, f) != 1 ||
+			(hdr_len > 0 && fwrite(hdr, hdr_len, 1, f) != 1) ||
+			(len > 0 && fwrite(data, len, 1, f) != 1)) && !failed)
+		perror("Write error");
+}
+
+void pcap_close(void)
+{
+	int i;
+
+	for (i = 0; i < num_files; i++) {
+		int failed = ferror(files[i]);
+
+		if (fclose(files[i]) < 0 && !failed)
+			perror("Write error");
+	}
+
+	num_files = 0;
+}
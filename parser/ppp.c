@@ -129,29 +129,63 @@ static void hdlc_dump(int level, struct frame *frm)
 	raw_dump(level + 1, frm);
 }
 
+/* Unescaped frames, kept around since every HDLC frame needs one */
+static unsigned char *unslip_buf = NULL;
+static int unslip_size = 0;
+
+static FILE *ppp_pcap = NULL;
+
+void ppp_pcap_init(int fd)
+{
+	ppp_pcap = pcap_open(fd, DLT_PPP_WITH_DIR);
+}
+
 static inline void unslip_frame(int level, struct frame *frm, int len)
 {
 	struct frame msg;
-	unsigned char *data, *ptr;
-	int i, p = 0;
+	unsigned char *ptr = frm->ptr, *esc;
+	int n, p = 0;
 
-	data = malloc(len * 2);
-	if (!data)
-		return;
+	if (len > unslip_size) {
+		unsigned char *data = realloc(unslip_buf, len);
 
-	ptr = frm->ptr;
+		if (!data)
+			return;
 
-	for (i = 0; i < len; i++) {
-		if (ptr[i] == 0x7d) {
-			data[p++] = ptr[i + 1] ^ 0x20;
-			i++;
-		} else
-			data[p++] = ptr[i];
+		unslip_buf  = data;
+		unslip_size = len;
 	}
 
+	/* Copy the runs between escapes instead of byte by byte */
+	while (len > 0) {
+		esc = memchr(ptr, 0x7d, len);
+		n = esc ? esc - ptr : len;
+
+		memcpy(unslip_buf + p, ptr, n);
+		p += n;
+		ptr += n;
+		len -= n;
+
+		if (len >= 2)
+			unslip_buf[p++] = ptr[1] ^ 0x20;
+
+		ptr += 2;
+		len -= 2;
+	}
+
+	/* Without the FCS, direction 0 is received */
+	if (ppp_pcap && p > 2) {
+		uint8_t dir = frm->in ? 0x00 : 0x01;
+
+		pcap_write(ppp_pcap, &frm->ts, &dir, 1, unslip_buf, p - 2);
+	}
+
+	if (parser.sink)
+		return;
+
 	memset(&msg, 0, sizeof(msg));
-	msg.data     = data;
-	msg.data_len = len * 2;
+	msg.data     = unslip_buf;
+	msg.data_len = unslip_size;
 	msg.ptr      = msg.data;
 	msg.len      = p;
 	msg.in       = frm->in;
@@ -160,39 +194,101 @@ static inline void unslip_frame(int level, struct frame *frm, int len)
 	msg.cid      = frm->cid;
 
 	hdlc_dump(level, &msg);
+}
+
+static FILE *pppdump = NULL;
+static uint32_t pppdump_time;	/* In tenths of a second */
 
-	free(data);
+static inline void put_be32(uint8_t *p, uint32_t val)
+{
+	p[0] = val >> 24;
+	p[1] = val >> 16;
+	p[2] = val >> 8;
+	p[3] = val;
+}
+
+/*
+ * Records in pppdump format: the start time, then time steps in tenths
+ * of a second whenever the clock moved, then the data of each direction.
+ */
+static void pppdump_write(struct frame *frm)
+{
+	uint32_t now = frm->ts.tv_sec * 10 + frm->ts.tv_usec / 100000;
+	uint8_t hdr[8];
+	int n = 0;
+
+	if (!pppdump) {
+		pppdump = fdopen(frm->pppdump_fd, "w");
+		if (!pppdump) {
+			perror("Can't open pppdump file");
+			exit(1);
+		}
+
+		setvbuf(pppdump, NULL, _IOFBF, 65536);
+
+		hdr[n++] = 0x05;
+		put_be32(hdr + n, frm->ts.tv_sec);
+		n += 4;
+		pppdump_time = now;
+	} else if (now - pppdump_time < 0x100) {
+		if (now != pppdump_time) {
+			hdr[n++] = 0x07;
+			hdr[n++] = now - pppdump_time;
+		}
+		pppdump_time = now;
+	} else if (now > pppdump_time) {
+		hdr[n++] = 0x06;
+		put_be32(hdr + n, now - pppdump_time);
+		n += 4;
+		pppdump_time = now;
+	}
+
+	fwrite(hdr, n, 1, pppdump);
+
+	hdr[0] = frm->in ? 0x02 : 0x01;
+	hdr[1] = frm->len >> 8;
+	hdr[2] = frm->len;
+
+	fwrite(hdr, 3, 1, pppdump);
+	fwrite(frm->ptr, frm->len, 1, pppdump);
+}
+
+void ppp_close(void)
+{
+	if (pppdump)
+		fclose(pppdump);
+
+	pppdump = NULL;
 }
 
 void ppp_dump(int level, struct frame *frm)
 {
 	void *ptr, *end;
-	int err, len, pos = 0;
+	int len, pos = 0;
 
-	if (frm->pppdump_fd > fileno(stderr)) {
-		unsigned char id;
-		uint16_t len = htons(frm->len);
-		uint32_t ts = htonl(frm->ts.tv_sec & 0xffffffff);
+	if (frm->pppdump_fd > fileno(stderr))
+		pppdump_write(frm);
 
-		id = 0x07;
-		err = write(frm->pppdump_fd, &id, 1);
-		err = write(frm->pppdump_fd, &ts, 4);
+	if (parser.sink) {
+		f_layer("ppp");
+		f_u16("plen", frm->len);
 
-		id = frm->in ? 0x02 : 0x01;
-		err = write(frm->pppdump_fd, &id, 1);
-		err = write(frm->pppdump_fd, &len, 2);
-		err = write(frm->pppdump_fd, frm->ptr, frm->len);
+		/* The frames only need to be taken apart for the capture */
+		if (!ppp_pcap)
+			return;
 	}
 
 	if (!ppp_traffic) {
 		pos = check_for_ppp_traffic(frm->ptr, frm->len);
 		if (pos < 0) {
-			raw_dump(level, frm);
+			if (!parser.sink)
+				raw_dump(level, frm);
 			return;
 		}
 
 		if (pos > 0) {
-			raw_ndump(level, frm, pos);
+			if (!parser.sink)
+				raw_ndump(level, frm, pos);
 			frm->ptr += pos;
 			frm->len -= pos;
 		}
@@ -0,0 +1,263 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "parser.h"
+
+static char *prof_str[PROF_MAX] = {
+	"recv",
+	"read",
+	"decode",
+	"output",
+	"write",
+	"hci",
+	"l2cap",
+	"rfcomm",
+	"sdp",
+	"bnep",
+	"cmtp",
+	"hidp",
+	"hcrp",
+	"avdtp",
+	"avctp",
+	"att",
+	"obex",
+	"capi",
+	"ppp",
+};
+
+#define PROF_STACK_SIZE 16
+
+/* Reading the clock costs about as much as decoding a small frame */
+#define PROF_SAMPLE	64
+
+int prof_sample = 0;
+
+static struct {
+	uint64_t count;
+	uint64_t total;		/* inclusive nanoseconds */
+	uint64_t self;		/* exclusive nanoseconds */
+} prof_table[PROF_MAX];
+
+static struct {
+	int id;
+	uint64_t start;
+} prof_stack[PROF_STACK_SIZE];
+
+static int prof_depth = 0;
+static uint64_t prof_mark;
+
+/* Calls nested deeper than the stack, their time goes to the deepest */
+static uint64_t prof_dropped;
+
+/* Cost of reading the clock, to estimate what profiling itself costs */
+static uint64_t prof_reads;
+static double prof_clock_ns;
+
+static uint64_t prof_frames, prof_bytes;
+static uint64_t prof_sampled;
+static uint64_t prof_begin;
+
+static struct {
+	uint64_t time;
+	uint64_t frames;
+	uint64_t bytes;
+} prof_last;
+
+static inline uint64_t prof_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void prof_init(void)
+{
+	uint64_t start;
+	int i;
+
+	memset(prof_table, 0, sizeof(prof_table));
+	prof_depth = 0;
+	prof_frames = prof_bytes = 0;
+	prof_dropped = prof_reads = 0;
+	prof_sampled = 1;
+
+	start = prof_now();
+	for (i = 0; i < 1000; i++)
+		prof_now();
+	prof_clock_ns = (prof_now() - start) / 1001.0;
+
+	prof_begin = prof_now();
+	prof_last.time = prof_begin;
+	prof_last.frames = 0;
+	prof_last.bytes = 0;
+
+	prof_sample = 1;
+}
+
+void __prof_enter(int id)
+{
+	uint64_t now = prof_now();
+	int top = prof_depth < PROF_STACK_SIZE ? prof_depth : PROF_STACK_SIZE;
+
+	prof_reads++;
+
+	/* Charge the time so far to whoever is on top of the stack */
+	if (top > 0)
+		prof_table[prof_stack[top - 1].id].self += now - prof_mark;
+
+	if (prof_depth < PROF_STACK_SIZE) {
+		prof_stack[prof_depth].id = id;
+		prof_stack[prof_depth].start = now;
+	} else
+		prof_dropped++;
+
+	prof_depth++;
+	prof_mark = now;
+}
+
+void __prof_leave(void)
+{
+	uint64_t now = prof_now();
+	int id;
+
+	prof_reads++;
+
+	if (prof_depth <= 0)
+		return;
+
+	prof_depth--;
+
+	if (prof_depth >= PROF_STACK_SIZE) {
+		id = prof_stack[PROF_STACK_SIZE - 1].id;
+		prof_table[id].self += now - prof_mark;
+		prof_mark = now;
+		return;
+	}
+
+	id = prof_stack[prof_depth].id;
+
+	prof_table[id].count++;
+	prof_table[id].total += now - prof_stack[prof_depth].start;
+	prof_table[id].self += now - prof_mark;
+
+	prof_mark = now;
+}
+
+/*
+ * Called for every frame before it is decoded. Only every PROF_SAMPLE
+ * frame is timed, from here to the same point of the next frame, and
+ * the report is scaled up. The stack has to be empty to switch.
+ */
+void __prof_count(uint32_t len)
+{
+	prof_frames++;
+	prof_bytes += len;
+
+	if (prof_depth)
+		return;
+
+	prof_sample = !(prof_frames % PROF_SAMPLE);
+	if (prof_sample)
+		prof_sampled++;
+}
+
+static void prof_line(FILE *out, int id, uint64_t ns, uint64_t elapsed,
+								double scale)
+{
+	uint64_t count = prof_table[id].count;
+
+	fprintf(out, "  %-8s %10.0f %12.3f %10.3f %6.2f%%\n", prof_str[id],
+		count * scale, ns * scale / 1000000.0,
+		count ? ns / 1000.0 / count : 0.0,
+		elapsed ? ns * scale * 100.0 / elapsed : 0.0);
+}
+
+void prof_dump(FILE *out)
+{
+	uint64_t now = prof_now();
+	uint64_t elapsed = now - prof_begin;
+	uint64_t interval = now - prof_last.time;
+	double secs = elapsed / 1000000000.0;
+	double isecs = interval / 1000000000.0;
+	double scale = prof_sampled ? (double) prof_frames / prof_sampled : 1.0;
+	int i;
+
+	fprintf(out, "profile: %llu frames %llu bytes in %.3fs "
+			"(%.1f frames/s %.1f bytes/s)\n",
+			(unsigned long long) prof_frames,
+			(unsigned long long) prof_bytes, secs,
+			secs > 0 ? prof_frames / secs : 0.0,
+			secs > 0 ? prof_bytes / secs : 0.0);
+
+	fprintf(out, "profile: last %.3fs %.1f frames/s %.1f bytes/s\n", isecs,
+			isecs > 0 ? (prof_frames - prof_last.frames) / isecs : 0.0,
+			isecs > 0 ? (prof_bytes - prof_last.bytes) / isecs : 0.0);
+
+	fprintf(out, "  %-8s %10s %12s %10s %7s\n",
+				"stage", "calls", "total ms", "avg us", "time");
+	for (i = 0; i < PROF_HCI; i++) {
+		if (prof_table[i].count)
+			prof_line(out, i, prof_table[i].total, elapsed, scale);
+	}
+
+	fprintf(out, "  %-8s %10s %12s %10s %7s\n",
+				"protocol", "calls", "self ms", "avg us", "time");
+	for (i = PROF_HCI; i < PROF_MAX; i++) {
+		if (prof_table[i].count)
+			prof_line(out, i, prof_table[i].self, elapsed, scale);
+	}
+
+	fprintf(out, "profile: 1 in %.0f frames timed, overhead %.2f%% "
+			"(%llu clock reads of %.0f ns)\n", scale,
+			elapsed ? prof_reads * prof_clock_ns * 100.0 / elapsed :
+									0.0,
+			(unsigned long long) prof_reads, prof_clock_ns);
+
+	if (prof_dropped)
+		fprintf(out, "profile: %llu calls nested deeper than %d "
+				"charged to their caller\n",
+				(unsigned long long) prof_dropped,
+				PROF_STACK_SIZE);
+
+	fflush(out);
+
+	prof_last.time = now;
+	prof_last.frames = prof_frames;
+	prof_last.bytes = prof_bytes;
+}
@@ -0,0 +1,278 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+
+#include "parser.h"
+
+/* Indexed directly by the 12 bit connection handle */
+#define CONN_SLOTS	4096
+
+struct rate_conn {
+	bdaddr_t	bdaddr;
+	uint8_t		known;		/* Address was seen */
+	uint8_t		sco;
+	uint8_t		touched;	/* Listed in this bucket */
+	uint32_t	bytes[2];	/* Per direction, 0 is out */
+	uint32_t	packets[2];
+};
+
+struct rate_dev {
+	uint16_t	dev_id;
+	int		count;		/* Handles touched in this bucket */
+	uint16_t	list[CONN_SLOTS];
+	struct rate_conn conn[CONN_SLOTS];
+};
+
+static struct rate_dev *rate_table[DEVICE_SLOTS];
+
+static FILE *rate_out;
+static int rate_json;
+static uint64_t interval;	/* Bucket size in microseconds */
+static uint64_t bucket;		/* Start of the current bucket */
+static int started = 0;
+
+static inline uint16_t get_le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+void rate_init(int fd, int msec, int json)
+{
+	rate_out = fdopen(fd, "w");
+	if (!rate_out) {
+		perror("Can't open rate file");
+		exit(1);
+	}
+
+	interval = (msec > 0 ? msec : 1000) * 1000ull;
+	rate_json = json;
+
+	if (!rate_json)
+		fprintf(rate_out, "time,dev,handle,bdaddr,type,dir,bytes,"
+				"packets,bytes_per_sec,packets_per_sec\n");
+}
+
+static struct rate_dev *get_dev(uint16_t dev_id)
+{
+	struct rate_dev *d;
+
+	set_device(dev_id);
+
+	d = rate_table[parser.slot];
+	if (!d) {
+		d = calloc(1, sizeof(*d));
+		if (!d) {
+			perror("Can't allocate rate table");
+			exit(1);
+		}
+		rate_table[parser.slot] = d;
+	}
+
+	d->dev_id = dev_id;
+
+	return d;
+}
+
+static void rate_row(struct rate_dev *d, uint16_t handle, int in)
+{
+	struct rate_conn *c = &d->conn[handle];
+	double secs = interval / 1000000.0;
+	char addr[18];
+
+	if (c->known)
+		p_ba2str(&c->bdaddr, addr);
+	else
+		addr[0] = '\0';
+
+	if (rate_json)
+		fprintf(rate_out, "{\"ts\":%llu.%06llu,\"dev\":%d,"
+			"\"handle\":%d,\"bdaddr\":\"%s\",\"type\":\"%s\","
+			"\"dir\":\"%s\",\"bytes\":%u,\"packets\":%u,"
+			"\"bytes_per_sec\":%.1f,\"packets_per_sec\":%.1f}\n",
+			(unsigned long long) (bucket / 1000000),
+			(unsigned long long) (bucket % 1000000),
+			d->dev_id, handle, addr, c->sco ? "sco" : "acl",
+			in ? "in" : "out", c->bytes[in], c->packets[in],
+			c->bytes[in] / secs, c->packets[in] / secs);
+	else
+		fprintf(rate_out, "%llu.%06llu,%d,%d,%s,%s,%s,%u,%u,%.1f,%.1f\n",
+			(unsigned long long) (bucket / 1000000),
+			(unsigned long long) (bucket % 1000000),
+			d->dev_id, handle, addr, c->sco ? "sco" : "acl",
+			in ? "in" : "out", c->bytes[in], c->packets[in],
+			c->bytes[in] / secs, c->packets[in] / secs);
+}
+
+/* Write out the handles that saw traffic in the bucket and clear them */
+static void rate_flush(void)
+{
+	int i, j, in;
+
+	for (i = 0; i < DEVICE_SLOTS; i++) {
+		struct rate_dev *d = rate_table[i];
+
+		if (!d)
+			continue;
+
+		for (j = 0; j < d->count; j++) {
+			struct rate_conn *c = &d->conn[d->list[j]];
+
+			for (in = 0; in < 2; in++) {
+				if (c->packets[in])
+					rate_row(d, d->list[j], in);
+				c->bytes[in] = 0;
+				c->packets[in] = 0;
+			}
+
+			c->touched = 0;
+		}
+
+		d->count = 0;
+	}
+
+	fflush(rate_out);
+}
+
+static void rate_count(struct rate_dev *d, uint16_t handle, int sco,
+							int in, int len)
+{
+	struct rate_conn *c = &d->conn[handle];
+
+	if (!c->touched) {
+		c->touched = 1;
+		d->list[d->count++] = handle;
+	}
+
+	c->sco = sco;
+	c->bytes[in] += len;
+	c->packets[in]++;
+}
+
+static void rate_connected(struct rate_dev *d, uint16_t handle,
+					const uint8_t *bdaddr, int sco)
+{
+	struct rate_conn *c = &d->conn[handle & 0x0fff];
+
+	memcpy(&c->bdaddr, bdaddr, 6);
+	c->known = 1;
+	c->sco = sco;
+}
+
+static void rate_event(struct rate_dev *d, const uint8_t *data, int len)
+{
+	uint8_t event = data[0];
+
+	data += 2;
+	len -= 2;
+
+	switch (event) {
+	case EVT_CONN_COMPLETE:
+		/* Link type 0 is SCO, 1 is ACL */
+		if (len >= 10 && !data[0])
+			rate_connected(d, get_le16(data + 1), data + 3,
+							data[9] != 0x01);
+		break;
+
+	case EVT_SYNC_CONN_COMPLETE:
+		if (len >= 9 && !data[0])
+			rate_connected(d, get_le16(data + 1), data + 3, 1);
+		break;
+
+	case EVT_LE_META_EVENT:
+		if (len >= 12 && data[0] == EVT_LE_CONN_COMPLETE && !data[1])
+			rate_connected(d, get_le16(data + 2), data + 6, 0);
+		break;
+	}
+}
+
+void __rate_frame(struct frame *frm)
+{
+	const uint8_t *data = frm->ptr;
+	int len = frm->len;
+	uint64_t now;
+	struct rate_dev *d;
+
+	if (len < 3)
+		return;
+
+	now = frm->ts.tv_sec * 1000000ull + frm->ts.tv_usec;
+
+	if (!started) {
+		bucket = now - now % interval;
+		started = 1;
+	} else if (now >= bucket + interval) {
+		rate_flush();
+		bucket = now - now % interval;
+	}
+
+	switch (data[0]) {
+	case HCI_EVENT_PKT:
+		d = get_dev(frm->dev_id);
+		rate_event(d, data + 1, len - 1);
+		break;
+
+	case HCI_ACLDATA_PKT:
+		if (len < HCI_ACL_HDR_SIZE + 1)
+			return;
+		d = get_dev(frm->dev_id);
+		rate_count(d, get_le16(data + 1) & 0x0fff, 0, !!frm->in,
+					frm->data_len - 1 - HCI_ACL_HDR_SIZE);
+		break;
+
+	case HCI_SCODATA_PKT:
+		if (len < HCI_SCO_HDR_SIZE + 1)
+			return;
+		d = get_dev(frm->dev_id);
+		rate_count(d, get_le16(data + 1) & 0x0fff, 1, !!frm->in,
+					frm->data_len - 1 - HCI_SCO_HDR_SIZE);
+		break;
+	}
+}
+
+void rate_close(void)
+{
+	if (!rate_out)
+		return;
+
+	if (started)
+		rate_flush();
+
+	fclose(rate_out);
+	rate_out = NULL;
+}
@@ -275,7 +275,7 @@ static inline void uih_frame(int level, struct frame *frm, long_frame_head *head
 			switch (proto) {
 			case SDP_UUID_OBEX:
 				if (!p_filter(FILT_OBEX))
-					obex_dump(level + 1, frm);
+					PROF_CALL(PROF_OBEX, obex_dump(level + 1, frm));
 				else
 					raw_dump(level, frm);
 				break;
@@ -283,7 +283,7 @@ static inline void uih_frame(int level, struct frame *frm, long_frame_head *head
 			case SDP_UUID_LAN_ACCESS_PPP:
 			case SDP_UUID_DIALUP_NETWORKING:
 				if (!p_filter(FILT_PPP))
-					ppp_dump(level + 1, frm);
+					PROF_CALL(PROF_PPP, ppp_dump(level + 1, frm));
 				else
 					raw_dump(level, frm);
 				break;
@@ -299,6 +299,125 @@ static inline void uih_frame(int level, struct frame *frm, long_frame_head *head
 	}
 }
 
+static char *frame2str(uint8_t type)
+{
+	switch (type) {
+	case SABM:
+		return "SABM";
+	case UA:
+		return "UA";
+	case DM:
+		return "DM";
+	case DISC:
+		return "DISC";
+	case UIH:
+		return "UIH";
+	default:
+		return "ERR";
+	}
+}
+
+static char *mcc2str(uint8_t type)
+{
+	switch (type) {
+	case PN:
+		return "PN";
+	case PSC:
+		return "PSC";
+	case CLD:
+		return "CLD";
+	case TEST:
+		return "TEST";
+	case FCON:
+		return "FCON";
+	case FCOFF:
+		return "FCOFF";
+	case MSC:
+		return "MSC";
+	case NSC:
+		return "NSC";
+	case RPN:
+		return "RPN";
+	case RLS:
+		return "RLS";
+	case SNC:
+		return "SNC";
+	default:
+		return "Unknown";
+	}
+}
+
+/* Fields reported by the structured output */
+const char *rfcomm_field_names[] = {
+	"frame", "dlci", "cr", "pf", "ilen", "mcc", "mcc_cr",
+	"credits", "channel", NULL
+};
+
+/* Structured counterpart of rfcomm_dump() */
+static void rfcomm_fields(struct frame *frm, long_frame_head *head)
+{
+	uint8_t ctr_type = CLR_PF(head->control);
+	int show = !p_filter(FILT_RFCOMM);
+	uint32_t proto;
+
+	if (show) {
+		f_layer("rfcomm");
+		f_str("frame", frame2str(ctr_type));
+		f_u8("dlci", GET_DLCI(head->addr));
+		f_u8("cr", head->addr.cr);
+		f_u8("pf", GET_PF(head->control));
+		f_u16("ilen", head->length.bits.len);
+	}
+
+	if (ctr_type == DISC)
+		del_frame(frm->handle, GET_DLCI(head->addr));
+
+	if (ctr_type != UIH)
+		return;
+
+	if (!head->addr.server_chn) {
+		mcc_short_frame_head *mcc = frm->ptr;
+
+		if (show && frm->len > 0) {
+			f_str("mcc", mcc2str(mcc->type.type));
+			f_u8("mcc_cr", mcc->type.cr);
+		}
+		return;
+	}
+
+	if (GET_PF(head->control)) {
+		if (show)
+			f_u8("credits", *(uint8_t *) frm->ptr);
+		frm->ptr++;
+		frm->len--;
+	}
+
+	frm->len--;
+	frm->dlci = GET_DLCI(head->addr);
+	frm->channel = head->addr.server_chn;
+
+	if (show)
+		f_u8("channel", frm->channel);
+
+	if ((int) frm->len <= 0)
+		return;
+
+	proto = get_proto(frm->handle, RFCOMM_PSM, frm->channel);
+
+	switch (proto) {
+	case SDP_UUID_OBEX:
+		if (!p_filter(FILT_OBEX))
+			PROF_CALL(PROF_OBEX, obex_dump(0, frm));
+		break;
+
+	case SDP_UUID_LAN_ACCESS_PPP:
+	case SDP_UUID_DIALUP_NETWORKING:
+		if (!p_filter(FILT_PPP))
+			PROF_CALL(PROF_PPP, ppp_dump(0, frm));
+		break;
+	}
+}
+
 void rfcomm_dump(int level, struct frame *frm)
 {
 	uint8_t hdr_size, ctr_type;
@@ -319,6 +438,11 @@ void rfcomm_dump(int level, struct frame *frm)
 	frm->ptr += hdr_size;
 	frm->len -= hdr_size;
 
+	if (parser.sink) {
+		rfcomm_fields(frm, &head);
+		return;
+	}
+
 	ctr_type = CLR_PF(head.control);
 
 	if (ctr_type == UIH) {
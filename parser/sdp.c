@@ -605,7 +605,7 @@ static char *pid2str(uint8_t pid)
 
 #define FRAME_TABLE_SIZE 10
 
-static struct frame frame_table[FRAME_TABLE_SIZE];
+static struct frame frame_table[DEVICE_SLOTS][FRAME_TABLE_SIZE];
 
 static int frame_add(struct frame *frm, int count)
 {
@@ -614,13 +614,13 @@ static int frame_add(struct frame *frm, int count)
 	register int i, len = 0, pos = -1;
 
 	for (i = 0; i < FRAME_TABLE_SIZE; i++) {
-		if (frame_table[i].handle == frm->handle &&
-				frame_table[i].cid == frm->cid) {
+		if (frame_table[parser.slot][i].handle == frm->handle &&
+				frame_table[parser.slot][i].cid == frm->cid) {
 			pos = i;
-			len = frame_table[i].data_len;
+			len = frame_table[parser.slot][i].data_len;
 			break;
 		}
-		if (pos < 0 && !frame_table[i].handle)
+		if (pos < 0 && !frame_table[parser.slot][i].handle)
 			pos = i;
 	}
 
@@ -631,7 +631,7 @@ static int frame_add(struct frame *frm, int count)
 	if (!data)
 		return -ENOMEM;
 
-	fr = &frame_table[pos];
+	fr = &frame_table[parser.slot][pos];
 
 	if (len > 0) {
 		memcpy(data, fr->data, len);
@@ -667,9 +667,194 @@ static struct frame *frame_get(struct frame *frm, int count)
 	if (pos < 0)
 		return frm;
 
-	frame_table[pos].handle = 0;
+	frame_table[parser.slot][pos].handle = 0;
 
-	return &frame_table[pos];
+	return &frame_table[parser.slot][pos];
+}
+
+/*
+ * Walk a data element the way print_de() does, only to pick up the
+ * protocol mappings of a Protocol Descriptor List.
+ */
+static void scan_de(struct frame *frm, uint16_t *psm, uint8_t *channel)
+{
+	uint32_t uuid;
+	int n = 0, len;
+	uint8_t de_type = parse_de_hdr(frm, &n);
+
+	switch (de_type) {
+	case SDP_DE_UINT:
+		if (n == 1 && *channel == 0)
+			*channel = get_u8(frm);
+		else if (n == 2 && *psm == 0)
+			*psm = get_u16(frm);
+		else {
+			frm->ptr += n;
+			frm->len -= n;
+		}
+		break;
+	case SDP_DE_UUID:
+		if (n == 2)
+			uuid = get_u16(frm);
+		else if (n == 4)
+			uuid = get_u32(frm);
+		else {
+			frm->ptr += n;
+			frm->len -= n;
+			break;
+		}
+
+		if (*psm > 0 && *psm != 0xffff) {
+			set_proto(frm->handle, *psm, 0, uuid);
+			*psm = 0xffff;
+		}
+
+		if (*channel > 0 && *channel != 0xff) {
+			set_proto(frm->handle, *psm, *channel, uuid);
+			*channel = 0xff;
+		}
+		break;
+	case SDP_DE_SEQ:
+	case SDP_DE_ALT:
+		len = frm->len;
+		while (len - (int) frm->len < n && (int) frm->len > 0)
+			scan_de(frm, psm, channel);
+		break;
+	default:
+		frm->ptr += n;
+		frm->len -= n;
+		break;
+	}
+}
+
+static void scan_attr_list(struct frame *frm)
+{
+	uint16_t attr_id, psm;
+	uint8_t channel;
+	int len, n1 = 0, n2 = 0;
+
+	if (parse_de_hdr(frm, &n1) != SDP_DE_SEQ)
+		return;
+
+	len = frm->len;
+	while (len - (int) frm->len < n1 && (int) frm->len > 0) {
+		if (parse_de_hdr(frm, &n2) != SDP_DE_UINT || n2 != 2)
+			return;
+
+		attr_id = get_u16(frm);
+
+		if (attr_id != SDP_ATTR_ID_PROTOCOL_DESCRIPTOR_LIST) {
+			/* Skip the attribute value */
+			int n = 0;
+			parse_de_hdr(frm, &n);
+			frm->ptr += n;
+			frm->len -= n;
+			continue;
+		}
+
+		psm = 0;
+		channel = 0;
+		scan_de(frm, &psm, &channel);
+	}
+}
+
+static void scan_attr_lists(struct frame *frm)
+{
+	int n = 0;
+	int count = frm->len;
+
+	if (parse_de_hdr(frm, &n) != SDP_DE_SEQ)
+		return;
+
+	while (count - (int) frm->len < n && (int) frm->len > 0)
+		scan_attr_list(frm);
+}
+
+/* First UUID of a service search pattern */
+static void scan_pattern(struct frame *frm)
+{
+	int n = 0;
+
+	if (parse_de_hdr(frm, &n) != SDP_DE_SEQ)
+		return;
+
+	if (parse_de_hdr(frm, &n) != SDP_DE_UUID || (int) frm->len < n)
+		return;
+
+	if (n == 2 || n == 4 || n == 16)
+		f_uuid("uuid", frm->ptr, n);
+
+	frm->ptr += n;
+	frm->len -= n;
+}
+
+/* Fields reported by the structured output */
+const char *sdp_field_names[] = {
+	"pdu", "name", "tid", "plen", "uuid", "code", "total", "count",
+	"handle", "cont", NULL
+};
+
+/* Structured counterpart of sdp_dump() */
+static void sdp_fields(sdp_pdu_hdr *hdr, struct frame *frm)
+{
+	uint16_t count;
+	uint8_t cont;
+
+	f_layer("sdp");
+	f_u8("pdu", hdr->pid);
+	f_str("name", pid2str(hdr->pid));
+	f_u16("tid", ntohs(hdr->tid));
+	f_u16("plen", ntohs(hdr->len));
+
+	switch (hdr->pid) {
+	case SDP_ERROR_RSP:
+		if (frm->len >= 2)
+			f_u16("code", get_u16(frm));
+		break;
+
+	case SDP_SERVICE_SEARCH_REQ:
+	case SDP_SERVICE_SEARCH_ATTR_REQ:
+		scan_pattern(frm);
+		break;
+
+	case SDP_SERVICE_SEARCH_RSP:
+		if (frm->len >= 4) {
+			f_u16("total", get_u16(frm));
+			f_u16("count", get_u16(frm));
+		}
+		break;
+
+	case SDP_SERVICE_ATTR_REQ:
+		if (frm->len >= 4)
+			f_u32("handle", get_u32(frm));
+		break;
+
+	case SDP_SERVICE_ATTR_RSP:
+	case SDP_SERVICE_SEARCH_ATTR_RSP:
+		if (frm->len < 2)
+			break;
+
+		count = get_u16(frm);
+		f_u16("count", count);
+
+		if (count >= frm->len)
+			break;
+
+		/* Reassemble like the text output does */
+		cont = *(unsigned char *)(frm->ptr + count);
+		f_u8("cont", cont);
+
+		if (cont) {
+			frame_add(frm, count);
+			break;
+		}
+
+		if (hdr->pid == SDP_SERVICE_ATTR_RSP)
+			scan_attr_list(frame_get(frm, count));
+		else
+			scan_attr_lists(frame_get(frm, count));
+		break;
+	}
 }
 
 void sdp_dump(int level, struct frame *frm)
@@ -683,6 +868,11 @@ void sdp_dump(int level, struct frame *frm)
 	frm->ptr += SDP_PDU_HDR_SIZE;
 	frm->len -= SDP_PDU_HDR_SIZE;
 
+	if (parser.sink) {
+		sdp_fields(hdr, frm);
+		return;
+	}
+
 	p_indent(level, frm);
 	printf("SDP %s: tid 0x%x len 0x%x\n", pid2str(hdr->pid), tid, len);
 
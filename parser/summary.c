@@ -0,0 +1,281 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "parser.h"
+
+#define MAX_FIELDS	16
+
+/*
+ * Only the innermost layer makes it into the summary, so the fields
+ * are just remembered and the line is formatted once per frame.
+ */
+static struct {
+	int		depth;
+	const char	*type;		/* HCI packet type */
+	uint32_t	handle;
+	int		has_handle;
+	const char	*layer;
+	const char	*name;
+	const char	*command;
+	int		count;
+	struct {
+		const char	*name;
+		uint32_t	val;
+	} field[MAX_FIELDS];
+} sum;
+
+/* Fields worth showing, in the order they are shown */
+static const struct {
+	const char	*name;
+	const char	*label;
+	int		hex;
+} sum_fields[] = {
+	{ "handle",	"h",		0 },
+	{ "cid",	"cid",		4 },
+	{ "scid",	"scid",		4 },
+	{ "dcid",	"dcid",		4 },
+	{ "psm",	"psm",		0 },
+	{ "dlci",	"dlci",		0 },
+	{ "channel",	"ch",		0 },
+	{ "acp_seid",	"seid",		0 },
+	{ "seqn",	"seq",		0 },
+	{ "tid",	"tid",		0 },
+	{ "mtu",	"mtu",		0 },
+	{ "offset",	"off",		0 },
+	{ "status",	"status",	2 },
+	{ "reason",	"reason",	2 },
+	{ "result",	"result",	0 },
+	{ "error",	"err",		2 },
+	{ "dlen",	"dlen",		0 },
+	{ "value",	"vlen",		0 },
+	{ }
+};
+
+static void sum_begin(struct frame *frm)
+{
+	sum.depth = 0;
+	sum.type = NULL;
+	sum.has_handle = 0;
+}
+
+static void sum_layer(const char *name)
+{
+	sum.depth++;
+	sum.layer = name;
+	sum.name = NULL;
+	sum.command = NULL;
+	sum.count = 0;
+}
+
+static void sum_uint(const char *name, uint32_t val, int size)
+{
+	if (sum.depth == 1 && !strcmp(name, "handle")) {
+		sum.handle = val;
+		sum.has_handle = 1;
+	}
+
+	if (sum.count < MAX_FIELDS) {
+		sum.field[sum.count].name = name;
+		sum.field[sum.count].val = val;
+		sum.count++;
+	}
+}
+
+static void sum_str(const char *name, const char *val)
+{
+	if (!strcmp(name, "name"))
+		sum.name = val;
+	else if (!strcmp(name, "command"))
+		sum.command = val;
+	else if (sum.depth == 1 && !strcmp(name, "type"))
+		sum.type = val;
+}
+
+static void sum_bdaddr(const char *name, const bdaddr_t *ba)
+{
+}
+
+static void sum_uuid(const char *name, const void *uuid, int size)
+{
+}
+
+static void sum_bytes(const char *name, const void *data, int len)
+{
+	sum_uint(name, len, 2);
+}
+
+static const char *type2str(const char *type)
+{
+	if (!type)
+		return "???";
+	if (!strcmp(type, "command"))
+		return "CMD";
+	if (!strcmp(type, "event"))
+		return "EVT";
+	if (!strcmp(type, "acl"))
+		return "ACL";
+	if (!strcmp(type, "sco"))
+		return "SCO";
+	if (!strcmp(type, "vendor"))
+		return "VND";
+	return "???";
+}
+
+static char line[512];
+static int line_len;
+
+static const char hex[] = "0123456789abcdef";
+
+/* Every writer goes through here, the last byte is kept for the newline */
+static inline void put_char(char c)
+{
+	if (line_len < (int) sizeof(line) - 1)
+		line[line_len++] = c;
+}
+
+static void put_str(const char *str)
+{
+	while (*str)
+		put_char(*str++);
+}
+
+static void put_uint(uint32_t val)
+{
+	char tmp[10];
+	int n = 0;
+
+	do {
+		tmp[n++] = '0' + val % 10;
+		val /= 10;
+	} while (val);
+
+	while (n > 0)
+		put_char(tmp[--n]);
+}
+
+static void put_hex(uint32_t val, int digits)
+{
+	put_char('0');
+	put_char('x');
+
+	while (digits-- > 0)
+		put_char(hex[(val >> (digits * 4)) & 0x0f]);
+}
+
+static void sum_end(struct frame *frm)
+{
+	uint32_t usec = frm->ts.tv_usec;
+	int i, j, link;
+
+	link = sum.has_handle && sum.type &&
+				(sum.type[0] == 'a' || sum.type[0] == 's');
+
+	line_len = 0;
+	put_uint(frm->ts.tv_sec);
+	put_char('.');
+	for (i = 100000; i > 0; i /= 10)
+		put_char('0' + usec / i % 10);
+
+	put_str(" hci");
+	put_uint(frm->dev_id);
+	put_str(frm->in ? " > " : " < ");
+	put_str(type2str(sum.type));
+
+	if (link) {
+		put_str(" h=");
+		put_uint(sum.handle);
+	}
+
+	if (sum.depth > 1) {
+		put_char(' ');
+		for (i = 0; sum.layer[i]; i++)
+			put_char(toupper(sum.layer[i]));
+	}
+
+	if (sum.name) {
+		put_char(' ');
+		put_str(sum.name);
+	}
+
+	if (sum.command) {
+		put_str(" (");
+		put_str(sum.command);
+		put_char(')');
+	}
+
+	for (j = 0; sum_fields[j].name; j++) {
+		const char *name = sum_fields[j].name;
+
+		/* The link handle is already shown */
+		if (sum.depth == 1 && link && j == 0)
+			continue;
+
+		for (i = 0; i < sum.count; i++) {
+			if (sum.field[i].name[0] != name[0] ||
+					strcmp(sum.field[i].name, name))
+				continue;
+
+			put_char(' ');
+			put_str(sum_fields[j].label);
+			put_char('=');
+
+			/* Attribute handles are shown in hex */
+			if (sum.depth > 1 && j == 0)
+				put_hex(sum.field[i].val, 4);
+			else if (sum_fields[j].hex)
+				put_hex(sum.field[i].val, sum_fields[j].hex);
+			else
+				put_uint(sum.field[i].val);
+			break;
+		}
+	}
+
+	line[line_len++] = '\n';
+
+	PROF_CALL(PROF_OUTPUT, fwrite(line, 1, line_len, stdout));
+}
+
+struct field_sink summary_sink = {
+	.begin	= sum_begin,
+	.layer	= sum_layer,
+	.uint	= sum_uint,
+	.str	= sum_str,
+	.bdaddr	= sum_bdaddr,
+	.uuid	= sum_uuid,
+	.bytes	= sum_bytes,
+	.end	= sum_end,
+};
@@ -0,0 +1,149 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  hcidump contributors
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "parser/evtstream.h"
+
+static void print_field(struct evt_field *f)
+{
+	int i;
+
+	if (f->type == EVT_FIELD_LAYER) {
+		printf(" %s:", f->name);
+		return;
+	}
+
+	printf(" %s=", f->name);
+
+	switch (f->type) {
+	case EVT_FIELD_U8:
+	case EVT_FIELD_U16:
+	case EVT_FIELD_U32:
+		printf("%u", evt_uint(f));
+		break;
+
+	case EVT_FIELD_STR:
+		printf("\"%.*s\"", f->len, f->data);
+		break;
+
+	case EVT_FIELD_BDADDR:
+		for (i = 5; i >= 0; i--)
+			printf("%2.2X%s", f->data[i], i ? ":" : "");
+		break;
+
+	default:
+		for (i = 0; i < f->len; i++)
+			printf("%2.2x", f->data[i]);
+		break;
+	}
+}
+
+static void usage(void)
+{
+	printf("evtdump - Print hcidump binary event streams\n\n");
+	printf("Usage:\n"
+		"\tevtdump [-c] <file>\n");
+}
+
+static struct option main_options[] = {
+	{ "count",	0, 0, 'c' },
+	{ "help",	0, 0, 'h' },
+	{ 0, 0, 0, 0}
+};
+
+int main(int argc, char *argv[])
+{
+	struct evt_stream *s;
+	struct evt_frame frm;
+	struct evt_field f;
+	unsigned long frames = 0, fields = 0;
+	int err, opt, count = 0;
+
+	while ((opt=getopt_long(argc, argv, "+ch", main_options, NULL)) != -1) {
+		switch (opt) {
+		case 'c':
+			count = 1;
+			break;
+
+		case 'h':
+		default:
+			usage();
+			exit(0);
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+	optind = 0;
+
+	if (argc < 1) {
+		usage();
+		exit(1);
+	}
+
+	s = evt_open(argv[0]);
+	if (!s) {
+		perror("Can't open event stream");
+		exit(1);
+	}
+
+	while ((err = evt_next_frame(s, &frm)) > 0) {
+		frames++;
+
+		if (!count)
+			printf("%u.%06u %u %c %u", frm.sec, frm.usec, frm.dev,
+						frm.in ? '>' : '<', frm.len);
+
+		while ((err = evt_next_field(s, &frm, &f)) > 0) {
+			fields++;
+			if (!count)
+				print_field(&f);
+		}
+
+		if (!count)
+			printf("\n");
+
+		if (err < 0)
+			break;
+	}
+
+	if (err < 0)
+		fprintf(stderr, "Corrupt event stream\n");
+
+	if (count)
+		printf("%lu frames %lu fields\n", frames, fields);
+
+	evt_close(s);
+
+	return err < 0 ? 1 : 0;
+}
@@ -27,13 +27,19 @@
 #endif
 
 #include <stdio.h>
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
+#include <signal.h>
+#include <time.h>
 #include <sys/poll.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
@@ -52,6 +58,33 @@
 
 #define SNAP_LEN 	HCI_MAX_FRAME_SIZE
 #define DEFAULT_PORT	"10839";
+#define DROP_INTERVAL	1
+#define MAX_DEVICES	DEVICE_SLOTS
+
+/* Long only options */
+enum {
+	OPT_PROFILE = 256,
+	OPT_RCVBUF,
+	OPT_CONVERT,
+	OPT_JSON,
+	OPT_BINARY,
+	OPT_SUMMARY,
+	OPT_CSV,
+	OPT_LATENCY,
+	OPT_FLOW,
+	OPT_RATE,
+	OPT_RATE_INTERVAL,
+	OPT_ADV,
+	OPT_INQ,
+	OPT_PANDUMP,
+	OPT_PPP_PCAP,
+	OPT_WAV,
+	OPT_SCO_STATS,
+	OPT_A2DP_STATS,
+	OPT_A2DP_DUMP,
+	OPT_OBEX_DUMP,
+	OPT_ATT_STATS,
+};
 
 /* Modes */
 enum {
@@ -70,9 +103,93 @@ static int  permcheck = 1;
 static char *dump_file = NULL;
 static char *pppdump_file = NULL;
 static char *audio_file = NULL;
+static char *pandump_file = NULL;
+static char *ppp_pcap_file = NULL;
+static char *flow_file = NULL;
+static char *a2dp_file = NULL;
+static char *rate_file = NULL;
+static int rate_interval = 1000;
 static char *dump_addr;
 static char *dump_port = DEFAULT_PORT;
 static int af = AF_UNSPEC;
+static int rcvbuf = 0;
+static bdaddr_t filter_bdaddr;	/* Filter on the device address */
+static int use_bdaddr = 0;
+static FILE *info;		/* Where status lines go */
+
+#define OUTPUT_BUF_SIZE	(256 * 1024)
+#define MAX_IFACES	64
+
+struct output {
+	int		fd;
+	char		*buf;
+	int		len;
+	int		size;		/* Zero for unbuffered */
+	int		ifaces;		/* pcapng interfaces written so far */
+	uint16_t	iface[MAX_IFACES];
+};
+
+struct device {
+	int		dev_id;
+	int		sk;
+	struct output	*out;		/* Per device dump file */
+	char		*buf;
+	struct frame	frm;
+	int		pending;
+	unsigned long	frames;
+	unsigned long	bytes;
+	uint32_t	drops;		/* Cumulative Drops */
+	uint32_t	drops_reported;
+	uint32_t	rxq_ovfl;
+	time_t		drops_time;
+};
+
+static struct device devices[MAX_DEVICES];
+static int num_devices = 0;
+
+/* Dump file formats */
+enum {
+	FORMAT_HCIDUMP,
+	FORMAT_BTSNOOP,
+	FORMAT_PKTLOG,
+	FORMAT_PCAP,
+	FORMAT_PCAPNG
+};
+
+static int dump_format = FORMAT_BTSNOOP;
+static int convert = 0;
+static unsigned long skipped = 0;	/* Frames the output can't carry */
+
+#define MAX_SOURCES	64
+
+struct source {
+	char		*name;
+	int		fd;
+	int		format;
+	uint32_t	type;		/* BTSnoop datalink type */
+	int		index;
+	char		*map;		/* Mapped file or NULL */
+	size_t		map_size;
+	size_t		map_pos;
+	char		*buf;
+	struct frame	frm;
+	uint32_t	drops;		/* Cumulative Drops */
+	uint32_t	drops_seen;
+};
+
+static struct source sources[MAX_SOURCES];
+static int num_sources = 0;
+
+static struct {
+	int		source;
+	uint16_t	dev_id;
+} merge_table[MAX_SOURCES];
+static int merge_count = 0;
+static int merge_dump = 0;
+static uint32_t total_drops = 0;
+
+static volatile sig_atomic_t report_pending = 0;
+static volatile sig_atomic_t terminate = 0;
 
 struct hcidump_hdr {
 	uint16_t	len;
@@ -112,12 +229,174 @@ struct pktlog_hdr {
 } __attribute__ ((packed));
 #define PKTLOG_HDR_SIZE (sizeof(struct pktlog_hdr))
 
+/* Opcodes of the btsnoop monitor datalink (2001) */
+#define MONITOR_NEW_INDEX	0
+#define MONITOR_DEL_INDEX	1
+#define MONITOR_COMMAND_PKT	2
+#define MONITOR_EVENT_PKT	3
+#define MONITOR_ACL_TX_PKT	4
+#define MONITOR_ACL_RX_PKT	5
+#define MONITOR_SCO_TX_PKT	6
+#define MONITOR_SCO_RX_PKT	7
+
+struct monitor_new_index {
+	uint8_t		type;
+	uint8_t		bus;
+	bdaddr_t	bdaddr;
+	char		name[8];
+} __attribute__ ((packed));
+#define MONITOR_NEW_INDEX_SIZE (sizeof(struct monitor_new_index))
+
+/* pcap and pcapng are written in host byte order */
+#define DLT_BLUETOOTH_HCI_H4_WITH_PHDR	201
+
+struct pcap_hdr {
+	uint32_t	magic;
+	uint16_t	version_major;
+	uint16_t	version_minor;
+	int32_t		thiszone;
+	uint32_t	sigfigs;
+	uint32_t	snaplen;
+	uint32_t	network;
+} __attribute__ ((packed));
+#define PCAP_HDR_SIZE (sizeof(struct pcap_hdr))
+
+struct pcap_pkt {
+	uint32_t	ts_sec;
+	uint32_t	ts_usec;
+	uint32_t	incl_len;
+	uint32_t	orig_len;
+	uint32_t	direction;	/* Pseudo header, big endian */
+} __attribute__ ((packed));
+#define PCAP_PKT_SIZE (sizeof(struct pcap_pkt))
+
+#define PCAPNG_SHB	0x0a0d0d0a
+#define PCAPNG_IDB	0x00000001
+#define PCAPNG_EPB	0x00000006
+
+struct pcapng_shb {
+	uint32_t	type;
+	uint32_t	len;
+	uint32_t	magic;
+	uint16_t	version_major;
+	uint16_t	version_minor;
+	uint64_t	section_len;
+	uint32_t	len2;
+} __attribute__ ((packed));
+#define PCAPNG_SHB_SIZE (sizeof(struct pcapng_shb))
+
+struct pcapng_idb {
+	uint32_t	type;
+	uint32_t	len;
+	uint16_t	linktype;
+	uint16_t	reserved;
+	uint32_t	snaplen;
+	uint16_t	opt_code;	/* if_name */
+	uint16_t	opt_len;
+	char		name[36];	/* Padded, opt_endofopt, length */
+} __attribute__ ((packed));
+#define PCAPNG_IDB_SIZE (sizeof(struct pcapng_idb))
+
+struct pcapng_epb {
+	uint32_t	type;
+	uint32_t	len;
+	uint32_t	iface;
+	uint32_t	ts_high;
+	uint32_t	ts_low;
+	uint32_t	caplen;
+	uint32_t	origlen;
+	uint32_t	direction;	/* Pseudo header, big endian */
+} __attribute__ ((packed));
+#define PCAPNG_EPB_SIZE (sizeof(struct pcapng_epb))
+
+/* Room for the largest record header in front of a frame */
+#define FRAME_HEADROOM	PCAPNG_EPB_SIZE
+
+static void sig_handler(int sig)
+{
+	if (sig == SIGUSR1)
+		report_pending = 1;
+	else
+		terminate = 1;
+}
+
+static void init_signals(void)
+{
+	struct sigaction sa;
+
+	/* No SA_RESTART so that a blocking poll() returns with EINTR */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sig_handler;
+	sigemptyset(&sa.sa_mask);
+
+	sigaction(SIGUSR1, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+}
+
+static void report_devices(void)
+{
+	int i;
+
+	for (i = 0; i < num_devices; i++)
+		fprintf(stderr, "hci%d: %lu frames %lu bytes %u drops\n",
+					devices[i].dev_id, devices[i].frames,
+					devices[i].bytes, devices[i].drops);
+}
+
+static int check_signals(void)
+{
+	if (report_pending) {
+		report_pending = 0;
+		if (parser.flags & DUMP_PROFILE)
+			prof_dump(stderr);
+		if (parser.flags & DUMP_LATENCY)
+			lat_dump(stderr);
+		if (parser.flags & DUMP_FLOW)
+			flow_dump(stderr);
+		if (parser.flags & DUMP_ADV)
+			adv_dump(stderr);
+		if (parser.flags & DUMP_INQ)
+			inq_dump(stderr);
+		if (parser.flags & DUMP_SCO)
+			audio_dump(stderr);
+		if (parser.flags & DUMP_A2DP)
+			a2dp_dump(stderr);
+		if (parser.flags & DUMP_ATT)
+			att_stats_dump(stderr);
+		if (num_devices > 1)
+			report_devices();
+	}
+
+	return terminate;
+}
+
+static void report_drops(struct device *d, int force)
+{
+	time_t now = time(NULL);
+
+	if (d->drops == d->drops_reported)
+		return;
+
+	if (!force && now - d->drops_time < DROP_INTERVAL)
+		return;
+
+	fprintf(stderr, "drops: hci%d %u frames lost in last %lds (%u total)\n",
+				d->dev_id, d->drops - d->drops_reported,
+				(long) (now - d->drops_time), d->drops);
+
+	d->drops_reported = d->drops;
+	d->drops_time = now;
+}
+
 static inline int read_n(int fd, char *buf, int len)
 {
 	int t = 0, w;
 
 	while (len > 0) {
 		if ((w = read(fd, buf, len)) < 0) {
+			if (errno == EINTR && terminate)
+				return 0;
 			if (errno == EINTR || errno == EAGAIN)
 				continue;
 			return -1;
@@ -146,388 +425,1224 @@ static inline int write_n(int fd, char *buf, int len)
 	return t;
 }
 
-static int process_frames(int dev, int sock, int fd, unsigned long flags)
+static struct output *new_output(int fd, int size)
+{
+	struct output *out;
+
+	out = malloc(sizeof(*out));
+	if (!out) {
+		perror("Can't allocate output buffer");
+		exit(1);
+	}
+
+	out->fd = fd;
+	out->len = 0;
+	out->size = size;
+	out->buf = NULL;
+	out->ifaces = 0;
+
+	if (size > 0) {
+		out->buf = malloc(size);
+		if (!out->buf) {
+			perror("Can't allocate output buffer");
+			exit(1);
+		}
+	}
+
+	return out;
+}
+
+static int output_flush(struct output *out)
+{
+	int len;
+
+	if (!out->len)
+		return 0;
+
+	prof_enter(PROF_WRITE);
+	len = write_n(out->fd, out->buf, out->len);
+	prof_leave();
+
+	out->len = 0;
+
+	return len < 0 ? -1 : 0;
+}
+
+static int output_write(struct output *out, void *data, int len)
+{
+	int err;
+
+	if (out->len + len > out->size) {
+		if (output_flush(out) < 0)
+			return -1;
+
+		/* Too big to be worth buffering */
+		if (len > out->size) {
+			prof_enter(PROF_WRITE);
+			err = write_n(out->fd, data, len);
+			prof_leave();
+			return err;
+		}
+	}
+
+	memcpy(out->buf + out->len, data, len);
+	out->len += len;
+
+	return len;
+}
+
+static int recv_frame(struct device *d, struct msghdr *msg, struct iovec *iv,
+								char *ctrl)
 {
 	struct cmsghdr *cmsg;
-	struct msghdr msg;
-	struct iovec  iv;
+	struct frame *frm = &d->frm;
+	int len;
+
+	iv->iov_base = frm->data;
+	iv->iov_len  = snap_len;
+
+	msg->msg_iov = iv;
+	msg->msg_iovlen = 1;
+	msg->msg_control = ctrl;
+	msg->msg_controllen = 100;
+
+	/* MSG_TRUNC reports the full length of a truncated frame */
+	prof_enter(PROF_RECV);
+	len = recvmsg(d->sk, msg, MSG_DONTWAIT | MSG_TRUNC);
+	prof_leave();
+	if (len < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+		if (errno == ENOBUFS) {
+			/* Receive queue overrun, count at least one */
+			d->drops++;
+			total_drops++;
+			report_drops(d, 0);
+			return 0;
+		}
+		perror("Receive failed");
+		return -1;
+	}
+
+	/* Process control message */
+	frm->orig_len = len;
+	frm->data_len = len < snap_len ? len : snap_len;
+	frm->dev_id = d->dev_id;
+	frm->in = 0;
+	frm->pppdump_fd = parser.pppdump_fd;
+	frm->audio_fd   = parser.audio_fd;
+
+	cmsg = CMSG_FIRSTHDR(msg);
+	while (cmsg) {
+		int dir;
+#ifdef SO_RXQ_OVFL
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+				cmsg->cmsg_type == SO_RXQ_OVFL) {
+			uint32_t ovfl;
+			memcpy(&ovfl, CMSG_DATA(cmsg), sizeof(ovfl));
+			d->drops += ovfl - d->rxq_ovfl;
+			total_drops += ovfl - d->rxq_ovfl;
+			d->rxq_ovfl = ovfl;
+		}
+#endif
+		if (cmsg->cmsg_level != SOL_HCI) {
+			cmsg = CMSG_NXTHDR(msg, cmsg);
+			continue;
+		}
+
+		switch (cmsg->cmsg_type) {
+		case HCI_CMSG_DIR:
+			memcpy(&dir, CMSG_DATA(cmsg), sizeof(int));
+			frm->in = (uint8_t) dir;
+			break;
+		case HCI_CMSG_TSTAMP:
+			memcpy(&frm->ts, CMSG_DATA(cmsg),
+					sizeof(struct timeval));
+			break;
+		}
+		cmsg = CMSG_NXTHDR(msg, cmsg);
+	}
+
+	report_drops(d, 0);
+
+	frm->ptr = frm->data;
+	frm->len = frm->data_len;
+
+	return len;
+}
+
+static inline uint64_t btsnoop_ts(struct timeval *tv)
+{
+	uint64_t ts;
+
+	ts = (tv->tv_sec - 946684800ll) * 1000000ll + tv->tv_usec;
+
+	return hton64(ts + 0x00E03AB44A676000ll);
+}
+
+static int pcapng_iface(struct output *out, int dev_id, const char *name)
+{
+	struct pcapng_idb idb;
+	uint32_t len;
+	int i, n;
+
+	for (i = 0; i < out->ifaces; i++)
+		if (out->iface[i] == dev_id)
+			return i;
+
+	if (out->ifaces == MAX_IFACES) {
+		fprintf(stderr, "Too many devices for one pcapng file\n");
+		exit(1);
+	}
+
+	memset(&idb, 0, sizeof(idb));
+
+	if (name)
+		n = snprintf(idb.name, sizeof(idb.name) - 7, "%s", name);
+	else
+		n = snprintf(idb.name, sizeof(idb.name) - 7, "hci%d", dev_id);
+	if (n > (int) sizeof(idb.name) - 8)
+		n = sizeof(idb.name) - 8;
+
+	/* Name padded to 32 bits, then opt_endofopt and the trailing length */
+	len = PCAPNG_IDB_SIZE - sizeof(idb.name) + ((n + 3) & ~3) + 4 + 4;
+
+	idb.type = PCAPNG_IDB;
+	idb.len = len;
+	idb.linktype = DLT_BLUETOOTH_HCI_H4_WITH_PHDR;
+	idb.snaplen = HCI_MAX_FRAME_SIZE + 4;
+	idb.opt_code = 2;
+	idb.opt_len = n;
+	memcpy((char *) &idb + len - 4, &len, 4);
+
+	if (output_write(out, &idb, len) < 0)
+		return -1;
+
+	out->iface[out->ifaces] = dev_id;
+
+	return out->ifaces++;
+}
+
+/*
+ * The record header is built in place in front of the frame data, so
+ * the frame buffer needs FRAME_HEADROOM bytes of headroom. Formats
+ * without a packet type indicator overwrite it with the header instead.
+ */
+static int write_frame(struct output *out, struct frame *frm, uint32_t drops)
+{
+	uint32_t orig_len = frm->orig_len > frm->data_len ?
+					frm->orig_len : frm->data_len;
+	uint8_t pkt_type = ((uint8_t *) frm->data)[0];
 	struct hcidump_hdr *dh;
 	struct btsnoop_pkt *dp;
-	struct frame frm;
-	struct pollfd fds[2];
-	int nfds = 0;
-	char *buf, *ctrl;
-	int len, hdr_size = HCIDUMP_HDR_SIZE;
+	struct pktlog_hdr *ph;
+	char *buf;
+	int len, skip = 0, hdr_size = HCIDUMP_HDR_SIZE;
+	uint32_t dflags;
+	uint8_t type;
+
+	if (dump_format == FORMAT_PCAP) {
+		struct pcap_pkt *pp;
+
+		buf = (char *) frm->data - PCAP_PKT_SIZE;
+		pp = (void *) buf;
+		pp->ts_sec = frm->ts.tv_sec;
+		pp->ts_usec = frm->ts.tv_usec;
+		pp->incl_len = frm->data_len + 4;
+		pp->orig_len = orig_len + 4;
+		pp->direction = htonl(frm->in & 0x01);
+
+		return output_write(out, buf, PCAP_PKT_SIZE + frm->data_len);
+	}
 
-	if (sock < 0)
-		return -1;
+	if (dump_format == FORMAT_PCAPNG) {
+		static const uint8_t zero[4];
+		struct pcapng_epb *ep;
+		uint64_t ts;
+		uint32_t tail;
+		int iface, pad = (4 - (frm->data_len & 3)) & 3;
 
-	if (snap_len < SNAP_LEN)
-		snap_len = SNAP_LEN;
+		iface = pcapng_iface(out, frm->dev_id, NULL);
+		if (iface < 0)
+			return -1;
+
+		ts = frm->ts.tv_sec * 1000000ull + frm->ts.tv_usec;
+
+		buf = (char *) frm->data - PCAPNG_EPB_SIZE;
+		ep = (void *) buf;
+		ep->type = PCAPNG_EPB;
+		ep->len = PCAPNG_EPB_SIZE + frm->data_len + pad + 4;
+		ep->iface = iface;
+		ep->ts_high = ts >> 32;
+		ep->ts_low = ts & 0xffffffff;
+		ep->caplen = frm->data_len + 4;
+		ep->origlen = orig_len + 4;
+		ep->direction = htonl(frm->in & 0x01);
+		tail = ep->len;
+
+		if (output_write(out, buf, PCAPNG_EPB_SIZE +
+						frm->data_len) < 0 ||
+				output_write(out, (void *) zero, pad) < 0 ||
+				output_write(out, &tail, 4) < 0)
+			return -1;
+
+		return ep->len;
+	}
+
+	if (dump_format == FORMAT_PKTLOG) {
+		switch (pkt_type) {
+		case HCI_COMMAND_PKT:
+			type = 0x00;
+			break;
+		case HCI_EVENT_PKT:
+			type = 0x01;
+			break;
+		case HCI_ACLDATA_PKT:
+			type = frm->in ? 0x03 : 0x02;
+			break;
+		default:
+			skipped++;
+			return 0;
+		}
+
+		/* The type byte takes the place of the indicator */
+		buf = (char *) frm->data + 1 - PKTLOG_HDR_SIZE;
+		ph = (void *) buf;
+		ph->len = htonl(frm->data_len + 8);
+		ph->ts = hton64(((uint64_t) frm->ts.tv_sec << 32) |
+							frm->ts.tv_usec);
+		ph->type = type;
+
+		return output_write(out, buf, PKTLOG_HDR_SIZE +
+							frm->data_len - 1);
+	}
+
+	if (dump_format == FORMAT_BTSNOOP) {
+		switch (btsnoop_type) {
+		case 1001:
+			switch (pkt_type) {
+			case HCI_COMMAND_PKT:
+			case HCI_EVENT_PKT:
+				dflags = 0x02 | (pkt_type == HCI_EVENT_PKT);
+				break;
+			case HCI_ACLDATA_PKT:
+				dflags = frm->in & 0x01;
+				break;
+			default:
+				skipped++;
+				return 0;
+			}
+			skip = 1;
+			break;
+
+		case 2001:
+			switch (pkt_type) {
+			case HCI_COMMAND_PKT:
+				dflags = MONITOR_COMMAND_PKT;
+				break;
+			case HCI_EVENT_PKT:
+				dflags = MONITOR_EVENT_PKT;
+				break;
+			case HCI_ACLDATA_PKT:
+				dflags = frm->in ? MONITOR_ACL_RX_PKT :
+							MONITOR_ACL_TX_PKT;
+				break;
+			case HCI_SCODATA_PKT:
+				dflags = frm->in ? MONITOR_SCO_RX_PKT :
+							MONITOR_SCO_TX_PKT;
+				break;
+			default:
+				skipped++;
+				return 0;
+			}
+			dflags |= frm->dev_id << 16;
+			skip = 1;
+			break;
+
+		default:
+			dflags = frm->in & 0x01;
+			if (pkt_type == HCI_COMMAND_PKT ||
+					pkt_type == HCI_EVENT_PKT)
+				dflags |= 0x02;
+			break;
+		}
 
-	if (flags & DUMP_BTSNOOP)
 		hdr_size = BTSNOOP_PKT_SIZE;
+	}
 
-	buf = malloc(snap_len + hdr_size);
-	if (!buf) {
-		perror("Can't allocate data buffer");
+	/* Neither 1001 nor monitor records carry a packet type indicator */
+	buf = (char *) frm->data + skip - hdr_size;
+	len = frm->data_len - skip;
+
+	if (dump_format == FORMAT_BTSNOOP) {
+		dp = (void *) buf;
+		dp->size = htonl(orig_len - skip);
+		dp->len  = htonl(len);
+		dp->flags = htonl(dflags);
+		dp->drops = htonl(drops);
+		dp->ts = btsnoop_ts(&frm->ts);
+	} else {
+		dh = (void *) buf;
+		dh->len = htobs(len);
+		dh->in  = frm->in;
+		dh->pad = 0;
+		dh->ts_sec  = htobl(frm->ts.tv_sec);
+		dh->ts_usec = htobl(frm->ts.tv_usec);
+	}
+
+	return output_write(out, buf, len + hdr_size);
+}
+
+static int write_index(struct output *out, int dev_id, const char *name)
+{
+	struct btsnoop_pkt dp;
+	struct monitor_new_index ni;
+	struct hci_dev_info di;
+	struct timeval tv;
+
+	if (dump_format == FORMAT_PCAPNG)
+		return pcapng_iface(out, dev_id, name) < 0 ? -1 : 0;
+
+	if (name || hci_devinfo(dev_id, &di) < 0) {
+		memset(&di, 0, sizeof(di));
+		if (name)
+			memcpy(di.name, name, strlen(name) < sizeof(di.name) ?
+					strlen(name) : sizeof(di.name));
+		else
+			snprintf(di.name, sizeof(di.name), "hci%d", dev_id);
+	}
+
+	ni.type = (di.type >> 4) & 0x03;
+	ni.bus  = di.type & 0x0f;
+	bacpy(&ni.bdaddr, &di.bdaddr);
+	memcpy(ni.name, di.name, sizeof(ni.name));
+
+	gettimeofday(&tv, NULL);
+
+	dp.size  = htonl(MONITOR_NEW_INDEX_SIZE);
+	dp.len   = dp.size;
+	dp.flags = htonl((dev_id << 16) | MONITOR_NEW_INDEX);
+	dp.drops = 0;
+	dp.ts    = btsnoop_ts(&tv);
+
+	if (output_write(out, &dp, BTSNOOP_PKT_SIZE) < 0 ||
+			output_write(out, &ni, MONITOR_NEW_INDEX_SIZE) < 0)
 		return -1;
+
+	return 0;
+}
+
+static int flush_outputs(struct device *devs, int ndevs, struct output *out)
+{
+	int i, err = 0;
+
+	if (out && output_flush(out) < 0)
+		err = -1;
+
+	for (i = 0; i < ndevs; i++)
+		if (devs[i].out && output_flush(devs[i].out) < 0)
+			err = -1;
+
+	return err;
+}
+
+static struct device *oldest_frame(struct device *devs, int ndevs)
+{
+	struct device *d = NULL;
+	int i;
+
+	for (i = 0; i < ndevs; i++) {
+		if (!devs[i].pending)
+			continue;
+
+		if (!d || timercmp(&devs[i].frm.ts, &d->frm.ts, <))
+			d = &devs[i];
 	}
 
-	dh = (void *) buf;
-	dp = (void *) buf;
-	frm.data = buf + hdr_size;
+	return d;
+}
+
+static int output_header(struct output *out);
+
+/* Whether the output format tags frames with their device */
+static inline int tagged_output(void)
+{
+	if (dump_format == FORMAT_BTSNOOP)
+		return btsnoop_type == 2001;
+
+	return dump_format == FORMAT_PCAPNG;
+}
+
+static int process_frames(struct device *devs, int ndevs, struct output *out,
+							unsigned long flags)
+{
+	struct epoll_event ev, events[MAX_DEVICES + 1];
+	struct msghdr msg;
+	struct iovec  iv;
+	struct device *d;
+	char *ctrl;
+	int i, ep, len, active = 0, err = 0;
+
+	if (snap_len < SNAP_LEN)
+		snap_len = SNAP_LEN;
 
 	ctrl = malloc(100);
 	if (!ctrl) {
-		free(buf);
 		perror("Can't allocate control buffer");
 		return -1;
 	}
 
-	if (dev == HCI_DEV_NONE)
-		printf("system: ");
-	else
-		printf("device: hci%d ", dev);
+	ep = epoll_create(ndevs + 1);
+	if (ep < 0) {
+		perror("Can't create epoll descriptor");
+		free(ctrl);
+		return -1;
+	}
 
-	printf("snap_len: %d filter: 0x%lx\n", snap_len, parser.filter);
+	for (i = 0; i < ndevs; i++) {
+		d = &devs[i];
 
-	memset(&msg, 0, sizeof(msg));
+		if (d->sk < 0)
+			continue;
 
-	if (mode == SERVER) {
-		struct btsnoop_hdr *hdr = (void *) buf;
+		d->buf = malloc(snap_len + FRAME_HEADROOM);
+		if (!d->buf) {
+			perror("Can't allocate data buffer");
+			err = -1;
+			goto done;
+		}
 
-		btsnoop_version = 1;
-		btsnoop_type = 1002;
+		d->frm.data = d->buf + FRAME_HEADROOM;
+		d->pending = 0;
+		d->drops_time = time(NULL);
 
-		memcpy(hdr->id, btsnoop_id, sizeof(btsnoop_id));
-		hdr->version = htonl(btsnoop_version);
-		hdr->type = htonl(btsnoop_type);
+		if (d->dev_id == HCI_DEV_NONE)
+			fprintf(info, "system: ");
+		else
+			fprintf(info, "device: hci%d ", d->dev_id);
+
+		fprintf(info, "snap_len: %d filter: 0x%lx\n",
+						snap_len, parser.filter);
+
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = d;
+		if (epoll_ctl(ep, EPOLL_CTL_ADD, d->sk, &ev) < 0) {
+			perror("Can't add device to epoll");
+			err = -1;
+			goto done;
+		}
 
-		printf("btsnoop version: %d datalink type: %d\n",
-						btsnoop_version, btsnoop_type);
+		active++;
+	}
 
-		len = write(fd, buf, BTSNOOP_HDR_SIZE);
-		if (len < 0) {
-			perror("Can't create dump header");
-			return -1;
-		}
+	if (!active) {
+		err = -1;
+		goto done;
+	}
 
-		if (len != BTSNOOP_HDR_SIZE) {
-			fprintf(stderr, "Header size mismatch\n");
-			return -1;
+	memset(&msg, 0, sizeof(msg));
+
+	if (mode == SERVER) {
+		dump_format = FORMAT_BTSNOOP;
+		btsnoop_type = ndevs > 1 ? 2001 : 1002;
+
+		if (output_header(out) < 0) {
+			err = -1;
+			goto done;
 		}
 
-		fds[nfds].fd = fd;
-		fds[nfds].events = POLLIN;
-		fds[nfds].revents = 0;
-		nfds++;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = NULL;
+		epoll_ctl(ep, EPOLL_CTL_ADD, out->fd, &ev);
 	}
 
-	fds[nfds].fd = sock;
-	fds[nfds].events = POLLIN;
-	fds[nfds].revents = 0;
-	nfds++;
+	if (mode != PARSE && tagged_output()) {
+		for (i = 0; i < ndevs; i++) {
+			struct output *o = devs[i].out ? devs[i].out : out;
 
-	while (1) {
-		int i, n = poll(fds, nfds, -1);
+			if (devs[i].sk >= 0 &&
+					write_index(o, devs[i].dev_id, NULL) < 0) {
+				perror("Write error");
+				err = -1;
+				goto done;
+			}
+		}
+	}
+
+	while (!check_signals()) {
+		int budget = 64 * ndevs;
+		int n = epoll_wait(ep, events, ndevs + 1, -1);
 		if (n <= 0)
 			continue;
 
-		for (i = 0; i < nfds; i++) {
-			if (fds[i].revents & (POLLHUP | POLLERR | POLLNVAL)) {
-				if (fds[i].fd == sock)
-					printf("device: disconnected\n");
-				else
-					printf("client: disconnect\n");
-				return 0;
+		for (i = 0; i < n; i++) {
+			d = events[i].data.ptr;
+
+			if (!d) {
+				char tmp[64];
+
+				len = recv(out->fd, tmp, sizeof(tmp),
+								MSG_DONTWAIT);
+				if (len == 0 || (events[i].events &
+						(EPOLLHUP | EPOLLERR))) {
+					fprintf(info, "client: disconnect\n");
+					goto done;
+				}
+				if (len < 0 && errno != EAGAIN && errno != EINTR) {
+					perror("Connection read failure");
+					err = -1;
+					goto done;
+				}
+				continue;
 			}
-		}
 
-		if (mode == SERVER) {
-			len = recv(fd, buf, snap_len, MSG_DONTWAIT);
-			if (len == 0) {
-				printf("client: disconnect\n");
-				return 0;
-			}
-			if (len < 0 && errno != EAGAIN && errno != EINTR) {
-				perror("Connection read failure");
-				return -1;
+			if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+				if (ndevs == 1)
+					fprintf(info, "device: disconnected\n");
+				else
+					fprintf(info, "device: hci%d disconnected\n",
+								d->dev_id);
+
+				epoll_ctl(ep, EPOLL_CTL_DEL, d->sk, NULL);
+				if (--active == 0)
+					goto done;
+				continue;
 			}
-		}
 
-		iv.iov_base = frm.data;
-		iv.iov_len  = snap_len;
+			if (d->pending)
+				continue;
 
-		msg.msg_iov = &iv;
-		msg.msg_iovlen = 1;
-		msg.msg_control = ctrl;
-		msg.msg_controllen = 100;
+			len = recv_frame(d, &msg, &iv, ctrl);
+			if (len < 0) {
+				err = -1;
+				goto done;
+			}
 
-		len = recvmsg(sock, &msg, MSG_DONTWAIT);
-		if (len < 0) {
-			if (errno == EAGAIN || errno == EINTR)
-				continue;
-			perror("Receive failed");
-			return -1;
+			d->pending = len > 0;
 		}
 
-		/* Process control message */
-		frm.data_len = len;
-		frm.dev_id = dev;
-		frm.in = 0;
-		frm.pppdump_fd = parser.pppdump_fd;
-		frm.audio_fd   = parser.audio_fd;
-
-		cmsg = CMSG_FIRSTHDR(&msg);
-		while (cmsg) {
-			int dir;
-			switch (cmsg->cmsg_type) {
-			case HCI_CMSG_DIR:
-				memcpy(&dir, CMSG_DATA(cmsg), sizeof(int));
-				frm.in = (uint8_t) dir;
+		/*
+		 * Emit oldest first among the frames that are ready now. A
+		 * frame that arrives later on another device can still be
+		 * older, nothing is held back to wait for it.
+		 */
+		while ((d = oldest_frame(devs, ndevs))) {
+			struct output *o = d->out ? d->out : out;
+
+			d->pending = 0;
+			d->frames++;
+			d->bytes += d->frm.data_len;
+			prof_count(d->frm.data_len);
+			lat_frame(&d->frm);
+			flow_frame(&d->frm);
+			rate_frame(&d->frm);
+			audio_frame(&d->frm);
+
+			switch (mode) {
+			case WRITE:
+			case SERVER:
+				/* Save or send dump */
+				if (write_frame(o, &d->frm, btsnoop_type == 2001 ?
+						total_drops : d->drops) < 0) {
+					perror("Write error");
+					err = -1;
+					goto done;
+				}
 				break;
-			case HCI_CMSG_TSTAMP:
-				memcpy(&frm.ts, CMSG_DATA(cmsg),
-						sizeof(struct timeval));
+
+			default:
+				/* Parse and print */
+				parse(&d->frm);
 				break;
 			}
-			cmsg = CMSG_NXTHDR(&msg, cmsg);
-		}
 
-		frm.ptr = frm.data;
-		frm.len = frm.data_len;
-
-		switch (mode) {
-		case WRITE:
-		case SERVER:
-			/* Save or send dump */
-			if (flags & DUMP_BTSNOOP) {
-				uint64_t ts;
-				uint8_t pkt_type = ((uint8_t *) frm.data)[0];
-				dp->size = htonl(frm.data_len);
-				dp->len  = dp->size;
-				dp->flags = ntohl(frm.in & 0x01);
-				dp->drops = 0;
-				ts = (frm.ts.tv_sec - 946684800ll) * 1000000ll + frm.ts.tv_usec;
-				dp->ts = hton64(ts + 0x00E03AB44A676000ll);
-				if (pkt_type == HCI_COMMAND_PKT ||
-						pkt_type == HCI_EVENT_PKT)
-					dp->flags |= ntohl(0x02);
-			} else {
-				dh->len = htobs(frm.data_len);
-				dh->in  = frm.in;
-				dh->ts_sec  = htobl(frm.ts.tv_sec);
-				dh->ts_usec = htobl(frm.ts.tv_usec);
-			}
+			if (ndevs == 1 || --budget <= 0)
+				continue;
 
-			if (write_n(fd, buf, frm.data_len + hdr_size) < 0) {
-				perror("Write error");
-				return -1;
+			len = recv_frame(d, &msg, &iv, ctrl);
+			if (len < 0) {
+				err = -1;
+				goto done;
 			}
-			break;
 
-		default:
-			/* Parse and print */
-			parse(&frm);
-			break;
+			d->pending = len > 0;
+		}
+
+		/* Write out what this round collected */
+		if (flush_outputs(devs, ndevs, out) < 0) {
+			perror("Write error");
+			err = -1;
+			goto done;
 		}
 	}
 
-	return 0;
+done:
+	if (flush_outputs(devs, ndevs, out) < 0) {
+		perror("Write error");
+		err = -1;
+	}
+
+	for (i = 0; i < ndevs; i++) {
+		free(devs[i].buf);
+		devs[i].buf = NULL;
+	}
+
+	close(ep);
+	free(ctrl);
+
+	return err;
+}
+
+static int source_read(struct source *src, void *buf, int len)
+{
+	if (!src->map)
+		return read_n(src->fd, buf, len);
+
+	if (src->map_size - src->map_pos < (size_t) len) {
+		src->map_pos = src->map_size;
+		return 0;
+	}
+
+	memcpy(buf, src->map + src->map_pos, len);
+	src->map_pos += len;
+
+	return len;
+}
+
+static int source_skip(struct source *src, int len)
+{
+	char *buf = src->frm.data;
+	int err;
+
+	if (src->map) {
+		if (src->map_size - src->map_pos < (size_t) len) {
+			src->map_pos = src->map_size;
+			return 0;
+		}
+
+		src->map_pos += len;
+		return 1;
+	}
+
+	while (len > 0) {
+		err = read_n(src->fd, buf, len < HCI_MAX_FRAME_SIZE ?
+						len : HCI_MAX_FRAME_SIZE);
+		if (err <= 0)
+			return err;
+		len -= err;
+	}
+
+	return 1;
 }
 
-static void read_dump(int fd)
+static int read_frame(struct source *src)
 {
 	struct hcidump_hdr dh;
 	struct btsnoop_pkt dp;
 	struct pktlog_hdr ph;
-	struct frame frm;
+	struct frame *frm = &src->frm;
 	uint8_t pkt_type;
-	int err;
-
-	frm.data = malloc(HCI_MAX_FRAME_SIZE);
-	if (!frm.data) {
-		perror("Can't allocate data buffer");
-		exit(1);
-	}
+	uint16_t index, opcode;
+	int len, err;
 
 	while (1) {
-		if (parser.flags & DUMP_PKTLOG)
-			err = read_n(fd, (void *) &ph, PKTLOG_HDR_SIZE);
-		else if (parser.flags & DUMP_BTSNOOP)
-			err = read_n(fd, (void *) &dp, BTSNOOP_PKT_SIZE);
+		prof_enter(PROF_READ);
+		if (src->format == FORMAT_PKTLOG)
+			err = source_read(src, (void *) &ph, PKTLOG_HDR_SIZE);
+		else if (src->format == FORMAT_BTSNOOP)
+			err = source_read(src, (void *) &dp, BTSNOOP_PKT_SIZE);
 		else
-			err = read_n(fd, (void *) &dh, HCIDUMP_HDR_SIZE);
+			err = source_read(src, (void *) &dh, HCIDUMP_HDR_SIZE);
+		prof_leave();
 
-		if (err < 0)
-			goto failed;
-		if (!err)
-			return;
+		if (err <= 0)
+			return err;
+
+		frm->dev_id = 0;
+
+		if (src->format == FORMAT_PKTLOG) {
+			len = ntohl(ph.len) - 8;
 
-		if (parser.flags & DUMP_PKTLOG) {
 			switch (ph.type) {
 			case 0x00:
-				((uint8_t *) frm.data)[0] = HCI_COMMAND_PKT;
-				frm.in = 0;
+				((uint8_t *) frm->data)[0] = HCI_COMMAND_PKT;
+				frm->in = 0;
 				break;
 			case 0x01:
-				((uint8_t *) frm.data)[0] = HCI_EVENT_PKT;
-				frm.in = 1;
+				((uint8_t *) frm->data)[0] = HCI_EVENT_PKT;
+				frm->in = 1;
 				break;
 			case 0x02:
-				((uint8_t *) frm.data)[0] = HCI_ACLDATA_PKT;
-				frm.in = 0;
+				((uint8_t *) frm->data)[0] = HCI_ACLDATA_PKT;
+				frm->in = 0;
 				break;
 			case 0x03:
-				((uint8_t *) frm.data)[0] = HCI_ACLDATA_PKT;
-				frm.in = 1;
+				((uint8_t *) frm->data)[0] = HCI_ACLDATA_PKT;
+				frm->in = 1;
 				break;
 			default:
-				lseek(fd, ntohl(ph.len) - 9, SEEK_CUR);
+				err = source_skip(src, len - 1);
+				if (err <= 0)
+					return err;
 				continue;
 			}
 
-			frm.data_len = ntohl(ph.len) - 8;
-			err = read_n(fd, frm.data + 1, frm.data_len - 1);
-		} else if (parser.flags & DUMP_BTSNOOP) {
-			switch (btsnoop_type) {
-			case 1001:
-				if (ntohl(dp.flags) & 0x02) {
-					if (ntohl(dp.flags) & 0x01)
-						pkt_type = HCI_EVENT_PKT;
-					else
-						pkt_type = HCI_COMMAND_PKT;
-				} else
-					pkt_type = HCI_ACLDATA_PKT;
+			frm->data_len = len;
+			if (len < 1 || len > HCI_MAX_FRAME_SIZE)
+				goto toolong;
+
+			PROF_CALL(PROF_READ, err = source_read(src,
+					frm->data + 1, frm->data_len - 1));
+		} else if (src->format == FORMAT_BTSNOOP) {
+			len = ntohl(dp.len);
+
+			switch (src->type) {
+			case 1001:
+				if (ntohl(dp.flags) & 0x02) {
+					if (ntohl(dp.flags) & 0x01)
+						pkt_type = HCI_EVENT_PKT;
+					else
+						pkt_type = HCI_COMMAND_PKT;
+				} else
+					pkt_type = HCI_ACLDATA_PKT;
+
+				((uint8_t *) frm->data)[0] = pkt_type;
+
+				frm->data_len = len + 1;
+				if (frm->data_len > HCI_MAX_FRAME_SIZE)
+					goto toolong;
+
+				PROF_CALL(PROF_READ, err = source_read(src,
+					frm->data + 1, frm->data_len - 1));
+				break;
+
+			case 1002:
+				frm->data_len = len;
+				if (frm->data_len > HCI_MAX_FRAME_SIZE)
+					goto toolong;
+
+				PROF_CALL(PROF_READ, err = source_read(src,
+					frm->data, frm->data_len));
+				break;
+
+			case 2001:
+				index  = ntohl(dp.flags) >> 16;
+				opcode = ntohl(dp.flags) & 0xffff;
+
+				switch (opcode) {
+				case MONITOR_COMMAND_PKT:
+					pkt_type = HCI_COMMAND_PKT;
+					break;
+				case MONITOR_EVENT_PKT:
+					pkt_type = HCI_EVENT_PKT;
+					break;
+				case MONITOR_ACL_TX_PKT:
+				case MONITOR_ACL_RX_PKT:
+					pkt_type = HCI_ACLDATA_PKT;
+					break;
+				case MONITOR_SCO_TX_PKT:
+				case MONITOR_SCO_RX_PKT:
+					pkt_type = HCI_SCODATA_PKT;
+					break;
+				default:
+					pkt_type = 0;
+					break;
+				}
+
+				if (!pkt_type) {
+					/* Index records carry no HCI frame */
+					if (opcode != MONITOR_NEW_INDEX ||
+						len != MONITOR_NEW_INDEX_SIZE) {
+						err = source_skip(src, len);
+						if (err <= 0)
+							return err;
+						continue;
+					}
+
+					PROF_CALL(PROF_READ, err = source_read(src,
+							frm->data, len));
+					if (err <= 0)
+						return err;
+
+					if (num_sources == 1) {
+						struct monitor_new_index *ni = frm->data;
+						char addr[18];
+
+						ba2str(&ni->bdaddr, addr);
+						fprintf(info, "device: hci%d %s %.8s\n",
+							index, addr, ni->name);
+					}
+					continue;
+				}
+
+				((uint8_t *) frm->data)[0] = pkt_type;
+
+				frm->dev_id = index;
+				frm->in = opcode & 0x01;
+
+				frm->data_len = len + 1;
+				if (frm->data_len > HCI_MAX_FRAME_SIZE)
+					goto toolong;
+
+				PROF_CALL(PROF_READ, err = source_read(src,
+					frm->data + 1, frm->data_len - 1));
+				break;
+			}
+		} else {
+			frm->data_len = btohs(dh.len);
+			if (frm->data_len > HCI_MAX_FRAME_SIZE)
+				goto toolong;
+
+			PROF_CALL(PROF_READ, err = source_read(src,
+					frm->data, frm->data_len));
+		}
+
+		if (err <= 0)
+			return err;
+
+		break;
+	}
+
+	frm->ptr = frm->data;
+	frm->len = frm->data_len;
+	frm->orig_len = frm->data_len;
+	frm->pppdump_fd = parser.pppdump_fd;
+	frm->audio_fd   = parser.audio_fd;
+
+	if (src->format == FORMAT_PKTLOG) {
+		uint64_t ts;
+		ts = ntoh64(ph.ts);
+		frm->ts.tv_sec = ts >> 32;
+		frm->ts.tv_usec = ts & 0xffffffff;
+	} else if (src->format == FORMAT_BTSNOOP) {
+		uint64_t ts;
+		if (src->type != 2001)
+			frm->in = ntohl(dp.flags) & 0x01;
+		src->drops = ntohl(dp.drops);
+		/* The original length counts no packet type indicator */
+		if (ntohl(dp.size) > ntohl(dp.len))
+			frm->orig_len += ntohl(dp.size) - ntohl(dp.len);
+		ts = ntoh64(dp.ts) - 0x00E03AB44A676000ll;
+		frm->ts.tv_sec = (ts / 1000000ll) + 946684800ll;
+		frm->ts.tv_usec = ts % 1000000ll;
+	} else {
+		frm->in = dh.in;
+		frm->ts.tv_sec  = btohl(dh.ts_sec);
+		frm->ts.tv_usec = btohl(dh.ts_usec);
+	}
+
+	return 1;
+
+toolong:
+	errno = EMSGSIZE;
+	return -1;
+}
+
+/* Frames of a merged stream get an index per source and device */
+static int merged_index(struct source *src, uint16_t dev_id,
+							struct output *out)
+{
+	const char *name;
+	int i;
+
+	for (i = 0; i < merge_count; i++)
+		if (merge_table[i].source == src->index &&
+					merge_table[i].dev_id == dev_id)
+			return i;
+
+	if (merge_count == MAX_SOURCES) {
+		fprintf(stderr, "Too many devices in the merged input\n");
+		exit(1);
+	}
+
+	merge_table[merge_count].source = src->index;
+	merge_table[merge_count].dev_id = dev_id;
+
+	name = strrchr(src->name, '/');
+	name = name ? name + 1 : src->name;
+
+	if (!out)
+		fprintf(info, "device: hci%d %s hci%d\n",
+					merge_count, src->name, dev_id);
+	else if (merge_dump && write_index(out, merge_count, name) < 0) {
+		perror("Write error");
+		exit(1);
+	}
+
+	return merge_count++;
+}
+
+static inline int source_before(struct source *a, struct source *b)
+{
+	if (timercmp(&a->frm.ts, &b->frm.ts, ==))
+		return a->index < b->index;
+
+	return timercmp(&a->frm.ts, &b->frm.ts, <);
+}
+
+static void heap_down(struct source **heap, int count, int i)
+{
+	while (1) {
+		int min = i, l = 2 * i + 1, r = 2 * i + 2;
+		struct source *tmp;
+
+		if (l < count && source_before(heap[l], heap[min]))
+			min = l;
+		if (r < count && source_before(heap[r], heap[min]))
+			min = r;
+
+		if (min == i)
+			break;
+
+		tmp = heap[i];
+		heap[i] = heap[min];
+		heap[min] = tmp;
+		i = min;
+	}
+}
+
+/*
+ * Sources are merged on their timestamps through a min-heap, keeping
+ * only the current frame of each one in memory.
+ */
+static void read_dump(struct source *srcs, int count, struct output *out)
+{
+	struct source *heap[MAX_SOURCES];
+	struct source *src;
+	struct frame *frm;
+	int i, n = 0, err;
+
+	for (i = 0; i < count; i++) {
+		err = read_frame(&srcs[i]);
+		if (err < 0)
+			goto failed;
+		if (err > 0)
+			heap[n++] = &srcs[i];
+	}
+
+	for (i = n / 2 - 1; i >= 0; i--)
+		heap_down(heap, n, i);
+
+	while (n > 0 && !check_signals()) {
+		src = heap[0];
+		frm = &src->frm;
+
+		if (src->drops > src->drops_seen) {
+			fprintf(info, "drops: %u frames lost\n",
+					src->drops - src->drops_seen);
+			total_drops += src->drops - src->drops_seen;
+			src->drops_seen = src->drops;
+		}
+
+		if (count > 1 || (out && merge_dump))
+			frm->dev_id = merged_index(src, frm->dev_id, out);
+
+		prof_count(frm->data_len);
+		lat_frame(frm);
+		flow_frame(frm);
+		rate_frame(frm);
+		audio_frame(frm);
+
+		if (!out)
+			parse(frm);
+		else if (write_frame(out, frm, total_drops) < 0) {
+			perror("Write error");
+			exit(1);
+		}
+
+		err = read_frame(src);
+		if (err < 0)
+			goto failed;
+		if (!err)
+			heap[0] = heap[--n];
+
+		heap_down(heap, n, 0);
+	}
+
+	if (out && output_flush(out) < 0) {
+		perror("Write error");
+		exit(1);
+	}
+
+	return;
+
+failed:
+	perror("Read failed");
+	exit(1);
+}
+
+static void map_source(struct source *src)
+{
+	struct stat st;
+	void *map;
+
+	if (fstat(src->fd, &st) < 0 || !S_ISREG(st.st_mode) || !st.st_size)
+		return;
+
+	/* Pipes and failed mappings fall back to plain reads */
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, src->fd, 0);
+	if (map == MAP_FAILED)
+		return;
+
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	src->map = map;
+	src->map_size = st.st_size;
+	src->map_pos = lseek(src->fd, 0, SEEK_CUR);
+}
+
+static void open_source(struct source *src, int index)
+{
+	unsigned char buf[BTSNOOP_HDR_SIZE];
+	struct btsnoop_hdr *hdr = (struct btsnoop_hdr *) buf;
+	int len;
+
+	src->index = index;
+	src->format = FORMAT_HCIDUMP;
+
+	src->buf = malloc(FRAME_HEADROOM + HCI_MAX_FRAME_SIZE);
+	if (!src->buf) {
+		perror("Can't allocate data buffer");
+		exit(1);
+	}
+
+	src->frm.data = src->buf + FRAME_HEADROOM;
+
+	src->fd = open(src->name, O_RDONLY);
+	if (src->fd < 0) {
+		perror("Can't open dump file");
+		exit(1);
+	}
+
+	len = read(src->fd, buf, BTSNOOP_HDR_SIZE);
+	if (len != BTSNOOP_HDR_SIZE) {
+		lseek(src->fd, 0, SEEK_SET);
+		map_source(src);
+		return;
+	}
+
+	if (!memcmp(hdr->id, btsnoop_id, sizeof(btsnoop_id))) {
+		src->format = FORMAT_BTSNOOP;
 
-				((uint8_t *) frm.data)[0] = pkt_type;
+		btsnoop_version = ntohl(hdr->version);
+		src->type = ntohl(hdr->type);
 
-				frm.data_len = ntohl(dp.len) + 1;
-				err = read_n(fd, frm.data + 1, frm.data_len - 1);
-				break;
+		fprintf(info, "btsnoop version: %d datalink type: %d\n",
+						btsnoop_version, src->type);
 
-			case 1002:
-				frm.data_len = ntohl(dp.len);
-				err = read_n(fd, frm.data, frm.data_len);
-				break;
-			}
-		} else {
-			frm.data_len = btohs(dh.len);
-			err = read_n(fd, frm.data, frm.data_len);
+		if (btsnoop_version != 1) {
+			fprintf(stderr, "Unsupported BTSnoop version\n");
+			exit(1);
 		}
 
-		if (err < 0)
-			goto failed;
-		if (!err)
-			return;
-
-		frm.ptr = frm.data;
-		frm.len = frm.data_len;
-
-		if (parser.flags & DUMP_PKTLOG) {
-			uint64_t ts;
-			ts = ntoh64(ph.ts);
-			frm.ts.tv_sec = ts >> 32;
-			frm.ts.tv_usec = ts & 0xffffffff;
-		} else if (parser.flags & DUMP_BTSNOOP) {
-			uint64_t ts;
-			frm.in = ntohl(dp.flags) & 0x01;
-			ts = ntoh64(dp.ts) - 0x00E03AB44A676000ll;
-			frm.ts.tv_sec = (ts / 1000000ll) + 946684800ll;
-			frm.ts.tv_usec = ts % 1000000ll;
-		} else {
-			frm.in = dh.in;
-			frm.ts.tv_sec  = btohl(dh.ts_sec);
-			frm.ts.tv_usec = btohl(dh.ts_usec);
+		if (src->type != 1001 && src->type != 1002 &&
+						src->type != 2001) {
+			fprintf(stderr, "Unsupported BTSnoop datalink type\n");
+			exit(1);
+		}
+	} else {
+		if (buf[0] == 0x00 && buf[1] == 0x00) {
+			src->format = FORMAT_PKTLOG;
+			fprintf(info, "packet logger data format\n");
 		}
 
-		parse(&frm);
+		lseek(src->fd, 0, SEEK_SET);
 	}
 
-failed:
-	perror("Read failed");
-	exit(1);
+	map_source(src);
 }
 
-static int open_file(char *file, int mode, unsigned long flags)
+static int open_file(char *file)
 {
-	unsigned char buf[BTSNOOP_HDR_SIZE];
-	struct btsnoop_hdr *hdr = (struct btsnoop_hdr *) buf;
-	int fd, len, open_flags;
+	int fd;
 
-	if (mode == WRITE || mode == PPPDUMP || mode == AUDIO)
-		open_flags = O_WRONLY | O_CREAT | O_TRUNC;
-	else
-		open_flags = O_RDONLY;
-
-	fd = open(file, open_flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	fd = open(file, O_WRONLY | O_CREAT | O_TRUNC,
+				S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
 	if (fd < 0) {
 		perror("Can't open dump file");
 		exit(1);
 	}
 
-	if (mode == READ) {
-		len = read(fd, buf, BTSNOOP_HDR_SIZE);
-		if (len != BTSNOOP_HDR_SIZE) {
-			lseek(fd, 0, SEEK_SET);
-			return fd;
-		}
+	return fd;
+}
 
-		if (!memcmp(hdr->id, btsnoop_id, sizeof(btsnoop_id))) {
-			parser.flags |= DUMP_BTSNOOP;
+static int pcap_header(struct output *out)
+{
+	struct pcapng_shb shb;
+	struct pcap_hdr hdr;
+	void *buf;
+	int len;
+
+	if (dump_format == FORMAT_PCAPNG) {
+		shb.type = PCAPNG_SHB;
+		shb.len = PCAPNG_SHB_SIZE;
+		shb.magic = 0x1a2b3c4d;
+		shb.version_major = 1;
+		shb.version_minor = 0;
+		shb.section_len = ~0ull;
+		shb.len2 = PCAPNG_SHB_SIZE;
+		buf = &shb;
+		len = PCAPNG_SHB_SIZE;
+	} else {
+		hdr.magic = 0xa1b2c3d4;
+		hdr.version_major = 2;
+		hdr.version_minor = 4;
+		hdr.thiszone = 0;
+		hdr.sigfigs = 0;
+		hdr.snaplen = HCI_MAX_FRAME_SIZE + 4;
+		hdr.network = DLT_BLUETOOTH_HCI_H4_WITH_PHDR;
+		buf = &hdr;
+		len = PCAP_HDR_SIZE;
+	}
 
-			btsnoop_version = ntohl(hdr->version);
-			btsnoop_type = ntohl(hdr->type);
+	if (output_write(out, buf, len) < 0 || output_flush(out) < 0) {
+		perror("Can't create dump header");
+		return -1;
+	}
 
-			printf("btsnoop version: %d datalink type: %d\n",
-						btsnoop_version, btsnoop_type);
+	return 0;
+}
 
-			if (btsnoop_version != 1) {
-				fprintf(stderr, "Unsupported BTSnoop version\n");
-				exit(1);
-			}
+static int output_header(struct output *out)
+{
+	struct btsnoop_hdr hdr;
 
-			if (btsnoop_type != 1001 && btsnoop_type != 1002) {
-				fprintf(stderr, "Unsupported BTSnoop datalink type\n");
-				exit(1);
-			}
-		} else {
-			if (buf[0] == 0x00 && buf[1] == 0x00) {
-				parser.flags |= DUMP_PKTLOG;
-				printf("packet logger data format\n");
-			}
+	if (dump_format == FORMAT_PCAP || dump_format == FORMAT_PCAPNG)
+		return pcap_header(out);
 
-			parser.flags &= ~DUMP_BTSNOOP;
-			lseek(fd, 0, SEEK_SET);
-			return fd;
-		}
-	} else {
-		if (flags & DUMP_BTSNOOP) {
-			btsnoop_version = 1;
-			btsnoop_type = 1002;
+	if (dump_format != FORMAT_BTSNOOP)
+		return 0;
 
-			memcpy(hdr->id, btsnoop_id, sizeof(btsnoop_id));
-			hdr->version = htonl(btsnoop_version);
-			hdr->type = htonl(btsnoop_type);
+	btsnoop_version = 1;
 
-			printf("btsnoop version: %d datalink type: %d\n",
-						btsnoop_version, btsnoop_type);
+	memcpy(hdr.id, btsnoop_id, sizeof(btsnoop_id));
+	hdr.version = htonl(btsnoop_version);
+	hdr.type = htonl(btsnoop_type);
 
-			len = write(fd, buf, BTSNOOP_HDR_SIZE);
-			if (len < 0) {
-				perror("Can't create dump header");
-				exit(1);
-			}
+	fprintf(info, "btsnoop version: %d datalink type: %d\n",
+					btsnoop_version, btsnoop_type);
 
-			if (len != BTSNOOP_HDR_SIZE) {
-				fprintf(stderr, "Header size mismatch\n");
-				exit(1);
-			}
-		}
+	if (output_write(out, &hdr, BTSNOOP_HDR_SIZE) < 0 ||
+						output_flush(out) < 0) {
+		perror("Can't create dump header");
+		return -1;
 	}
 
-	return fd;
+	return 0;
+}
+
+static struct output *open_output(char *file)
+{
+	struct output *out;
+
+	out = new_output(open_file(file), OUTPUT_BUF_SIZE);
+
+	if (output_header(out) < 0)
+		exit(1);
+
+	return out;
 }
 
 static int open_socket(int dev, unsigned long flags)
@@ -579,6 +1694,32 @@ static int open_socket(int dev, unsigned long flags)
 		return -1;
 	}
 
+#ifdef SO_RXQ_OVFL
+	/* Not every kernel reports queue overflows for HCI sockets */
+	opt = 1;
+	setsockopt(sk, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt));
+#endif
+
+	if (rcvbuf > 0) {
+		socklen_t optlen = sizeof(opt);
+		int err = -1;
+
+		/* Going above rmem_max needs CAP_NET_ADMIN */
+		opt = rcvbuf;
+#ifdef SO_RCVBUFFORCE
+		err = setsockopt(sk, SOL_SOCKET, SO_RCVBUFFORCE,
+							&opt, sizeof(opt));
+#endif
+		if (err < 0 && setsockopt(sk, SOL_SOCKET, SO_RCVBUF,
+							&opt, sizeof(opt)) < 0) {
+			perror("Can't set receive buffer size");
+			return -1;
+		}
+
+		if (getsockopt(sk, SOL_SOCKET, SO_RCVBUF, &opt, &optlen) == 0)
+			fprintf(info, "rcvbuf: %d\n", opt);
+	}
+
 	/* Setup filter */
 	hci_filter_clear(&flt);
 	hci_filter_all_ptypes(&flt);
@@ -718,7 +1859,7 @@ static int wait_connection(char *addr, char *port)
 							hport, sizeof(hport),
 							NI_NUMERICSERV);
 
-			printf("server: %s:%s snap_len: %d filter: 0x%lx\n",
+			fprintf(info, "server: %s:%s snap_len: %d filter: 0x%lx\n",
 					hname, hport, snap_len, parser.filter);
 
 			nfds++;
@@ -729,7 +1870,7 @@ static int wait_connection(char *addr, char *port)
 
 	freeaddrinfo(ai);
 
-	while (1) {
+	while (!check_signals()) {
 		unsigned int i;
 		int n = poll(fds, nfds, -1);
 		if (n <= 0)
@@ -757,7 +1898,7 @@ static int wait_connection(char *addr, char *port)
 							hport, sizeof(hport),
 							NI_NUMERICSERV);
 
-			printf("client: %s:%s snap_len: %d filter: 0x%lx\n",
+			fprintf(info, "client: %s:%s snap_len: %d filter: 0x%lx\n",
 					hname, hport, snap_len, parser.filter);
 
 			for (n = 0; n < (int) nfds; n++)
@@ -770,10 +1911,36 @@ static int wait_connection(char *addr, char *port)
 	return -1;
 }
 
-static int run_server(int dev, char *addr, char *port, unsigned long flags)
+static int open_devices(unsigned long flags)
 {
-	while (1) {
-		int dd, sk;
+	int i, count = 0;
+
+	for (i = 0; i < num_devices; i++) {
+		devices[i].sk = open_socket(devices[i].dev_id, flags);
+		devices[i].rxq_ovfl = 0;
+		if (devices[i].sk >= 0)
+			count++;
+	}
+
+	return count;
+}
+
+static void close_devices(void)
+{
+	int i;
+
+	for (i = 0; i < num_devices; i++) {
+		if (devices[i].sk >= 0)
+			close(devices[i].sk);
+		devices[i].sk = -1;
+	}
+}
+
+static int run_server(char *addr, char *port, unsigned long flags)
+{
+	while (!terminate) {
+		struct output *out;
+		int sk;
 
 		sk = wait_connection(addr, port);
 		if (sk < 0)
@@ -781,15 +1948,17 @@ static int run_server(int dev, char *addr, char *port, unsigned long flags)
 
 		//fcntl(sk, F_SETFL, O_NONBLOCK);
 
-		dd = open_socket(dev, flags);
-		if (dd < 0) {
+		if (!open_devices(flags)) {
 			close(sk);
 			continue;
 		}
 
-		process_frames(dev, dd, sk, flags);
+		/* Unbuffered so that the client sees frames right away */
+		out = new_output(sk, 0);
+		process_frames(devices, num_devices, out, flags);
+		free(out);
 
-		close(dd);
+		close_devices();
 		close(sk);
 	}
 
@@ -827,6 +1996,16 @@ static unsigned long parse_filter(int argc, char **argv)
 	int i,n;
 
 	for (i = 0; i < argc; i++) {
+		if (!strncasecmp(argv[i], "bdaddr=", 7)) {
+			if (str2ba(argv[i] + 7, &filter_bdaddr) < 0) {
+				fprintf(stderr, "Invalid address %s\n",
+								argv[i] + 7);
+				exit(1);
+			}
+			use_bdaddr = 1;
+			continue;
+		}
+
 		for (n = 0; filters[n].name; n++) {
 			if (!strcasecmp(filters[n].name, argv[i])) {
 				filter |= filters[n].flag;
@@ -838,16 +2017,166 @@ static unsigned long parse_filter(int argc, char **argv)
 	return filter;
 }
 
+static struct {
+	char *name;
+	int  format;
+	int  type;
+} formats[] = {
+	{ "btsnoop",		FORMAT_BTSNOOP,	1002	},
+	{ "btsnoop1001",	FORMAT_BTSNOOP,	1001	},
+	{ "btsnoop1002",	FORMAT_BTSNOOP,	1002	},
+	{ "monitor",		FORMAT_BTSNOOP,	2001	},
+	{ "hcidump",		FORMAT_HCIDUMP,	0	},
+	{ "pktlog",		FORMAT_PKTLOG,	0	},
+	{ "pcap",		FORMAT_PCAP,	0	},
+	{ "pcapng",		FORMAT_PCAPNG,	0	},
+	{ 0 }
+};
+
+static void parse_format(char *str)
+{
+	int i;
+
+	for (i = 0; formats[i].name; i++) {
+		if (!strcasecmp(formats[i].name, str)) {
+			dump_format = formats[i].format;
+			btsnoop_type = formats[i].type;
+			return;
+		}
+	}
+
+	fprintf(stderr, "Unknown dump format %s\n", str);
+	exit(1);
+}
+
+static void add_device(int dev_id)
+{
+	struct device *d;
+	int i;
+
+	for (i = 0; i < num_devices; i++)
+		if (devices[i].dev_id == dev_id)
+			return;
+
+	if (num_devices == MAX_DEVICES) {
+		fprintf(stderr, "Too many devices\n");
+		exit(1);
+	}
+
+	d = &devices[num_devices++];
+	memset(d, 0, sizeof(*d));
+	d->dev_id = dev_id;
+	d->sk = -1;
+	d->out = NULL;
+}
+
+static void add_all_devices(void)
+{
+	struct hci_dev_list_req *dl;
+	struct hci_dev_req *dr;
+	int i, sk;
+
+	sk = socket(AF_BLUETOOTH, SOCK_RAW, BTPROTO_HCI);
+	if (sk < 0) {
+		perror("Can't open HCI socket");
+		exit(1);
+	}
+
+	dl = malloc(HCI_MAX_DEV * sizeof(*dr) + sizeof(*dl));
+	if (!dl) {
+		perror("Can't allocate memory");
+		exit(1);
+	}
+
+	dl->dev_num = HCI_MAX_DEV;
+	dr = dl->dev_req;
+
+	if (ioctl(sk, HCIGETDEVLIST, (void *) dl) < 0) {
+		perror("Can't get device list");
+		exit(1);
+	}
+
+	for (i = 0; i < dl->dev_num; i++)
+		add_device(dr[i].dev_id);
+
+	free(dl);
+	close(sk);
+}
+
+/* Devices are given as hciN or N, or by the address of an active one */
+static int parse_device(const char *str)
+{
+	const char *num = str;
+	char *end;
+	long id;
+
+	if (!bachk(str))
+		return hci_devid(str);
+
+	if (!strncasecmp(num, "hci", 3))
+		num += 3;
+
+	if (!isdigit((unsigned char) *num))
+		return -1;
+
+	id = strtol(num, &end, 10);
+	if (*end || id >= HCI_DEV_NONE)
+		return -1;
+
+	return id;
+}
+
+static void parse_devices(char *list)
+{
+	char *str, *tok;
+	int dev_id;
+
+	str = strdup(list);
+
+	for (tok = strtok(str, ","); tok; tok = strtok(NULL, ",")) {
+		if (!strcasecmp(tok, "none") || !strcasecmp(tok, "system"))
+			add_device(HCI_DEV_NONE);
+		else if (!strcasecmp(tok, "all"))
+			add_all_devices();
+		else {
+			dev_id = parse_device(tok);
+			if (dev_id < 0) {
+				fprintf(stderr, "Invalid device %s\n", tok);
+				exit(1);
+			}
+			add_device(dev_id);
+		}
+	}
+
+	free(str);
+}
+
+static char *device_file(const char *file, int dev_id)
+{
+	const char *pos = strstr(file, "%d");
+	char *name;
+
+	name = malloc(strlen(file) + 8);
+	if (!name) {
+		perror("Can't allocate memory");
+		exit(1);
+	}
+
+	sprintf(name, "%.*s%d%s", (int) (pos - file), file, dev_id, pos + 2);
+
+	return name;
+}
+
 static void usage(void)
 {
 	printf(
 	"Usage: hcidump [OPTION...] [filter]\n"
-	"  -i, --device=hci_dev       HCI device\n"
+	"  -i, --device=hci_dev       HCI device(s), comma separated or all\n"
 	"  -l, --snap-len=len         Snap len (in bytes)\n"
 	"  -p, --psm=psm              Default PSM\n"
 	"  -m, --manufacturer=compid  Default manufacturer\n"
 	"  -w, --save-dump=file       Save dump to a file\n"
-	"  -r, --read-dump=file       Read dump from a file\n"
+	"  -r, --read-dump=file       Read dump from a file (repeat to merge)\n"
 	"  -d, --wait-dump=host       Wait on a host and send\n"
 	"  -t, --ts                   Display time stamps\n"
 	"  -a, --ascii                Dump data in ascii\n"
@@ -859,8 +2188,30 @@ static void usage(void)
 	"  -O, --obex=channel         Channel for OBEX\n"
 	"  -P, --ppp=channel          Channel for PPP\n"
 	"  -D, --pppdump=file         Extract PPP traffic\n"
+	"      --ppp-pcap=file        Extract PPP packets as pcap\n"
 	"  -A, --audio=file           Extract SCO audio data\n"
+	"      --wav=file             Extract SCO audio per connection\n"
+	"      --pandump=file         Extract PAN traffic as Ethernet pcap\n"
+	"      --a2dp-dump=base       Extract A2DP codec data per stream\n"
+	"      --obex-dump=base       Extract OBEX objects to files\n"
 	"  -Y, --novendor             No vendor commands or events\n"
+	"      --profile              Report time spent per stage on exit\n"
+	"      --latency              Report HCI command latencies on exit\n"
+	"      --flow[=file]          Report controller buffer usage on exit\n"
+	"      --rate=file            Save throughput per handle over time\n"
+	"      --rate-interval=msec   Time resolution of the throughput\n"
+	"      --adv-dedup[=msec]     Only print changed advertising reports\n"
+	"      --inq-dedup[=msec]     Only print changed inquiry results\n"
+	"      --sco-stats            Report SCO timing and packet loss\n"
+	"      --a2dp-stats[=file]    Report A2DP media streams on exit\n"
+	"      --att-stats[=sec]      Report ATT latencies and notifications\n"
+	"      --rcvbuf=size          Socket receive buffer size\n"
+	"      --convert=format       Format of the saved dump\n"
+	"      --json                 Print frames as JSON lines\n"
+	"      --binary               Print frames as binary event stream\n"
+	"      --summary              Print one line per frame\n"
+	"  -e, --extract=fields       Print fields as columns\n"
+	"      --csv                  Comma separated columns\n"
 	"  -4, --ipv4                 Use IPv4 as transport\n"
 	"  -6  --ipv6                 Use IPv6 as transport\n"
 	"  -h, --help                 Give this help list\n"
@@ -887,9 +2238,31 @@ static struct option main_options[] = {
 	{ "obex",		1, 0, 'O' },
 	{ "ppp",		1, 0, 'P' },
 	{ "pppdump",		1, 0, 'D' },
+	{ "ppp-pcap",		1, 0, OPT_PPP_PCAP },
 	{ "audio",		1, 0, 'A' },
+	{ "wav",		1, 0, OPT_WAV },
+	{ "pandump",		1, 0, OPT_PANDUMP },
+	{ "a2dp-dump",		1, 0, OPT_A2DP_DUMP },
+	{ "obex-dump",		1, 0, OPT_OBEX_DUMP },
 	{ "novendor",		0, 0, 'Y' },
 	{ "nopermcheck",	0, 0, 'Z' },
+	{ "profile",		0, 0, OPT_PROFILE },
+	{ "latency",		0, 0, OPT_LATENCY },
+	{ "flow",		2, 0, OPT_FLOW },
+	{ "rate",		1, 0, OPT_RATE },
+	{ "rate-interval",	1, 0, OPT_RATE_INTERVAL },
+	{ "adv-dedup",		2, 0, OPT_ADV },
+	{ "inq-dedup",		2, 0, OPT_INQ },
+	{ "sco-stats",		0, 0, OPT_SCO_STATS },
+	{ "a2dp-stats",		2, 0, OPT_A2DP_STATS },
+	{ "att-stats",		2, 0, OPT_ATT_STATS },
+	{ "rcvbuf",		1, 0, OPT_RCVBUF },
+	{ "convert",		1, 0, OPT_CONVERT },
+	{ "json",		0, 0, OPT_JSON },
+	{ "binary",		0, 0, OPT_BINARY },
+	{ "summary",		0, 0, OPT_SUMMARY },
+	{ "extract",		1, 0, 'e' },
+	{ "csv",		0, 0, OPT_CSV },
 	{ "ipv4",		0, 0, '4' },
 	{ "ipv6",		0, 0, '6' },
 	{ "help",		0, 0, 'h' },
@@ -901,18 +2274,18 @@ int main(int argc, char *argv[])
 {
 	unsigned long flags = 0;
 	unsigned long filter = 0;
-	int device = 0;
 	int defpsm = 0;
 	int defcompid = DEFAULT_COMPID;
-	int opt, pppdump_fd = -1, audio_fd = -1;
+	struct output *out;
+	struct field_sink *sink = NULL;
+	char *extract = NULL;
+	int csv = 0;
+	int i, opt, pppdump_fd = -1, audio_fd = -1;
 
-	while ((opt=getopt_long(argc, argv, "i:l:p:m:w:r:d:taxXRC:H:O:P:D:A:YZ46hv", main_options, NULL)) != -1) {
+	while ((opt=getopt_long(argc, argv, "i:l:p:m:w:r:d:taxXRC:H:O:P:D:A:e:YZ46hv", main_options, NULL)) != -1) {
 		switch(opt) {
 		case 'i':
-			if (strcasecmp(optarg, "none") && strcasecmp(optarg, "system"))
-				device = atoi(optarg + 3);
-			else
-				device = HCI_DEV_NONE;
+			parse_devices(optarg);
 			break;
 
 		case 'l': 
@@ -928,13 +2301,18 @@ int main(int argc, char *argv[])
 			break;
 
 		case 'w':
-			mode = WRITE;
+			if (mode != READ)
+				mode = WRITE;
 			dump_file = strdup(optarg);
 			break;
 
 		case 'r':
+			if (num_sources == MAX_SOURCES) {
+				fprintf(stderr, "Too many dump files\n");
+				exit(1);
+			}
 			mode = READ;
-			dump_file = strdup(optarg);
+			sources[num_sources++].name = strdup(optarg);
 			break;
 
 		case 'd':
@@ -986,6 +2364,19 @@ int main(int argc, char *argv[])
 			audio_file = strdup(optarg);
 			break;
 
+		case OPT_PANDUMP:
+			pandump_file = strdup(optarg);
+			break;
+
+		case OPT_PPP_PCAP:
+			ppp_pcap_file = strdup(optarg);
+			break;
+
+		case OPT_WAV:
+			flags |= DUMP_AUDIO;
+			audio_init(optarg);
+			break;
+
 		case 'Y':
 			flags |= DUMP_NOVENDOR;
 			break;
@@ -994,6 +2385,92 @@ int main(int argc, char *argv[])
 			permcheck = 0;
 			break;
 
+		case OPT_PROFILE:
+			flags |= DUMP_PROFILE;
+			break;
+
+		case OPT_LATENCY:
+			flags |= DUMP_LATENCY;
+			break;
+
+		case OPT_FLOW:
+			flags |= DUMP_FLOW;
+			flow_file = optarg;
+			break;
+
+		case OPT_RATE:
+			flags |= DUMP_RATE;
+			rate_file = optarg;
+			break;
+
+		case OPT_RATE_INTERVAL:
+			rate_interval = atoi(optarg);
+			break;
+
+		case OPT_ADV:
+			flags |= DUMP_ADV;
+			adv_init(optarg ? atoi(optarg) : 0);
+			break;
+
+		case OPT_INQ:
+			flags |= DUMP_INQ;
+			inq_init(optarg ? atoi(optarg) : 0);
+			break;
+
+		case OPT_SCO_STATS:
+			flags |= DUMP_SCO;
+			audio_stats_init();
+			break;
+
+		case OPT_A2DP_DUMP:
+			flags |= DUMP_MEDIA;
+			a2dp_extract_init(optarg);
+			break;
+
+		case OPT_OBEX_DUMP:
+			obex_extract_init(optarg);
+			break;
+
+		case OPT_ATT_STATS:
+			flags |= DUMP_ATT;
+			att_stats_init(optarg ? atoi(optarg) : 0);
+			break;
+
+		case OPT_A2DP_STATS:
+			flags |= DUMP_A2DP;
+			a2dp_file = optarg;
+			break;
+
+		case OPT_RCVBUF:
+			rcvbuf = atoi(optarg);
+			break;
+
+		case OPT_CONVERT:
+			parse_format(optarg);
+			convert = 1;
+			break;
+
+		case OPT_JSON:
+			sink = &json_sink;
+			break;
+
+		case OPT_BINARY:
+			sink = &binary_sink;
+			break;
+
+		case OPT_SUMMARY:
+			sink = &summary_sink;
+			break;
+
+		case 'e':
+			extract = optarg;
+			sink = &extract_sink;
+			break;
+
+		case OPT_CSV:
+			csv = 1;
+			break;
+
 		case '4':
 			af = AF_INET;
 			break;
@@ -1017,7 +2494,11 @@ int main(int argc, char *argv[])
 	argv += optind;
 	optind = 0;
 
-	printf("HCI sniffer - Bluetooth packet analyzer ver %s\n", VERSION);
+	/* Keep stdout clean for the structured output */
+	info = sink ? stderr : stdout;
+
+	fprintf(info, "HCI sniffer - Bluetooth packet analyzer ver %s\n",
+								VERSION);
 
 	if (argc > 0)
 		filter = parse_filter(argc, argv);
@@ -1026,37 +2507,195 @@ int main(int argc, char *argv[])
 	if (!filter)
 		filter = ~0L;
 
+	/* The PAN capture is written by the BNEP decoder */
+	if (pandump_file)
+		filter |= FILT_BNEP;
+
+	if (!num_devices)
+		add_device(0);
+
+	if (num_devices > 1)
+		flags |= DUMP_DEVICE;
+
+	if (convert && !dump_file) {
+		fprintf(stderr, "Conversion needs a dump file to save to\n");
+		exit(1);
+	}
+
 	if (pppdump_file)
-		pppdump_fd = open_file(pppdump_file, PPPDUMP, flags);
+		pppdump_fd = open_file(pppdump_file);
 
 	if (audio_file)
-		audio_fd = open_file(audio_file, AUDIO, flags);
+		audio_fd = open_file(audio_file);
+
+	if (pandump_file)
+		bnep_pcap_init(open_file(pandump_file));
+
+	if (ppp_pcap_file)
+		ppp_pcap_init(open_file(ppp_pcap_file));
+
+	if (flow_file)
+		flow_init(open_file(flow_file));
+
+	if (a2dp_file)
+		a2dp_init(open_file(a2dp_file));
+
+	if (rate_file) {
+		char *ext = strrchr(rate_file, '.');
+
+		rate_init(open_file(rate_file), rate_interval,
+					ext && !strcmp(ext, ".json"));
+	}
+
+	init_signals();
+
+	if (flags & DUMP_PROFILE) {
+		/* Keep stdout writes in the output stage */
+		setvbuf(stdout, NULL, _IOFBF, BUFSIZ);
+		prof_init();
+	}
 
 	switch (mode) {
 	case PARSE:
 		flags |= DUMP_VERBOSE;
 		init_parser(flags, filter, defpsm, defcompid, pppdump_fd, audio_fd);
-		process_frames(device, open_socket(device, flags), -1, flags);
+		parser.sink = sink;
+		if (use_bdaddr)
+			parser.bdaddr = &filter_bdaddr;
+		if (extract)
+			parser.filter &= extract_init(extract, csv);
+		if (pandump_file)
+			parser.filter |= FILT_BNEP;
+		if (open_devices(flags))
+			process_frames(devices, num_devices, NULL, flags);
 		break;
 
 	case READ:
 		flags |= DUMP_VERBOSE;
 		init_parser(flags, filter, defpsm, defcompid, pppdump_fd, audio_fd);
-		read_dump(open_file(dump_file, mode, flags));
+
+		for (i = 0; i < num_sources; i++)
+			open_source(&sources[i], i);
+
+		if (num_sources > 1 || sources[0].type == 2001)
+			parser.flags |= DUMP_DEVICE;
+
+		parser.sink = sink;
+		if (use_bdaddr)
+			parser.bdaddr = &filter_bdaddr;
+		if (extract)
+			parser.filter &= extract_init(extract, csv);
+		if (pandump_file)
+			parser.filter |= FILT_BNEP;
+
+		out = NULL;
+		if (dump_file) {
+			/* Rewrite the frames instead of decoding them */
+			if (dump_format == FORMAT_BTSNOOP && !btsnoop_type)
+				btsnoop_type = (parser.flags & DUMP_DEVICE) ?
+								2001 : 1002;
+			merge_dump = tagged_output();
+			out = open_output(dump_file);
+		}
+
+		read_dump(sources, num_sources, out);
+
+		if (skipped)
+			fprintf(stderr, "convert: %lu frames skipped\n",
+								skipped);
 		break;
 
 	case WRITE:
 		flags |= DUMP_BTSNOOP;
-		process_frames(device, open_socket(device, flags),
-				open_file(dump_file, mode, flags), flags);
+		init_parser(flags, filter, defpsm, defcompid, pppdump_fd, audio_fd);
+		if (strstr(dump_file, "%d")) {
+			/* One file per device */
+			if (dump_format == FORMAT_BTSNOOP && !btsnoop_type)
+				btsnoop_type = 1002;
+			for (i = 0; i < num_devices; i++)
+				devices[i].out = open_output(device_file(
+						dump_file, devices[i].dev_id));
+			out = NULL;
+		} else {
+			if (dump_format == FORMAT_BTSNOOP && !btsnoop_type)
+				btsnoop_type = num_devices > 1 ? 2001 : 1002;
+			merge_dump = tagged_output();
+			out = open_output(dump_file);
+		}
+		if (open_devices(flags))
+			process_frames(devices, num_devices, out, flags);
+
+		if (skipped)
+			fprintf(stderr, "convert: %lu frames skipped\n",
+								skipped);
 		break;
 
 	case SERVER:
 		flags |= DUMP_BTSNOOP;
 		init_parser(flags, filter, defpsm, defcompid, pppdump_fd, audio_fd);
-		run_server(device, dump_addr, dump_port, flags);
+		run_server(dump_addr, dump_port, flags);
 		break;
 	}
 
+	for (i = 0; i < num_devices; i++)
+		report_drops(&devices[i], 1);
+
+	if (num_devices > 1 && mode != READ)
+		report_devices();
+
+	if (total_drops)
+		fprintf(stderr, "drops: %u frames lost in total\n", total_drops);
+
+	if (flags & DUMP_PROFILE) {
+		fflush(stdout);
+		prof_dump(stderr);
+	}
+
+	if (flags & DUMP_LATENCY) {
+		fflush(stdout);
+		lat_dump(stderr);
+	}
+
+	if (flags & DUMP_FLOW) {
+		fflush(stdout);
+		flow_dump(stderr);
+	}
+
+	if (flags & DUMP_ADV) {
+		fflush(stdout);
+		adv_dump(stderr);
+	}
+
+	if (flags & DUMP_INQ) {
+		fflush(stdout);
+		inq_dump(stderr);
+	}
+
+	if (flags & DUMP_A2DP) {
+		fflush(stdout);
+		a2dp_dump(stderr);
+	}
+
+	if (flags & (DUMP_A2DP | DUMP_MEDIA))
+		a2dp_close();
+
+	if (flags & DUMP_ATT) {
+		fflush(stdout);
+		att_stats_dump(stderr);
+	}
+
+	if (flags & DUMP_RATE)
+		rate_close();
+
+	if (flags & (DUMP_AUDIO | DUMP_SCO)) {
+		fflush(stdout);
+		audio_close();
+	}
+
+	fflush(stdout);
+	obex_close();
+	ppp_close();
+	pcap_close();
+
 	return 0;
 }